@@ -0,0 +1,325 @@
+/*
+  ==============================================================================
+
+    LinearPhaseFilter.cpp
+
+  ==============================================================================
+*/
+
+#include "LinearPhaseFilter.h"
+
+//==============================================================================
+LinearPhaseFilter::LinearPhaseFilter(juce::AudioProcessorValueTreeState& apvtsToUse, MagnitudeResponse magnitudeResponseToUse)
+    : juce::Thread("EQ Linear Phase Designer"),
+    apvts(apvtsToUse),
+    magnitudeResponse(std::move(magnitudeResponseToUse))
+{
+    for (auto* parameter : apvts.processor.getParameters())
+        if (auto* ranged = dynamic_cast<juce::RangedAudioParameter*>(parameter))
+            apvts.addParameterListener(ranged->getParameterID(), this);
+}
+
+LinearPhaseFilter::~LinearPhaseFilter()
+{
+    for (auto* parameter : apvts.processor.getParameters())
+        if (auto* ranged = dynamic_cast<juce::RangedAudioParameter*>(parameter))
+            apvts.removeParameterListener(ranged->getParameterID(), this);
+
+    stopThread(1000);
+}
+
+int LinearPhaseFilter::getKernelLengthForSampleRate(double sampleRate)
+{
+    return juce::nextPowerOfTwo(juce::jmax(NumPartitions * 64, juce::roundToInt(std::ceil(sampleRate / 3.0))));
+}
+
+void LinearPhaseFilter::prepare(const juce::dsp::ProcessSpec& spec)
+{
+    stopThread(1000);
+
+    sampleRate = spec.sampleRate;
+    kernelLength = getKernelLengthForSampleRate(sampleRate);
+    partitionSize = kernelLength / NumPartitions;
+    numBins = partitionSize + 1;
+
+    // JUCE's real-only transforms work in place on twice the FFT size
+    auto partitionOrder = juce::findHighestSetBit(static_cast<juce::uint32>(2 * partitionSize));
+    partitionFFT = std::make_unique<juce::dsp::FFT>(partitionOrder);
+    designPartitionFFT = std::make_unique<juce::dsp::FFT>(partitionOrder);
+    designFFT = std::make_unique<juce::dsp::FFT>(juce::findHighestSetBit(static_cast<juce::uint32>(kernelLength)));
+
+    channels.resize(spec.numChannels);
+
+    for (auto& channel : channels)
+    {
+        channel.input.assign(static_cast<size_t>(2 * partitionSize), 0.f);
+        channel.output.assign(static_cast<size_t>(partitionSize), 0.f);
+        channel.spectra.assign(static_cast<size_t>(NumPartitions * 2 * numBins), 0.f);
+    }
+
+    fftBuffer.assign(static_cast<size_t>(4 * partitionSize), 0.f);
+    accumulator.assign(static_cast<size_t>(2 * numBins), 0.f);
+    fadeAccumulator.assign(static_cast<size_t>(2 * numBins), 0.f);
+
+    magnitudes.assign(static_cast<size_t>(kernelLength / 2 + 1), 0.f);
+    designBuffer.assign(static_cast<size_t>(2 * kernelLength), 0.f);
+    partitionBuffer.assign(static_cast<size_t>(4 * partitionSize), 0.f);
+
+    // Blackman: its sidelobes sit below what an EQ curve needs to resolve
+    window.resize(static_cast<size_t>(kernelLength));
+
+    for (int n = 0; n < kernelLength; ++n)
+    {
+        auto phase = juce::MathConstants<double>::twoPi * n / kernelLength;
+        window[static_cast<size_t>(n)] = static_cast<float>(0.42 - 0.5 * std::cos(phase) + 0.08 * std::cos(2.0 * phase));
+    }
+
+    for (auto& kernel : kernels)
+        kernel.assign(static_cast<size_t>(NumPartitions * 2 * numBins), 0.f);
+
+    // the first kernel is in place before the first block, with nothing to fade from
+    kernelState.store(0);
+    currentKernel = fadingKernel = NoKernel;
+
+    isDirty.store(false);
+    designKernel();
+
+    currentKernel = (kernelState.load() >> PendingShift) - 1;
+    kernelState.store(1 << currentKernel);
+
+    reset();
+    startThread();
+}
+
+void LinearPhaseFilter::release()
+{
+    stopThread(1000);
+}
+
+void LinearPhaseFilter::reset() noexcept
+{
+    for (auto& channel : channels)
+    {
+        std::fill(channel.input.begin(), channel.input.end(), 0.f);
+        std::fill(channel.output.begin(), channel.output.end(), 0.f);
+        std::fill(channel.spectra.begin(), channel.spectra.end(), 0.f);
+    }
+
+    fillPosition = 0;
+    spectrumIndex = 0;
+}
+
+void LinearPhaseFilter::setActive(bool shouldBeActive) noexcept
+{
+    isActive.store(shouldBeActive);
+}
+
+void LinearPhaseFilter::parameterChanged(const juce::String&, float)
+{
+    markDirty();
+}
+
+void LinearPhaseFilter::run()
+{
+    while (!threadShouldExit())
+    {
+        if (isActive.load())
+            designIfDirty();
+
+        wait(PollIntervalMs);
+    }
+}
+
+void LinearPhaseFilter::designIfDirty()
+{
+    // nothing can be designed before prepare(); the kernel stays dirty until then
+    if (kernelLength == 0 || !isDirty.exchange(false))
+        return;
+
+    designKernel();
+}
+
+//==============================================================================
+void LinearPhaseFilter::designKernel()
+{
+    const juce::ScopedLock sl(designLock);
+
+    magnitudeResponse(sampleRate, kernelLength, magnitudes);
+    jassert(static_cast<int>(magnitudes.size()) == kernelLength / 2 + 1);
+
+    // a zero phase spectrum gives an impulse response centred on sample 0...
+    std::fill(designBuffer.begin(), designBuffer.end(), 0.f);
+
+    for (size_t bin = 0; bin < magnitudes.size(); ++bin)
+        designBuffer[2 * bin] = magnitudes[bin];
+
+    designFFT->performRealOnlyInverseTransform(designBuffer.data());
+
+    // ...which is rotated to the middle of the kernel, windowed and cut into
+    // partitions, each transformed the way the audio thread transforms its input
+    auto state = kernelState.load();
+    auto busy = state & InUseMask;
+
+    if (auto pending = state >> PendingShift; pending != 0)
+        busy |= 1 << (pending - 1);
+
+    int slot = 0;
+
+    while ((busy & (1 << slot)) != 0)
+        ++slot;
+
+    // playing, fading and waiting take three slots at most
+    jassert(slot < NumKernelSlots);
+
+    auto* kernel = kernels[static_cast<size_t>(slot)].data();
+
+    for (int partition = 0; partition < NumPartitions; ++partition)
+    {
+        std::fill(partitionBuffer.begin(), partitionBuffer.end(), 0.f);
+
+        for (int i = 0; i < partitionSize; ++i)
+        {
+            auto n = partition * partitionSize + i;
+            auto rotated = (n + kernelLength / 2) % kernelLength;
+            partitionBuffer[static_cast<size_t>(i)] = designBuffer[static_cast<size_t>(rotated)] * window[static_cast<size_t>(n)];
+        }
+
+        designPartitionFFT->performRealOnlyForwardTransform(partitionBuffer.data(), true);
+        std::copy_n(partitionBuffer.data(), 2 * numBins, kernel + partition * 2 * numBins);
+    }
+
+    publishKernel(slot);
+}
+
+void LinearPhaseFilter::publishKernel(int slot) noexcept
+{
+    // replaces whatever was waiting; that slot is free again as soon as this lands
+    auto state = kernelState.load();
+
+    while (!kernelState.compare_exchange_weak(state, (state & InUseMask) | ((slot + 1) << PendingShift)))
+    {
+    }
+}
+
+void LinearPhaseFilter::takeNewKernel() noexcept
+{
+    auto state = kernelState.load();
+    int pending;
+
+    // only retries if the designer publishes at the same moment
+    do
+    {
+        pending = (state >> PendingShift) - 1;
+
+        if (pending == NoKernel)
+            return;
+    }
+    while (!kernelState.compare_exchange_weak(state, (1 << currentKernel) | (1 << pending)));
+
+    fadingKernel = currentKernel;
+    currentKernel = pending;
+}
+
+//==============================================================================
+void LinearPhaseFilter::process(const juce::dsp::AudioBlock<float>& block) noexcept
+{
+    auto numChannels = juce::jmin(block.getNumChannels(), channels.size());
+    auto numSamples = block.getNumSamples();
+
+    jassert(currentKernel != NoKernel);
+
+    for (size_t position = 0; position < numSamples;)
+    {
+        auto numToCopy = juce::jmin(numSamples - position, static_cast<size_t>(partitionSize - fillPosition));
+
+        for (size_t i = 0; i < numChannels; ++i)
+        {
+            auto* samples = block.getChannelPointer(i) + position;
+            auto& channel = channels[i];
+
+            std::copy_n(samples, numToCopy, channel.input.data() + partitionSize + fillPosition);
+            std::copy_n(channel.output.data() + fillPosition, numToCopy, samples);
+        }
+
+        fillPosition += static_cast<int>(numToCopy);
+        position += numToCopy;
+
+        if (fillPosition == partitionSize)
+        {
+            processPartition();
+            fillPosition = 0;
+        }
+    }
+}
+
+void LinearPhaseFilter::processPartition() noexcept
+{
+    takeNewKernel();
+
+    spectrumIndex = (spectrumIndex + 1) % NumPartitions;
+
+    for (auto& channel : channels)
+    {
+        auto* spectrum = channel.spectra.data() + spectrumIndex * 2 * numBins;
+
+        std::copy(channel.input.begin(), channel.input.end(), fftBuffer.begin());
+        std::fill(fftBuffer.begin() + 2 * partitionSize, fftBuffer.end(), 0.f);
+        partitionFFT->performRealOnlyForwardTransform(fftBuffer.data(), true);
+        std::copy_n(fftBuffer.data(), 2 * numBins, spectrum);
+
+        // the partition just filled is the overlap for the next one
+        std::copy_n(channel.input.data() + partitionSize, partitionSize, channel.input.data());
+
+        multiplyAndAdd(channel, kernels[static_cast<size_t>(currentKernel)].data(), accumulator.data());
+        inverseTransform(accumulator.data(), channel.output.data());
+
+        if (fadingKernel != NoKernel)
+        {
+            // the old kernel's output, faded out over the partition as the new one's fades in
+            multiplyAndAdd(channel, kernels[static_cast<size_t>(fadingKernel)].data(), fadeAccumulator.data());
+            inverseTransform(fadeAccumulator.data(), fftBuffer.data());
+
+            for (int i = 0; i < partitionSize; ++i)
+            {
+                auto gain = static_cast<float>(i + 1) / static_cast<float>(partitionSize);
+                channel.output[static_cast<size_t>(i)] = fftBuffer[static_cast<size_t>(i)]
+                    + gain * (channel.output[static_cast<size_t>(i)] - fftBuffer[static_cast<size_t>(i)]);
+            }
+        }
+    }
+
+    if (fadingKernel != NoKernel)
+    {
+        fadingKernel = NoKernel;
+        kernelState.fetch_and(~InUseMask | (1 << currentKernel));
+    }
+}
+
+void LinearPhaseFilter::multiplyAndAdd(const Channel& channel, const float* kernel, float* destination) const noexcept
+{
+    std::fill_n(destination, 2 * numBins, 0.f);
+
+    for (int partition = 0; partition < NumPartitions; ++partition)
+    {
+        // each of the kernel's partitions meets the input from that many partitions ago
+        auto index = (spectrumIndex - partition + NumPartitions) % NumPartitions;
+        auto* x = channel.spectra.data() + index * 2 * numBins;
+        auto* h = kernel + partition * 2 * numBins;
+
+        for (int bin = 0; bin < 2 * numBins; bin += 2)
+        {
+            destination[bin] += x[bin] * h[bin] - x[bin + 1] * h[bin + 1];
+            destination[bin + 1] += x[bin] * h[bin + 1] + x[bin + 1] * h[bin];
+        }
+    }
+}
+
+void LinearPhaseFilter::inverseTransform(const float* spectrum, float* destination) noexcept
+{
+    // overlap-save: the first half of the result is wrapped around and thrown away
+    std::copy_n(spectrum, 2 * numBins, fftBuffer.data());
+    std::fill(fftBuffer.begin() + 2 * numBins, fftBuffer.end(), 0.f);
+    partitionFFT->performRealOnlyInverseTransform(fftBuffer.data());
+
+    std::copy_n(fftBuffer.data() + partitionSize, partitionSize, destination);
+}
@@ -0,0 +1,131 @@
+/*
+  ==============================================================================
+
+    LinearPhaseFilter.h
+    A linear phase version of the EQ curve: a FIR kernel designed from the
+    curve's magnitude response, run with uniformly partitioned FFT
+    convolution.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <array>
+#include <functional>
+#include <vector>
+
+/** Filters every channel with a symmetric FIR kernel whose magnitude
+    response is whatever the MagnitudeResponse function returns, so the
+    EQ curve is applied with no phase shift at the cost of latency.
+
+    Kernels are designed on a background thread whenever a parameter
+    changes while the filter is active: the magnitudes go through an
+    inverse FFT as a zero phase spectrum, the impulse response is rotated
+    to the middle of the kernel and windowed, and each of the kernel's
+    NumPartitions partitions is transformed once. Finished kernels go into
+    one of a few preallocated slots and the audio thread crossfades from the
+    old kernel to the new one over a partition, so a moving band never
+    clicks.
+
+    The audio thread runs uniformly partitioned overlap-save convolution:
+    every partition length of input it does one forward and one inverse
+    FFT per channel and multiplies and adds the last NumPartitions input
+    spectra with the kernel's. With the number of partitions fixed, a longer
+    kernel means longer partitions rather than more of them, so the cost per
+    sample only grows with the log of the kernel length; a 64k tap kernel at
+    192 kHz costs about what a 16k one does at 48 kHz.
+
+    The latency is half the kernel plus one partition.
+*/
+class LinearPhaseFilter : private juce::AudioProcessorValueTreeState::Listener,
+                          private juce::Thread
+{
+public:
+    /** Fills magnitudes (fftSize / 2 + 1 of them) with the linear gain the
+        curve has at each bin, bin k being k * sampleRate / fftSize Hz.
+        Called on the designer thread.
+    */
+    using MagnitudeResponse = std::function<void(double sampleRate, int fftSize, std::vector<float>& magnitudes)>;
+
+    static constexpr int NumPartitions = 16;
+
+    LinearPhaseFilter(juce::AudioProcessorValueTreeState& apvts, MagnitudeResponse magnitudeResponse);
+    ~LinearPhaseFilter() override;
+
+    // Allocates everything, designs the first kernel before returning and starts the designer thread.
+    void prepare(const juce::dsp::ProcessSpec& spec);
+    void release();
+
+    // Clears the input history, e.g. when switching over from the IIR filters.
+    void reset() noexcept;
+
+    void markDirty() noexcept { isDirty.store(true); }
+
+    // Designs a kernel now if a parameter has changed. For offline renders; never call this from a realtime callback.
+    void designIfDirty();
+
+    // The filter only designs kernels while it's active. Cheap enough to call every block.
+    void setActive(bool shouldBeActive) noexcept;
+
+    void process(const juce::dsp::AudioBlock<float>& block) noexcept;
+
+    int getLatencySamples() const noexcept { return kernelLength / 2 + partitionSize; }
+    int getKernelLength() const noexcept { return kernelLength; }
+
+    // Kernels are the shortest power of two at least a third of a second long.
+    static int getKernelLengthForSampleRate(double sampleRate);
+
+private:
+    // the one playing, the one fading out, one waiting and one being designed
+    static constexpr int NumKernelSlots = 4;
+    static constexpr int NoKernel = -1;
+    static constexpr int PollIntervalMs = 5;
+
+    // kernelState holds a bit per slot the audio thread is using, and above
+    // them the slot waiting to be picked up, plus one (zero for none)
+    static constexpr int InUseMask = (1 << NumKernelSlots) - 1;
+    static constexpr int PendingShift = NumKernelSlots;
+
+    struct Channel
+    {
+        std::vector<float> input;       // the previous partition and the one being filled
+        std::vector<float> output;      // the partition being played
+        std::vector<float> spectra;     // the last NumPartitions input spectra, a ring
+    };
+
+    void parameterChanged(const juce::String& parameterID, float newValue) override;
+    void run() override;
+
+    void designKernel();
+    void publishKernel(int slot) noexcept;
+
+    void processPartition() noexcept;
+    void takeNewKernel() noexcept;
+    void multiplyAndAdd(const Channel& channel, const float* kernel, float* destination) const noexcept;
+    void inverseTransform(const float* spectrum, float* destination) noexcept;
+
+    juce::AudioProcessorValueTreeState& apvts;
+    MagnitudeResponse magnitudeResponse;
+
+    double sampleRate{ 0.0 };
+    int kernelLength{ 0 }, partitionSize{ 0 }, numBins{ 0 };
+
+    // audio thread
+    std::vector<Channel> channels;
+    std::unique_ptr<juce::dsp::FFT> partitionFFT;
+    std::vector<float> fftBuffer, accumulator, fadeAccumulator;
+    int fillPosition{ 0 }, spectrumIndex{ 0 };
+    int currentKernel{ NoKernel }, fadingKernel{ NoKernel };
+
+    // designer thread
+    std::unique_ptr<juce::dsp::FFT> designFFT, designPartitionFFT;
+    std::vector<float> magnitudes, designBuffer, window, partitionBuffer;
+    juce::CriticalSection designLock;
+
+    // shared: each slot holds NumPartitions spectra of numBins complex values
+    std::array<std::vector<float>, NumKernelSlots> kernels;
+    std::atomic<int> kernelState{ 0 };
+    std::atomic<bool> isDirty{ true }, isActive{ false };
+};
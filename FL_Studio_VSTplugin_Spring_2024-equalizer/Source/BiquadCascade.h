@@ -0,0 +1,202 @@
+/*
+  ==============================================================================
+
+    BiquadCascade.h
+    A chain of biquads that filters several channels at once, one channel
+    per lane of a SIMD register, with every channel sharing the coefficients.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <array>
+#include <vector>
+
+/** A cascade of NumStages second order sections, each of which can be
+    bypassed, run on however many channels prepare() is given.
+
+    The channels are interleaved into groups of SIMDRegister<float>::size()
+    (four with SSE or NEON), so one transposed direct form II recursion
+    filters the whole group: stereo runs the cascade once instead of twice,
+    and 7.1.4 takes three passes, or two on an AVX build. Each active
+    stage runs over the whole block before the next one starts, so its
+    coefficients and state stay in registers; bypassed stages are skipped.
+
+    The maths matches juce::dsp::IIR::Filter for second order coefficients.
+*/
+template<int NumStages>
+class BiquadCascade
+{
+public:
+    using Register = juce::dsp::SIMDRegister<float>;
+
+    static constexpr int NumCoefficients = 5;
+    static constexpr int LanesPerGroup = static_cast<int>(Register::size());
+
+    BiquadCascade()
+    {
+        bypassed.fill(true);
+
+        for (auto& stage : coefficients)
+            stage = makeStage({ 1.f, 0.f, 0.f, 0.f, 0.f });
+    }
+
+    // Allocates the state of every channel; process() doesn't allocate.
+    void prepare(const juce::dsp::ProcessSpec& spec)
+    {
+        numChannels = static_cast<int>(spec.numChannels);
+        numGroups = (numChannels + LanesPerGroup - 1) / LanesPerGroup;
+
+        interleaved.assign(spec.maximumBlockSize, Register::expand(0.f));
+        states.resize(static_cast<size_t>(numGroups));
+
+        reset();
+    }
+
+    void reset() noexcept
+    {
+        for (auto& groupStates : states)
+            for (auto& state : groupStates)
+                state = { Register::expand(0.f), Register::expand(0.f) };
+    }
+
+    // Sets a stage's b0, b1, b2, a1, a2 (already divided by a0) for every channel.
+    void setStage(int stage, const std::array<float, NumCoefficients>& stageCoefficients) noexcept
+    {
+        jassert(juce::isPositiveAndBelow(stage, NumStages));
+        coefficients[stage] = makeStage(stageCoefficients);
+    }
+
+    // A bypassed stage keeps its state and costs nothing.
+    void setStageBypassed(int stage, bool shouldBeBypassed) noexcept
+    {
+        jassert(juce::isPositiveAndBelow(stage, NumStages));
+
+        if (bypassed[stage] == shouldBeBypassed)
+            return;
+
+        bypassed[stage] = shouldBeBypassed;
+        numActiveStages = 0;
+
+        for (int i = 0; i < NumStages; ++i)
+            if (!bypassed[i])
+                activeStages[numActiveStages++] = i;
+    }
+
+    bool isStageBypassed(int stage) const noexcept { return bypassed[stage]; }
+
+    // Filters the block's channels in place, up to as many as prepare() was
+    // given. A block longer than the prepared maximum is run in pieces.
+    void process(const juce::dsp::AudioBlock<float>& block) noexcept
+    {
+        if (numActiveStages == 0)
+            return;
+
+        auto numSamples = block.getNumSamples();
+        auto maxChunk = interleaved.size();
+
+        // prepare() hasn't been called
+        jassert(maxChunk > 0);
+
+        if (maxChunk == 0)
+            return;
+
+        for (size_t start = 0; start < numSamples; start += maxChunk)
+            processChunk(block.getSubBlock(start, juce::jmin(maxChunk, numSamples - start)));
+    }
+
+private:
+    void processChunk(const juce::dsp::AudioBlock<float>& block) noexcept
+    {
+        auto numSamples = block.getNumSamples();
+        auto channelsToProcess = juce::jmin(static_cast<int>(block.getNumChannels()), numChannels);
+
+        for (int group = 0; group < numGroups; ++group)
+        {
+            auto firstChannel = group * LanesPerGroup;
+            auto numLanes = juce::jmin(LanesPerGroup, channelsToProcess - firstChannel);
+
+            if (numLanes <= 0)
+                break;
+
+            auto* lanes = reinterpret_cast<float*>(interleaved.data());
+
+            for (int lane = 0; lane < numLanes; ++lane)
+            {
+                auto* channel = block.getChannelPointer(static_cast<size_t>(firstChannel + lane));
+
+                for (size_t i = 0; i < numSamples; ++i)
+                    lanes[i * LanesPerGroup + lane] = channel[i];
+            }
+
+            // the last group's spare lanes still hold the previous group's samples
+            for (int lane = numLanes; lane < LanesPerGroup; ++lane)
+                for (size_t i = 0; i < numSamples; ++i)
+                    lanes[i * LanesPerGroup + lane] = 0.f;
+
+            processGroup(states[static_cast<size_t>(group)], numSamples);
+
+            for (int lane = 0; lane < numLanes; ++lane)
+            {
+                auto* channel = block.getChannelPointer(static_cast<size_t>(firstChannel + lane));
+
+                for (size_t i = 0; i < numSamples; ++i)
+                    channel[i] = lanes[i * LanesPerGroup + lane];
+            }
+        }
+    }
+
+    struct Stage
+    {
+        Register b0, b1, b2, a1, a2;
+    };
+
+    struct State
+    {
+        Register s1, s2;
+    };
+
+    using GroupStates = std::array<State, NumStages>;
+
+    static Stage makeStage(const std::array<float, NumCoefficients>& c) noexcept
+    {
+        return { Register::expand(c[0]), Register::expand(c[1]), Register::expand(c[2]),
+                 Register::expand(c[3]), Register::expand(c[4]) };
+    }
+
+    void processGroup(GroupStates& groupStates, size_t numSamples) noexcept
+    {
+        auto* samples = interleaved.data();
+
+        for (int i = 0; i < numActiveStages; ++i)
+        {
+            auto stage = activeStages[i];
+            auto c = coefficients[stage];
+            auto state = groupStates[stage];
+
+            for (size_t n = 0; n < numSamples; ++n)
+            {
+                auto input = samples[n];
+                auto output = (c.b0 * input) + state.s1;
+
+                state.s1 = (c.b1 * input) - (c.a1 * output) + state.s2;
+                state.s2 = (c.b2 * input) - (c.a2 * output);
+
+                samples[n] = output;
+            }
+
+            groupStates[stage] = state;
+        }
+    }
+
+    std::array<Stage, NumStages> coefficients;
+    std::array<bool, NumStages> bypassed;
+    std::array<int, NumStages> activeStages{};
+    int numActiveStages{ 0 };
+
+    int numChannels{ 0 }, numGroups{ 0 };
+    std::vector<GroupStates> states;
+    std::vector<Register> interleaved;
+};
@@ -20,10 +20,13 @@ EqualizerJUCEAudioProcessor::EqualizerJUCEAudioProcessor()
     )
 #endif
 {
+    linearPhaseParameter = apvts.getRawParameterValue("Linear Phase");
+    startTimerHz(10);
 }
 
 EqualizerJUCEAudioProcessor::~EqualizerJUCEAudioProcessor()
 {
+    stopTimer();
 }
 
 //==============================================================================
@@ -98,14 +101,21 @@ void EqualizerJUCEAudioProcessor::prepareToPlay(double sampleRate, int samplesPe
 
     spec.maximumBlockSize = samplesPerBlock;
 
-    spec.numChannels = 1;
+    spec.numChannels = getTotalNumOutputChannels();
 
     spec.sampleRate = sampleRate;
 
-    leftChain.prepare(spec);
-    rightChain.prepare(spec);
+    cascade.prepare(spec);
+
+    for (auto& ramp : ramps)
+        ramp.reset(sampleRate);
+
+    coefficientUpdater.prepare(sampleRate);
+    applyCoefficientUpdates();
 
-    updateFilters();
+    linearPhaseFilter.prepare(spec);
+    isLinearPhase.store(linearPhaseParameter->load() > 0.5f);
+    setLatencySamples(isLinearPhase.load() ? linearPhaseFilter.getLatencySamples() : 0);
 
     leftChannelFifo.prepare(samplesPerBlock);
     rightChannelFifo.prepare(samplesPerBlock);
@@ -121,6 +131,8 @@ void EqualizerJUCEAudioProcessor::releaseResources()
 {
     // When playback stops, you can use this as an opportunity to free up any
     // spare memory, etc.
+    coefficientUpdater.release();
+    linearPhaseFilter.release();
 }
 
 #ifndef JucePlugin_PreferredChannelConfigurations
@@ -130,12 +142,11 @@ bool EqualizerJUCEAudioProcessor::isBusesLayoutSupported(const BusesLayout& layo
     juce::ignoreUnused(layouts);
     return true;
 #else
-    // This is the place where you check if the layout is supported.
-    // In this template code we only support mono or stereo.
-    // Some plugin hosts, such as certain GarageBand versions, will only
-    // load plugins that support stereo bus layouts.
-    if (layouts.getMainOutputChannelSet() != juce::AudioChannelSet::mono()
-        && layouts.getMainOutputChannelSet() != juce::AudioChannelSet::stereo())
+    // Every channel gets the same filters, so any layout from mono up to
+    // 7.1.4 works, surround and discrete alike.
+    auto numChannels = layouts.getMainOutputChannelSet().size();
+
+    if (numChannels < 1 || numChannels > MaxChannels)
         return false;
 
     // This checks if the input layout matches the output layout
@@ -158,17 +169,44 @@ void EqualizerJUCEAudioProcessor::processBlock(juce::AudioBuffer<float>& buffer,
     for (auto i = totalNumInputChannels; i < totalNumOutputChannels; ++i)
         buffer.clear(i, 0, buffer.getNumSamples());
 
-    updateFilters();
+    // an offline render can't wait for the background thread, or automation
+    // would land late in the bounce
+    auto useLinearPhase = linearPhaseParameter->load() > 0.5f;
+    linearPhaseFilter.setActive(useLinearPhase);
 
-    juce::dsp::AudioBlock<float> block(buffer);
-    auto leftBlock = block.getSingleChannelBlock(0);
-    auto rightBlock = block.getSingleChannelBlock(1);
+    if (isNonRealtime())
+    {
+        coefficientUpdater.designDirtyBands();
+
+        if (useLinearPhase)
+            linearPhaseFilter.designIfDirty();
+    }
+
+    applyCoefficientUpdates();
 
-    juce::dsp::ProcessContextReplacing<float> leftContext(leftBlock);
-    juce::dsp::ProcessContextReplacing<float> rightContext(rightBlock);
+    // whichever filter takes over starts from silence, not from where it was left
+    if (useLinearPhase != isLinearPhase.load())
+    {
+        if (useLinearPhase)
+            linearPhaseFilter.reset();
+        else
+            cascade.reset();
+
+        isLinearPhase.store(useLinearPhase);
+    }
+
+    juce::dsp::AudioBlock<float> block(buffer);
 
-    leftChain.process(leftContext);
-    rightChain.process(rightContext);
+    if (useLinearPhase)
+    {
+        // the IIR bands aren't heard, but keep gliding so they're in place when they are
+        advanceRamps(buffer.getNumSamples());
+        linearPhaseFilter.process(block);
+    }
+    else
+    {
+        processCascade(block);
+    }
 
     leftChannelFifo.update(buffer);
     rightChannelFifo.update(buffer);
@@ -206,10 +244,19 @@ void EqualizerJUCEAudioProcessor::setStateInformation(const void* data, int size
     if (tree.isValid())
     {
         apvts.replaceState(tree);
-        updateFilters();
+        coefficientUpdater.markAllDirty();
+        linearPhaseFilter.markDirty();
     }
 }
 
+void EqualizerJUCEAudioProcessor::timerCallback()
+{
+    auto latency = isLinearPhase.load() ? linearPhaseFilter.getLatencySamples() : 0;
+
+    if (latency != getLatencySamples())
+        setLatencySamples(latency);
+}
+
 ChainSettings getChainSettings(juce::AudioProcessorValueTreeState& apvts)
 {
     ChainSettings settings;
@@ -239,15 +286,31 @@ Coefficients makePeakFilter(const ChainSettings& chainSettings, double sampleRat
         juce::Decibels::decibelsToGain(chainSettings.peakGainInDecibels));
 }
 
-void EqualizerJUCEAudioProcessor::updatePeakFilter(const ChainSettings& chainSettings)
+void getMagnitudeResponse(const ChainSettings& chainSettings, double sampleRate, int fftSize, std::vector<float>& magnitudes)
 {
-    auto peakCoefficients = makePeakFilter(chainSettings, getSampleRate());
+    juce::ReferenceCountedArray<juce::dsp::IIR::Coefficients<float>> stages;
+
+    if (!chainSettings.lowCutBypassed)
+        stages.addArray(makeLowCutFilter(chainSettings, sampleRate));
 
-    leftChain.setBypassed<ChainPositions::Peak>(chainSettings.peakBypassed);
-    rightChain.setBypassed<ChainPositions::Peak>(chainSettings.peakBypassed);
+    if (!chainSettings.peakBypassed)
+        stages.add(makePeakFilter(chainSettings, sampleRate));
+
+    if (!chainSettings.highCutBypassed)
+        stages.addArray(makeHighCutFilter(chainSettings, sampleRate));
+
+    magnitudes.resize(static_cast<size_t>(fftSize / 2 + 1));
+
+    for (size_t bin = 0; bin < magnitudes.size(); ++bin)
+    {
+        auto frequency = static_cast<double>(bin) * sampleRate / fftSize;
+        double magnitude = 1.0;
 
-    updateCoefficients(leftChain.get<ChainPositions::Peak>().coefficients, peakCoefficients);
-    updateCoefficients(rightChain.get<ChainPositions::Peak>().coefficients, peakCoefficients);
+        for (auto* stage : stages)
+            magnitude *= stage->getMagnitudeForFrequency(frequency, sampleRate);
+
+        magnitudes[bin] = static_cast<float>(magnitude);
+    }
 }
 
 void updateCoefficients(Coefficients& old, const Coefficients& replacements)
@@ -255,40 +318,285 @@ void updateCoefficients(Coefficients& old, const Coefficients& replacements)
     *old = *replacements;
 }
 
-void EqualizerJUCEAudioProcessor::updateLowCutFilters(const ChainSettings& chainSettings)
+void EqualizerJUCEAudioProcessor::applyCoefficientUpdates() noexcept
+{
+    for (auto band : { ChainPositions::LowCut, ChainPositions::Peak, ChainPositions::HighCut })
+    {
+        if (auto* coefficients = coefficientUpdater.pull(band))
+            if (!ramps[band].setTarget(*coefficients))
+                applyBand(band, *coefficients);
+    }
+}
+
+void EqualizerJUCEAudioProcessor::applyBand(ChainPositions band, const BandCoefficients& coefficients) noexcept
+{
+    auto firstStage = getFirstStage(band);
+
+    for (int i = 0; i < getNumStages(band); ++i)
+    {
+        auto isUsed = !coefficients.bypassed && i < coefficients.numStages;
+
+        if (isUsed)
+            cascade.setStage(firstStage + i, coefficients.stages[i]);
+
+        cascade.setStageBypassed(firstStage + i, !isUsed);
+    }
+}
+
+void EqualizerJUCEAudioProcessor::advanceRamps(int numSamples) noexcept
+{
+    for (auto band : { ChainPositions::LowCut, ChainPositions::Peak, ChainPositions::HighCut })
+    {
+        if (ramps[band].isRamping())
+            applyBand(band, ramps[band].advance(band, numSamples, getSampleRate()));
+    }
+}
+
+bool EqualizerJUCEAudioProcessor::isRamping() const noexcept
+{
+    return std::any_of(ramps.begin(), ramps.end(), [](const BandRamp& ramp) { return ramp.isRamping(); });
+}
+
+void EqualizerJUCEAudioProcessor::processCascade(const juce::dsp::AudioBlock<float>& block) noexcept
+{
+    if (!isRamping())
+    {
+        cascade.process(block);
+        return;
+    }
+
+    auto numSamples = block.getNumSamples();
+
+    for (size_t start = 0; start < numSamples; start += ControlInterval)
+    {
+        auto length = juce::jmin(static_cast<size_t>(ControlInterval), numSamples - start);
+
+        advanceRamps(static_cast<int>(length));
+        cascade.process(block.getSubBlock(start, length));
+    }
+}
+
+//==============================================================================
+void BandRamp::reset(double sampleRate) noexcept
+{
+    frequency.reset(sampleRate, RampLengthSeconds);
+    quality.reset(sampleRate, RampLengthSeconds);
+    gainInDecibels.reset(sampleRate, RampLengthSeconds);
+
+    hasTarget = false;
+}
+
+bool BandRamp::setTarget(const BandCoefficients& newTarget) noexcept
+{
+    auto canGlide = hasTarget
+        && !newTarget.bypassed && !target.bypassed
+        && newTarget.numStages == target.numStages;
+
+    target = newTarget;
+    hasTarget = true;
+
+    if (!canGlide)
+    {
+        frequency.setCurrentAndTargetValue(target.frequency);
+        quality.setCurrentAndTargetValue(target.quality);
+        gainInDecibels.setCurrentAndTargetValue(target.gainInDecibels);
+        return false;
+    }
+
+    frequency.setTargetValue(target.frequency);
+    quality.setTargetValue(target.quality);
+    gainInDecibels.setTargetValue(target.gainInDecibels);
+
+    return isRamping();
+}
+
+bool BandRamp::isRamping() const noexcept
+{
+    return frequency.isSmoothing() || quality.isSmoothing() || gainInDecibels.isSmoothing();
+}
+
+const BandCoefficients& BandRamp::advance(ChainPositions band, int numSamples, double sampleRate) noexcept
 {
-    auto cutCoefficients = makeLowCutFilter(chainSettings, getSampleRate());
-    auto& leftLowCut = leftChain.get<ChainPositions::LowCut>();
-    auto& rightLowCut = rightChain.get<ChainPositions::LowCut>();
+    auto newFrequency = frequency.skip(numSamples);
+    auto newQuality = quality.skip(numSamples);
+    auto newGainInDecibels = gainInDecibels.skip(numSamples);
 
-    leftChain.setBypassed<ChainPositions::LowCut>(chainSettings.lowCutBypassed);
-    rightChain.setBypassed<ChainPositions::LowCut>(chainSettings.lowCutBypassed);
+    if (!isRamping())
+        return target;
 
-    updateCutFilter(rightLowCut, cutCoefficients, chainSettings.lowCutSlope);
-    updateCutFilter(leftLowCut, cutCoefficients, chainSettings.lowCutSlope);
+    current = target;
+    designStages(band, newFrequency, newGainInDecibels, newQuality, sampleRate, current);
+
+    return current;
 }
 
-void EqualizerJUCEAudioProcessor::updateHighCutFilters(const ChainSettings& chainSettings)
+void designStages(ChainPositions band, float frequency, float gainInDecibels, float quality,
+    double sampleRate, BandCoefficients& destination) noexcept
 {
-    auto highCutCoefficients = makeHighCutFilter(chainSettings, getSampleRate());
+    using ArrayCoefficients = juce::dsp::IIR::ArrayCoefficients<float>;
+
+    // b0, b1, b2, a0, a1, a2 to what IIR::Coefficients would store
+    auto setStage = [&destination](int stage, const std::array<float, 6>& c)
+    {
+        auto a0Inverse = 1.f / c[3];
+        destination.stages[stage] = { c[0] * a0Inverse, c[1] * a0Inverse, c[2] * a0Inverse, c[4] * a0Inverse, c[5] * a0Inverse };
+    };
 
-    auto& leftHighCut = leftChain.get<ChainPositions::HighCut>();
-    auto& rightHighCut = rightChain.get<ChainPositions::HighCut>();
+    if (band == Peak)
+    {
+        setStage(0, ArrayCoefficients::makePeakFilter(sampleRate, frequency, quality, juce::Decibels::decibelsToGain(gainInDecibels)));
+        return;
+    }
 
-    leftChain.setBypassed<ChainPositions::HighCut>(chainSettings.highCutBypassed);
-    rightChain.setBypassed<ChainPositions::HighCut>(chainSettings.highCutBypassed);
+    // the sections of a Butterworth filter of order 2 * numStages, as FilterDesign makes them
+    auto order = 2 * destination.numStages;
 
-    updateCutFilter(leftHighCut, highCutCoefficients, chainSettings.highCutSlope);
-    updateCutFilter(rightHighCut, highCutCoefficients, chainSettings.highCutSlope);
+    for (int i = 0; i < destination.numStages; ++i)
+    {
+        auto stageQuality = static_cast<float>(1.0 / (2.0 * std::cos((2.0 * i + 1.0) * juce::MathConstants<double>::pi / (order * 2.0))));
+
+        setStage(i, band == LowCut ? ArrayCoefficients::makeHighPass(sampleRate, frequency, stageQuality)
+                                   : ArrayCoefficients::makeLowPass(sampleRate, frequency, stageQuality));
+    }
 }
 
-void EqualizerJUCEAudioProcessor::updateFilters()
+//==============================================================================
+CoefficientUpdater::CoefficientUpdater(juce::AudioProcessorValueTreeState& apvtsToUse)
+    : juce::Thread("EQ Coefficient Updater"),
+    apvts(apvtsToUse)
 {
+    for (auto* parameter : apvts.processor.getParameters())
+        if (auto* ranged = dynamic_cast<juce::RangedAudioParameter*>(parameter))
+            apvts.addParameterListener(ranged->getParameterID(), this);
+}
+
+CoefficientUpdater::~CoefficientUpdater()
+{
+    for (auto* parameter : apvts.processor.getParameters())
+        if (auto* ranged = dynamic_cast<juce::RangedAudioParameter*>(parameter))
+            apvts.removeParameterListener(ranged->getParameterID(), this);
+
+    stopThread(1000);
+}
+
+void CoefficientUpdater::prepare(double sampleRate)
+{
+    currentSampleRate.store(sampleRate);
+
+    markAllDirty();
+    designDirtyBands();
+
+    if (!isThreadRunning())
+        startThread();
+}
+
+void CoefficientUpdater::release()
+{
+    stopThread(1000);
+}
+
+void CoefficientUpdater::markAllDirty() noexcept
+{
+    markDirty((1 << NumBands) - 1);
+}
+
+void CoefficientUpdater::markDirty(int bands) noexcept
+{
+    dirtyBands.fetch_or(bands);
+
+    // hosts often automate from the audio thread, where waking the designer
+    // would mean taking a lock; those changes are picked up by its next poll
+    if (juce::MessageManager::existsAndIsCurrentThread())
+        notify();
+}
+
+void CoefficientUpdater::parameterChanged(const juce::String& parameterID, float)
+{
+    if (parameterID.startsWith("LowCut"))
+        markDirty(1 << ChainPositions::LowCut);
+    else if (parameterID.startsWith("Peak"))
+        markDirty(1 << ChainPositions::Peak);
+    else if (parameterID.startsWith("HighCut"))
+        markDirty(1 << ChainPositions::HighCut);
+}
+
+void CoefficientUpdater::run()
+{
+    while (!threadShouldExit())
+    {
+        designDirtyBands();
+        wait(PollIntervalMs);
+    }
+}
+
+void CoefficientUpdater::designDirtyBands()
+{
+    const juce::ScopedLock sl(designLock);
+
+    auto sampleRate = currentSampleRate.load();
+
+    // nothing can be designed before prepare(); the bands stay dirty until then
+    if (sampleRate <= 0.0)
+        return;
+
+    auto dirty = dirtyBands.exchange(0);
+
+    if (dirty == 0)
+        return;
+
     auto chainSettings = getChainSettings(apvts);
 
-    updateLowCutFilters(chainSettings);
-    updatePeakFilter(chainSettings);
-    updateHighCutFilters(chainSettings);
+    for (int band = 0; band < NumBands; ++band)
+    {
+        if ((dirty & (1 << band)) != 0)
+        {
+            design(static_cast<ChainPositions>(band), chainSettings, sampleRate, slots[band].getWriteBuffer());
+            slots[band].publish();
+        }
+    }
+}
+
+void CoefficientUpdater::design(ChainPositions band, const ChainSettings& chainSettings, double sampleRate, BandCoefficients& destination)
+{
+    auto copyStages = [&destination](const juce::ReferenceCountedArray<juce::dsp::IIR::Coefficients<float>>& coefficients)
+    {
+        destination.numStages = juce::jmin(coefficients.size(), BandCoefficients::MaxStages);
+
+        for (int i = 0; i < destination.numStages; ++i)
+        {
+            jassert(coefficients[i]->coefficients.size() == BandCoefficients::NumCoefficients);
+            std::copy_n(coefficients[i]->getRawCoefficients(), BandCoefficients::NumCoefficients, destination.stages[i].begin());
+        }
+    };
+
+    switch (band)
+    {
+    case LowCut:
+    {
+        copyStages(makeLowCutFilter(chainSettings, sampleRate));
+        destination.bypassed = chainSettings.lowCutBypassed;
+        destination.frequency = chainSettings.lowCutFreq;
+        break;
+    }
+    case Peak:
+    {
+        juce::ReferenceCountedArray<juce::dsp::IIR::Coefficients<float>> peakCoefficients;
+        peakCoefficients.add(makePeakFilter(chainSettings, sampleRate));
+        copyStages(peakCoefficients);
+        destination.bypassed = chainSettings.peakBypassed;
+        destination.frequency = chainSettings.peakFreq;
+        destination.gainInDecibels = chainSettings.peakGainInDecibels;
+        destination.quality = chainSettings.peakQuality;
+        break;
+    }
+    case HighCut:
+    {
+        copyStages(makeHighCutFilter(chainSettings, sampleRate));
+        destination.bypassed = chainSettings.highCutBypassed;
+        destination.frequency = chainSettings.highCutFreq;
+        break;
+    }
+    }
 }
 
 juce::AudioProcessorValueTreeState::ParameterLayout EqualizerJUCEAudioProcessor::createParameterLayout()
@@ -336,6 +644,7 @@ juce::AudioProcessorValueTreeState::ParameterLayout EqualizerJUCEAudioProcessor:
     layout.add(std::make_unique<juce::AudioParameterBool>("Peak Bypassed", "Peak Bypassed", false));
     layout.add(std::make_unique<juce::AudioParameterBool>("HighCut Bypassed", "HighCut Bypassed", false));
     layout.add(std::make_unique<juce::AudioParameterBool>("Analyzer Enabled", "Analyzer Enabled", true));
+    layout.add(std::make_unique<juce::AudioParameterBool>("Linear Phase", "Linear Phase", false));
 
 
 
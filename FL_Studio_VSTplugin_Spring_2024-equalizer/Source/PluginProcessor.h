@@ -8,6 +8,8 @@
 
 #include <JuceHeader.h>
 #include <array>
+#include "BiquadCascade.h"
+#include "../../FL_Studio_VSTplugin_Spring_2024-equalizer-shared/LinearPhaseFilter.h"
 
 template<typename T>
 struct Fifo
@@ -89,8 +91,10 @@ struct SingleChannelSampleFifo
     void update(const BlockType& buffer)
     {
         jassert(prepared.get());
-        jassert(buffer.getNumChannels() > channelToUse);
-        auto* channelPtr = buffer.getReadPointer(channelToUse);
+        jassert(buffer.getNumChannels() > 0);
+
+        // a mono bus feeds both sides of the analyzer
+        auto* channelPtr = buffer.getReadPointer(juce::jmin(static_cast<int>(channelToUse), buffer.getNumChannels() - 1));
 
         for (int i = 0; i < buffer.getNumSamples(); ++i)
         {
@@ -230,10 +234,161 @@ inline auto makeHighCutFilter(const ChainSettings& chainSettings, double sampleR
         sampleRate,
         2 * (chainSettings.highCutSlope + 1));
 }
+
+// The gain of the whole chain at each of fftSize / 2 + 1 bins, for the linear phase mode.
+void getMagnitudeResponse(const ChainSettings& chainSettings, double sampleRate, int fftSize, std::vector<float>& magnitudes);
+
+//==============================================================================
+constexpr int NumBands = 3;
+
+/** The designed coefficients of one band of the chain: the biquads its
+    slope uses (b0, b1, b2, a1, a2, already divided by a0), whether the
+    band is bypassed and the settings they were designed from. The peak
+    band only ever uses the first stage; the cuts leave gain and quality at
+    0 dB and 1.
+*/
+struct BandCoefficients
+{
+    static constexpr int MaxStages = 4;
+    static constexpr int NumCoefficients = 5;
+
+    std::array<std::array<float, NumCoefficients>, MaxStages> stages{};
+    int numStages{ 0 };
+    bool bypassed{ false };
+
+    float frequency{ 0 }, gainInDecibels{ 0 }, quality{ 1.f };
+};
+
+// Designs the first destination.numStages stages of a band for the given
+// settings, as makePeakFilter() and the Butterworth cuts do but without
+// allocating, so the audio thread can use it.
+void designStages(ChainPositions band, float frequency, float gainInDecibels, float quality,
+    double sampleRate, BandCoefficients& destination) noexcept;
+
+/** Glides a band towards newly designed settings instead of switching its
+    coefficients in one step, which zips when a band is swept. The
+    frequency and quality move geometrically and the gain in decibels
+    linearly; the audio thread redesigns the band from where they've got to
+    every few samples while they move, and once they arrive the band gets
+    the designer's own coefficients and costs nothing more.
+*/
+struct BandRamp
+{
+    static constexpr double RampLengthSeconds = 0.05;
+
+    void reset(double sampleRate) noexcept;
+
+    // Returns false if the band should switch to newTarget outright: the
+    // first time, when its slope or bypass changed, or when nothing moved.
+    bool setTarget(const BandCoefficients& newTarget) noexcept;
+
+    bool isRamping() const noexcept;
+
+    // Moves numSamples along the ramp and returns the band's coefficients there.
+    const BandCoefficients& advance(ChainPositions band, int numSamples, double sampleRate) noexcept;
+
+private:
+    juce::SmoothedValue<float, juce::ValueSmoothingTypes::Multiplicative> frequency, quality;
+    juce::SmoothedValue<float, juce::ValueSmoothingTypes::Linear> gainInDecibels;
+    BandCoefficients target, current;
+    bool hasTarget{ false };
+};
+
+/** A single-writer, single-reader triple buffer. The writer fills
+    getWriteBuffer() and publishes it; the reader pulls the most recently
+    published buffer. Neither side ever waits or allocates, and a reader that
+    falls behind simply skips to the newest value.
+*/
+template<typename T>
+struct TripleBuffer
+{
+    T& getWriteBuffer() noexcept { return buffers[writeIndex]; }
+
+    void publish() noexcept
+    {
+        writeIndex = middle.exchange(writeIndex | FreshBit) & IndexMask;
+    }
+
+    // Returns the newest published buffer, or nullptr if nothing new has been published since the last pull.
+    const T* pull() noexcept
+    {
+        if ((middle.load() & FreshBit) == 0)
+            return nullptr;
+
+        readIndex = middle.exchange(readIndex) & IndexMask;
+        return &buffers[readIndex];
+    }
+
+private:
+    static constexpr int FreshBit = 4;
+    static constexpr int IndexMask = 3;
+
+    std::array<T, 3> buffers;
+    int writeIndex{ 0 }, readIndex{ 1 };
+    std::atomic<int> middle{ 2 };
+};
+
+/** Keeps the audio thread out of filter design. A parameter listener marks
+    the bands whose parameters moved as dirty, a background thread redesigns
+    only those bands into preallocated slots, and the audio thread pulls the
+    finished sets through a TripleBuffer per band. When nothing has changed,
+    a block costs three atomic loads.
+*/
+class CoefficientUpdater : private juce::AudioProcessorValueTreeState::Listener,
+                           private juce::Thread
+{
+public:
+    CoefficientUpdater(juce::AudioProcessorValueTreeState& apvts);
+    ~CoefficientUpdater() override;
+
+    // Designs every band for sampleRate before returning, then keeps the bands up to date in the background.
+    void prepare(double sampleRate);
+    void release();
+
+    void markAllDirty() noexcept;
+
+    // Redesigns the dirty bands on the calling thread. Never call this from a realtime audio callback.
+    void designDirtyBands();
+
+    // For the audio thread: the band's newest coefficients, or nullptr if they haven't changed since last time.
+    const BandCoefficients* pull(ChainPositions band) noexcept { return slots[band].pull(); }
+
+private:
+    void markDirty(int bands) noexcept;
+    void parameterChanged(const juce::String& parameterID, float newValue) override;
+    void run() override;
+
+    static void design(ChainPositions band, const ChainSettings& chainSettings, double sampleRate, BandCoefficients& destination);
+
+    // how often the background thread looks for automation that changed without waking it
+    static constexpr int PollIntervalMs = 5;
+
+    juce::AudioProcessorValueTreeState& apvts;
+    std::array<TripleBuffer<BandCoefficients>, NumBands> slots;
+    std::atomic<int> dirtyBands{ 0 };
+    std::atomic<double> currentSampleRate{ 0.0 };
+    juce::CriticalSection designLock;
+};
+
+// Where each band's biquads sit in the processor's BiquadCascade: the low cut
+// stages, the peak, then the high cut stages.
+constexpr int NumStages = 2 * BandCoefficients::MaxStages + 1;
+
+constexpr int getFirstStage(ChainPositions band)
+{
+    return band == LowCut ? 0 : band == Peak ? BandCoefficients::MaxStages : BandCoefficients::MaxStages + 1;
+}
+
+constexpr int getNumStages(ChainPositions band)
+{
+    return band == Peak ? 1 : BandCoefficients::MaxStages;
+}
+
 //==============================================================================
 /**
 */
-class EqualizerJUCEAudioProcessor : public juce::AudioProcessor
+class EqualizerJUCEAudioProcessor : public juce::AudioProcessor,
+    private juce::Timer
 {
 public:
     //==============================================================================
@@ -273,6 +428,9 @@ public:
     void getStateInformation(juce::MemoryBlock& destData) override;
     void setStateInformation(const void* data, int sizeInBytes) override;
 
+    // the widest bus the EQ takes, 7.1.4
+    static constexpr int MaxChannels = 12;
+
     static juce::AudioProcessorValueTreeState::ParameterLayout createParameterLayout();
     juce::AudioProcessorValueTreeState apvts{ *this, nullptr, "Parameters", createParameterLayout() };
 
@@ -281,15 +439,31 @@ public:
     SingleChannelSampleFifo<BlockType> rightChannelFifo{ Channel::Right };
 
 private:
-    MonoChain leftChain, rightChain;
+    BiquadCascade<NumStages> cascade;
+
+    CoefficientUpdater coefficientUpdater{ apvts };
+
+    LinearPhaseFilter linearPhaseFilter{ apvts, [this](double sampleRate, int fftSize, std::vector<float>& magnitudes)
+        {
+            getMagnitudeResponse(getChainSettings(apvts), sampleRate, fftSize, magnitudes);
+        } };
+
+    std::atomic<float>* linearPhaseParameter{ nullptr };
+    std::atomic<bool> isLinearPhase{ false };
 
-    void updatePeakFilter(const ChainSettings& chainSettings);
+    // hosts expect latency changes from the message thread
+    void timerCallback() override;
 
+    // while a band glides, it's redesigned this often
+    static constexpr int ControlInterval = 32;
 
-    void updateLowCutFilters(const ChainSettings& chainSettings);
-    void updateHighCutFilters(const ChainSettings& chainSettings);
+    std::array<BandRamp, NumBands> ramps;
 
-    void updateFilters();
+    void applyCoefficientUpdates() noexcept;
+    void applyBand(ChainPositions band, const BandCoefficients& coefficients) noexcept;
+    void advanceRamps(int numSamples) noexcept;
+    bool isRamping() const noexcept;
+    void processCascade(const juce::dsp::AudioBlock<float>& block) noexcept;
     juce::dsp::Oscillator<float> osc;
 
     //==============================================================================
@@ -23,10 +23,13 @@ GarethsEQAudioProcessor::GarethsEQAudioProcessor()
 #endif
 {
     //createEditorIfNeeded();
+    linearPhaseParameter = apvts.getRawParameterValue("Linear Phase");
+    startTimerHz(10);
 }
 
 GarethsEQAudioProcessor::~GarethsEQAudioProcessor()
 {
+    stopTimer();
 }
 
 //==============================================================================
@@ -105,15 +108,18 @@ void GarethsEQAudioProcessor::prepareToPlay (double sampleRate, int samplesPerBl
     leftChain.prepare(spec);
     rightChain.prepare(spec);
 
-    
+    chainSmoother.reset(sampleRate, getChainSettings(apvts));
     updateFilters();
 
-
+    spec.numChannels = getTotalNumOutputChannels();
+    linearPhaseFilter.prepare(spec);
+    isLinearPhase.store(linearPhaseParameter->load() > 0.5f);
+    setLatencySamples(isLinearPhase.load() ? linearPhaseFilter.getLatencySamples() : 0);
 }
 
 void GarethsEQAudioProcessor::releaseResources()
 {
-   
+    linearPhaseFilter.release();
 }
 
 #ifndef JucePlugin_PreferredChannelConfigurations
@@ -150,19 +156,64 @@ void GarethsEQAudioProcessor::processBlock (juce::AudioBuffer<float>& buffer, ju
         buffer.clear (i, 0, buffer.getNumSamples());
 
 
-    updateFilters();
+    chainSmoother.setTargetSettings(getChainSettings(apvts));
+
+    auto useLinearPhase = linearPhaseParameter->load() > 0.5f;
+    linearPhaseFilter.setActive(useLinearPhase);
 
+    // an offline render can't wait for the designer thread
+    if (useLinearPhase && isNonRealtime())
+        linearPhaseFilter.designIfDirty();
+
+    // clear the state of the filter being switched to, it stopped running mid-signal
+    if (useLinearPhase != isLinearPhase.load()) {
+        if (useLinearPhase) {
+            linearPhaseFilter.reset();
+        } else {
+            // nothing was redesigned while the linear phase filter was playing
+            updateFilters(chainSmoother.getNextSettings(0));
+            leftChain.reset();
+            rightChain.reset();
+        }
+
+        isLinearPhase.store(useLinearPhase);
+    }
 
     juce::dsp::AudioBlock<float> block(buffer);
 
-    auto leftBlock = block.getSingleChannelBlock(0);
-    auto rightBlock = block.getSingleChannelBlock(1);
+    if (useLinearPhase) {
+        // the IIR filters aren't heard, so the glide just moves on without them
+        chainSmoother.getNextSettings(buffer.getNumSamples());
+        linearPhaseFilter.process(block);
+        return;
+    }
+
+    // the filters are redesigned once a block, or while a band glides, just
+    // that band every ControlInterval samples
+    auto numSamples = buffer.getNumSamples();
+    auto isGliding = chainSmoother.isSmoothing();
+    auto stepSize = isGliding ? ControlInterval : numSamples;
 
-    juce::dsp::ProcessContextReplacing<float> leftContext(leftBlock);
-    juce::dsp::ProcessContextReplacing<float> rightContext(rightBlock);
+    if (!isGliding)
+        updateFilters(chainSmoother.getNextSettings(numSamples));
 
-    leftChain.process(leftContext);
-    rightChain.process(rightContext);
+    for (int start = 0; start < numSamples; start += stepSize) {
+        auto length = juce::jmin(stepSize, numSamples - start);
+
+        if (isGliding)
+            updateGlidingFilters(length);
+
+        auto subBlock = block.getSubBlock(static_cast<size_t>(start), static_cast<size_t>(length));
+
+        auto leftBlock = subBlock.getSingleChannelBlock(0);
+        auto rightBlock = subBlock.getSingleChannelBlock(1);
+
+        juce::dsp::ProcessContextReplacing<float> leftContext(leftBlock);
+        juce::dsp::ProcessContextReplacing<float> rightContext(rightBlock);
+
+        leftChain.process(leftContext);
+        rightChain.process(rightContext);
+    }
 }
 
 //==============================================================================
@@ -190,9 +241,17 @@ void GarethsEQAudioProcessor::setStateInformation (const void* data, int sizeInB
     if (tree.isValid()) {
         apvts.replaceState(tree);
         updateFilters();
+        linearPhaseFilter.markDirty();
     }
 }
 
+void GarethsEQAudioProcessor::timerCallback() {
+    auto latency = isLinearPhase.load() ? linearPhaseFilter.getLatencySamples() : 0;
+
+    if (latency != getLatencySamples())
+        setLatencySamples(latency);
+}
+
 
 ChainSettings getChainSettings(juce::AudioProcessorValueTreeState& apvts) {
     ChainSettings settings;
@@ -247,6 +306,28 @@ void GarethsEQAudioProcessor::updatePeakFilter(const ChainSettings& chainSetting
     updateCoefficients(rightChain.get<ChainPositions::Peak3>().coefficients, peakCoeffiecients3);
 }
 
+void getMagnitudeResponse(const ChainSettings& chainSettings, double sampleRate, int fftSize, std::vector<float>& magnitudes) {
+    juce::ReferenceCountedArray<juce::dsp::IIR::Coefficients<float>> stages;
+
+    stages.addArray(makeLowCutFilter(chainSettings, sampleRate));
+    stages.add(makePeakFilter1(chainSettings, sampleRate));
+    stages.add(makePeakFilter2(chainSettings, sampleRate));
+    stages.add(makePeakFilter3(chainSettings, sampleRate));
+    stages.addArray(makeHighCutFilter(chainSettings, sampleRate));
+
+    magnitudes.resize(static_cast<size_t>(fftSize / 2 + 1));
+
+    for (size_t bin = 0; bin < magnitudes.size(); ++bin) {
+        auto frequency = static_cast<double>(bin) * sampleRate / fftSize;
+        double magnitude = 1.0;
+
+        for (auto* stage : stages)
+            magnitude *= stage->getMagnitudeForFrequency(frequency, sampleRate);
+
+        magnitudes[bin] = static_cast<float>(magnitude);
+    }
+}
+
 void updateCoefficients(Coefficients& old, const Coefficients& replacements) {
     *old = *replacements;
 }
@@ -273,14 +354,163 @@ void GarethsEQAudioProcessor::updateHighCutFilters(const ChainSettings& chainSet
     updateCutFilter(rightHighCut, highCutCoefficients, chainSettings.highCutSlope);
 }
 
+template<int Index>
+void glideCutStage(CutFilter& leftCut, CutFilter& rightCut, float frequency, Slope slope, bool isLowCut, double sampleRate) {
+    auto numStages = static_cast<int>(slope) + 1;
+    auto isUsed = Index < numStages;
+
+    leftCut.template setBypassed<Index>(!isUsed);
+    rightCut.template setBypassed<Index>(!isUsed);
+
+    if (!isUsed)
+        return;
+
+    // the same section FilterDesign's Butterworth method makes for this stage
+    auto quality = static_cast<float>(1.0 / (2.0 * std::cos((2.0 * Index + 1.0) * juce::MathConstants<double>::pi / (numStages * 4.0))));
+
+    auto coefficients = isLowCut ? juce::dsp::IIR::ArrayCoefficients<float>::makeHighPass(sampleRate, frequency, quality)
+                                 : juce::dsp::IIR::ArrayCoefficients<float>::makeLowPass(sampleRate, frequency, quality);
+
+    *leftCut.template get<Index>().coefficients = coefficients;
+    *rightCut.template get<Index>().coefficients = coefficients;
+}
+
+void glideCutFilter(CutFilter& leftCut, CutFilter& rightCut, float frequency, Slope slope, bool isLowCut, double sampleRate) {
+    glideCutStage<0>(leftCut, rightCut, frequency, slope, isLowCut, sampleRate);
+    glideCutStage<1>(leftCut, rightCut, frequency, slope, isLowCut, sampleRate);
+    glideCutStage<2>(leftCut, rightCut, frequency, slope, isLowCut, sampleRate);
+    glideCutStage<3>(leftCut, rightCut, frequency, slope, isLowCut, sampleRate);
+}
+
+void glidePeakFilter(Filter& left, Filter& right, float frequency, float gainInDecibels, float quality, double sampleRate) {
+    auto coefficients = juce::dsp::IIR::ArrayCoefficients<float>::makePeakFilter(sampleRate, frequency,
+        quality, juce::Decibels::decibelsToGain(gainInDecibels));
+
+    *left.coefficients = coefficients;
+    *right.coefficients = coefficients;
+}
+
+void GarethsEQAudioProcessor::updateGlidingFilters(int numSamples) {
+    // a band's last step finishes its glide, so which ones move is checked first
+    auto lowCutGliding = chainSmoother.isSmoothing(LowCut);
+    auto peak1Gliding = chainSmoother.isSmoothing(Peak1);
+    auto peak2Gliding = chainSmoother.isSmoothing(Peak2);
+    auto peak3Gliding = chainSmoother.isSmoothing(Peak3);
+    auto highCutGliding = chainSmoother.isSmoothing(HighCut);
+
+    auto s = chainSmoother.getNextSettings(numSamples);
+    auto sampleRate = getSampleRate();
+
+    if (lowCutGliding)
+        glideCutFilter(leftChain.get<LowCut>(), rightChain.get<LowCut>(), s.lowCutFreq, s.lowCutSlope, true, sampleRate);
+
+    if (peak1Gliding)
+        glidePeakFilter(leftChain.get<Peak1>(), rightChain.get<Peak1>(), s.peakFreq1, s.peakGainInDecibels1, s.peakQuality1, sampleRate);
+
+    if (peak2Gliding)
+        glidePeakFilter(leftChain.get<Peak2>(), rightChain.get<Peak2>(), s.peakFreq2, s.peakGainInDecibels2, s.peakQuality2, sampleRate);
+
+    if (peak3Gliding)
+        glidePeakFilter(leftChain.get<Peak3>(), rightChain.get<Peak3>(), s.peakFreq3, s.peakGainInDecibels3, s.peakQuality3, sampleRate);
+
+    if (highCutGliding)
+        glideCutFilter(leftChain.get<HighCut>(), rightChain.get<HighCut>(), s.highCutFreq, s.highCutSlope, false, sampleRate);
+}
+
 void GarethsEQAudioProcessor::updateFilters() {
-    auto chainSettings = getChainSettings(apvts);
+    updateFilters(getChainSettings(apvts));
+}
 
+void GarethsEQAudioProcessor::updateFilters(const ChainSettings& chainSettings) {
     updateLowCutFilters(chainSettings);
     updatePeakFilter(chainSettings);
     updateHighCutFilters(chainSettings);
 }
 
+void ChainSmoother::reset(double sampleRate, const ChainSettings& settings) {
+    for (auto* value : { &lowCutFreq, &highCutFreq, &peakFreq1, &peakFreq2, &peakFreq3, &peakQuality1, &peakQuality2, &peakQuality3 })
+        value->reset(sampleRate, RampLengthSeconds);
+
+    for (auto* value : { &peakGain1, &peakGain2, &peakGain3 })
+        value->reset(sampleRate, RampLengthSeconds);
+
+    lowCutFreq.setCurrentAndTargetValue(settings.lowCutFreq);
+    highCutFreq.setCurrentAndTargetValue(settings.highCutFreq);
+
+    peakFreq1.setCurrentAndTargetValue(settings.peakFreq1);
+    peakGain1.setCurrentAndTargetValue(settings.peakGainInDecibels1);
+    peakQuality1.setCurrentAndTargetValue(settings.peakQuality1);
+
+    peakFreq2.setCurrentAndTargetValue(settings.peakFreq2);
+    peakGain2.setCurrentAndTargetValue(settings.peakGainInDecibels2);
+    peakQuality2.setCurrentAndTargetValue(settings.peakQuality2);
+
+    peakFreq3.setCurrentAndTargetValue(settings.peakFreq3);
+    peakGain3.setCurrentAndTargetValue(settings.peakGainInDecibels3);
+    peakQuality3.setCurrentAndTargetValue(settings.peakQuality3);
+
+    target = settings;
+}
+
+void ChainSmoother::setTargetSettings(const ChainSettings& settings) {
+    lowCutFreq.setTargetValue(settings.lowCutFreq);
+    highCutFreq.setTargetValue(settings.highCutFreq);
+
+    peakFreq1.setTargetValue(settings.peakFreq1);
+    peakGain1.setTargetValue(settings.peakGainInDecibels1);
+    peakQuality1.setTargetValue(settings.peakQuality1);
+
+    peakFreq2.setTargetValue(settings.peakFreq2);
+    peakGain2.setTargetValue(settings.peakGainInDecibels2);
+    peakQuality2.setTargetValue(settings.peakQuality2);
+
+    peakFreq3.setTargetValue(settings.peakFreq3);
+    peakGain3.setTargetValue(settings.peakGainInDecibels3);
+    peakQuality3.setTargetValue(settings.peakQuality3);
+
+    target = settings;
+}
+
+bool ChainSmoother::isSmoothing() const {
+    return lowCutFreq.isSmoothing() || highCutFreq.isSmoothing()
+        || peakFreq1.isSmoothing() || peakGain1.isSmoothing() || peakQuality1.isSmoothing()
+        || peakFreq2.isSmoothing() || peakGain2.isSmoothing() || peakQuality2.isSmoothing()
+        || peakFreq3.isSmoothing() || peakGain3.isSmoothing() || peakQuality3.isSmoothing();
+}
+
+bool ChainSmoother::isSmoothing(ChainPositions band) const {
+    switch (band) {
+        case LowCut:  return lowCutFreq.isSmoothing();
+        case Peak1:   return peakFreq1.isSmoothing() || peakGain1.isSmoothing() || peakQuality1.isSmoothing();
+        case Peak2:   return peakFreq2.isSmoothing() || peakGain2.isSmoothing() || peakQuality2.isSmoothing();
+        case Peak3:   return peakFreq3.isSmoothing() || peakGain3.isSmoothing() || peakQuality3.isSmoothing();
+        case HighCut: return highCutFreq.isSmoothing();
+    }
+
+    return false;
+}
+
+ChainSettings ChainSmoother::getNextSettings(int numSamples) {
+    auto settings = target;
+
+    settings.lowCutFreq = lowCutFreq.skip(numSamples);
+    settings.highCutFreq = highCutFreq.skip(numSamples);
+
+    settings.peakFreq1 = peakFreq1.skip(numSamples);
+    settings.peakGainInDecibels1 = peakGain1.skip(numSamples);
+    settings.peakQuality1 = peakQuality1.skip(numSamples);
+
+    settings.peakFreq2 = peakFreq2.skip(numSamples);
+    settings.peakGainInDecibels2 = peakGain2.skip(numSamples);
+    settings.peakQuality2 = peakQuality2.skip(numSamples);
+
+    settings.peakFreq3 = peakFreq3.skip(numSamples);
+    settings.peakGainInDecibels3 = peakGain3.skip(numSamples);
+    settings.peakQuality3 = peakQuality3.skip(numSamples);
+
+    return settings;
+}
+
 juce::AudioProcessorValueTreeState::ParameterLayout 
     GarethsEQAudioProcessor::createParameterLayout() {
 
@@ -370,6 +600,7 @@ juce::AudioProcessorValueTreeState::ParameterLayout
     layout.add(std::make_unique<juce::AudioParameterBool>("Peak Bypassed", "Peak Bypassed", false));
     layout.add(std::make_unique<juce::AudioParameterBool>("HighCut Bypassed", "HighCut Bypassed", false));
     layout.add(std::make_unique<juce::AudioParameterBool>("Analyzer Enabled", "Analyzer Enabled", true));
+    layout.add(std::make_unique<juce::AudioParameterBool>("Linear Phase", "Linear Phase", false));
 
     return layout;
 }
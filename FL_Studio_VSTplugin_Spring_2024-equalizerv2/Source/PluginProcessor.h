@@ -9,6 +9,7 @@
 #pragma once
 
 #include <JuceHeader.h>
+#include "../../FL_Studio_VSTplugin_Spring_2024-equalizer-shared/LinearPhaseFilter.h"
 
 enum Slope {
     Slope_12,
@@ -95,10 +96,41 @@ inline auto makeHighCutFilter(const ChainSettings& chainSettings, double sampleR
         chainSettings.highCutFreq, sampleRate, 2 * (chainSettings.highCutSlope + 1));
 }
 
+// Glides the continuous parameters towards the ones in the parameter tree, so
+// a band that's being swept or automated moves in small steps rather than
+// jumping once a block. Frequencies and qualities glide geometrically and
+// gains linearly in decibels; the slopes switch straight away.
+struct ChainSmoother {
+    static constexpr double RampLengthSeconds = 0.05;
+
+    void reset(double sampleRate, const ChainSettings& settings);
+    void setTargetSettings(const ChainSettings& settings);
+    bool isSmoothing() const;
+    bool isSmoothing(ChainPositions band) const;
+
+    // The settings numSamples further along the glide.
+    ChainSettings getNextSettings(int numSamples);
+
+private:
+    using Geometric = juce::SmoothedValue<float, juce::ValueSmoothingTypes::Multiplicative>;
+    using Linear = juce::SmoothedValue<float, juce::ValueSmoothingTypes::Linear>;
+
+    Geometric lowCutFreq, highCutFreq;
+    Geometric peakFreq1, peakFreq2, peakFreq3;
+    Geometric peakQuality1, peakQuality2, peakQuality3;
+    Linear peakGain1, peakGain2, peakGain3;
+
+    ChainSettings target;
+};
+
+// The gain of the whole chain at each of fftSize / 2 + 1 bins, for the linear phase mode.
+void getMagnitudeResponse(const ChainSettings& chainSettings, double sampleRate, int fftSize, std::vector<float>& magnitudes);
+
 //==============================================================================
 /**
 */
-class GarethsEQAudioProcessor  : public juce::AudioProcessor
+class GarethsEQAudioProcessor  : public juce::AudioProcessor,
+                                 private juce::Timer
 {
 public:
     //==============================================================================
@@ -144,6 +176,16 @@ public:
 private:
     MonoChain leftChain, rightChain;
 
+    LinearPhaseFilter linearPhaseFilter{ apvts, [this](double sampleRate, int fftSize, std::vector<float>& magnitudes) {
+        getMagnitudeResponse(getChainSettings(apvts), sampleRate, fftSize, magnitudes);
+    } };
+
+    std::atomic<float>* linearPhaseParameter{ nullptr };
+    std::atomic<bool> isLinearPhase{ false };
+
+    // keeps the reported latency in step with the Linear Phase switch, off the audio thread
+    void timerCallback() override;
+
     void updatePeakFilter(const ChainSettings& chainSettings);
 
     
@@ -152,6 +194,16 @@ private:
     void updateHighCutFilters(const ChainSettings& chainSettings);
 
     void updateFilters();
+    void updateFilters(const ChainSettings& chainSettings);
+
+    // Moves the glide numSamples on and redesigns only the bands that were
+    // moving, in place, so nothing is allocated.
+    void updateGlidingFilters(int numSamples);
+
+    // while a band glides, its filters are redesigned this often
+    static constexpr int ControlInterval = 32;
+
+    ChainSmoother chainSmoother;
 
 
     //==============================================================================
@@ -0,0 +1,206 @@
+/**
+ * @file DenseMidiBenchmark.cpp
+ *
+ * @brief Times SynthEngine under dense note streams (arpeggios and drum
+ *        rolls) with its scheduled renderNextBlock() against the generic
+ *        Synthesiser::renderNextBlock(), which splits the render at every
+ *        event, and checks that scheduled notes start on the same sample.
+ *
+ * @author
+ */
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "../Source/SynthEngine.h"
+
+
+namespace
+{
+    constexpr double sampleRate = 48000.0;
+    constexpr int blockSize = 512;
+    constexpr int numTimedBlocks = 1000;
+    constexpr int numVoices = 16;
+    constexpr int numRuns = 3;
+
+    enum class Rendering
+    {
+        Scheduled,      // SynthEngine::renderNextBlock()
+        Generic,        // Synthesiser::renderNextBlock(), events up to 32 samples early
+        GenericExact    // Synthesiser::renderNextBlock() split at every event
+    };
+
+    // One note every interval samples, each length samples long, walking
+    // up numPitches notes.
+    struct Pattern
+    {
+        const char* name;
+        int interval;
+        int length;
+        int numPitches;
+    };
+
+    const Pattern patterns[] =
+    {
+        { "chords (1 event per block)",   blockSize, blockSize / 2, 4 },
+        { "arpeggio (1/64 at 180 bpm)",   250, 200, 8 },
+        { "drum roll (every 24 samples)", 24, 20, 4 },
+        { "buzz roll (every 6 samples)",  6, 5, 3 }
+    };
+
+    SynthParameterSnapshot makePatch()
+    {
+        SynthParameterSnapshot parameters;
+        parameters.attack = 1.0f;
+        parameters.decay = 50.0f;
+        parameters.sustain = 0.6f;
+        parameters.release = 5.0f;
+        parameters.waveform = float(VoiceWaveform::Saw);
+        parameters.filterType = VoiceFilterType::LowPass;
+        parameters.filterCutoff = 3000.0f;
+        parameters.filterResonance = 1.0f;
+        parameters.version = 1;
+        return parameters;
+    }
+
+    struct Engine
+    {
+        Engine(const Wavetables& wavetables, Rendering renderingToUse)
+            : rendering(renderingToUse)
+        {
+            engine.setNumVoices(numVoices, [&] { return new SynthVoice(wavetables); });
+            engine.addSound(new SynthSound());
+            engine.setCurrentPlaybackSampleRate(sampleRate);
+
+            if (rendering == Rendering::GenericExact)
+                engine.setMinimumRenderingSubdivisionSize(1, true);
+
+            for (int i = 0; i < numVoices; ++i)
+                if (auto* voice = dynamic_cast<SynthVoice*>(engine.getVoice(i)))
+                    voice->prepareToPlay(sampleRate, blockSize);
+
+            engine.setParameters(makePatch());
+        }
+
+        void render(AudioBuffer<float>& output, const MidiBuffer& midi)
+        {
+            output.clear();
+
+            if (rendering == Rendering::Scheduled)
+                engine.renderNextBlock(output, midi, 0, output.getNumSamples());
+            else
+                engine.Synthesiser::renderNextBlock(output, midi, 0, output.getNumSamples());
+        }
+
+        SynthEngine engine;
+        Rendering rendering;
+    };
+
+    // The block's notes on and off, from a pattern that started at sample 0.
+    void fillBlock(MidiBuffer& midi, const Pattern& pattern, int block)
+    {
+        midi.clear();
+
+        const auto blockStart = int64(block) * blockSize;
+
+        for (auto start = (blockStart - pattern.length) / pattern.interval * pattern.interval; start < blockStart + blockSize; start += pattern.interval)
+        {
+            if (start < 0)
+                continue;
+
+            const auto note = 48 + 5 * int((start / pattern.interval) % pattern.numPitches);
+            const auto end = start + pattern.length;
+
+            if (start >= blockStart)
+                midi.addEvent(MidiMessage::noteOn(1, note, 0.8f), int(start - blockStart));
+
+            if (end >= blockStart && end < blockStart + blockSize)
+                midi.addEvent(MidiMessage::noteOff(1, note), int(end - blockStart));
+        }
+    }
+
+    double timePattern(const Wavetables& wavetables, const Pattern& pattern, Rendering rendering)
+    {
+        std::vector<MidiBuffer> blocks((size_t) numTimedBlocks);
+
+        for (int block = 0; block < numTimedBlocks; ++block)
+            fillBlock(blocks[(size_t) block], pattern, block);
+
+        auto best = std::numeric_limits<double>::max();
+        AudioBuffer<float> output(2, blockSize);
+
+        for (int run = 0; run < numRuns; ++run)
+        {
+            Engine engine(wavetables, rendering);
+            const auto start = Time::getHighResolutionTicks();
+
+            for (const auto& midi : blocks)
+                engine.render(output, midi);
+
+            best = jmin(best, Time::highResolutionTicksToSeconds(Time::getHighResolutionTicks() - start));
+        }
+
+        return best;
+    }
+
+    // The first sample a note sent for offset sounds on, or -1.
+    int findOnset(const Wavetables& wavetables, Rendering rendering, int offset)
+    {
+        Engine engine(wavetables, rendering);
+        AudioBuffer<float> output(2, blockSize);
+        MidiBuffer midi;
+
+        // an event early in the block, so the generic render has a split to make
+        midi.addEvent(MidiMessage::controllerEvent(1, 7, 100), 1);
+        midi.addEvent(MidiMessage::noteOn(1, 60, 1.0f), offset);
+        engine.render(output, midi);
+
+        for (int i = 0; i < blockSize; ++i)
+            if (output.getSample(0, i) != 0.0f)
+                return i;
+
+        return -1;
+    }
+}
+
+int main()
+{
+    Wavetables wavetables;
+    wavetables.prepareToPlay(sampleRate);
+
+    std::cout << "Dense MIDI: " << numVoices << " voices, " << numTimedBlocks << " blocks of " << blockSize << " @ " << sampleRate
+              << " Hz, best of " << numRuns << std::endl;
+
+    for (const auto& pattern : patterns)
+    {
+        const auto scheduled = timePattern(wavetables, pattern, Rendering::Scheduled);
+        const auto generic = timePattern(wavetables, pattern, Rendering::Generic);
+        const auto exact = timePattern(wavetables, pattern, Rendering::GenericExact);
+
+        std::cout << "  " << String(pattern.name).paddedRight(' ', 30)
+                  << "  scheduled " << String(scheduled, 4) << " s   split at events " << String(exact, 4)
+                  << " s (" << String(exact / scheduled, 2) << "x)   split, 32 sample minimum " << String(generic, 4)
+                  << " s (" << String(generic / scheduled, 2) << "x)" << std::endl;
+    }
+
+    // where a note sent for a few offsets into the block first sounds (the
+    // saw starts at zero, so a sample after the event)
+    bool isExact = true;
+    String scheduledOnsets, exactOnsets, genericOnsets;
+
+    for (auto offset : { 7, 40, 137, 300 })
+    {
+        const auto scheduled = findOnset(wavetables, Rendering::Scheduled, offset);
+        const auto exact = findOnset(wavetables, Rendering::GenericExact, offset);
+        const auto generic = findOnset(wavetables, Rendering::Generic, offset);
+
+        isExact = isExact && scheduled == exact;
+        scheduledOnsets << " " << offset << "->" << scheduled;
+        exactOnsets << " " << offset << "->" << exact;
+        genericOnsets << " " << offset << "->" << generic;
+    }
+
+    std::cout << "  note onsets, scheduled:              " << scheduledOnsets << std::endl
+              << "  note onsets, split at events:        " << exactOnsets << std::endl
+              << "  note onsets, split with 32 minimum:  " << genericOnsets << std::endl;
+
+    return isExact ? 0 : 1;
+}
@@ -0,0 +1,209 @@
+/**
+ * @file ExpressionBenchmark.cpp
+ *
+ * @brief Times SynthEngine under a dense MPE controller stream, with the
+ *        expression ramped per block against passing every message to the
+ *        Synthesiser, and checks that a per-note bend lands on the right
+ *        pitch.
+ *
+ * @author
+ */
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "../Source/SynthEngine.h"
+
+
+namespace
+{
+    constexpr double sampleRate = 48000.0;
+    constexpr int blockSize = 512;
+    constexpr int numTimedBlocks = 2000;
+    constexpr int numVoices = 8;
+    constexpr int numRuns = 3;
+
+    // Samples between each voice's pitch bend / pressure / timbre messages,
+    // about what an MPE controller sends while every finger is moving.
+    constexpr int messageInterval = 16;
+
+    enum class Delivery
+    {
+        None,           // notes only
+        PerEvent,       // every message goes to the Synthesiser
+        Ramped          // SynthEngine::extractExpression()
+    };
+
+    // A lower zone using channels 2 to 16, with the standard 48 semitone range.
+    MPEZoneLayout makeZoneLayout()
+    {
+        MPEZoneLayout layout;
+        layout.setLowerZone(15);
+        return layout;
+    }
+
+    // a saw through a low pass, or a plain sine to measure the pitch of
+    SynthParameterSnapshot makePatch(int waveform)
+    {
+        SynthParameterSnapshot parameters;
+        parameters.attack = 1.0f;
+        parameters.decay = 100.0f;
+        parameters.sustain = 1.0f;
+        parameters.release = 100.0f;
+        parameters.waveform = float(waveform);
+        parameters.filterType = VoiceFilterType::LowPass;
+        parameters.filterCutoff = waveform == VoiceWaveform::Sine ? 20000.0f : 2000.0f;
+        parameters.filterResonance = 1.0f;
+        parameters.version = 1;
+        return parameters;
+    }
+
+    struct Engine
+    {
+        Engine(const Wavetables& wavetables, int waveform = VoiceWaveform::Saw)
+        {
+            engine.setNumVoices(numVoices, [&] { return new SynthVoice(wavetables); });
+            engine.addSound(new SynthSound());
+            engine.setCurrentPlaybackSampleRate(sampleRate);
+            engine.setZoneLayout(makeZoneLayout());
+
+            for (int i = 0; i < numVoices; ++i)
+                if (auto* voice = dynamic_cast<SynthVoice*>(engine.getVoice(i)))
+                    voice->prepareToPlay(sampleRate, blockSize);
+
+            engine.setParameters(makePatch(waveform));
+        }
+
+        void render(AudioBuffer<float>& output, const MidiBuffer& midi, Delivery delivery)
+        {
+            output.clear();
+
+            if (delivery == Delivery::Ramped)
+                engine.renderNextBlock(output, engine.extractExpression(midi, output.getNumSamples()), 0, output.getNumSamples());
+            else
+                engine.renderNextBlock(output, midi, 0, output.getNumSamples());
+        }
+
+        SynthEngine engine;
+    };
+
+    // One block of every voice's member channel sweeping its bend, pressure
+    // and timbre.
+    void fillExpression(MidiBuffer& midi, int block)
+    {
+        midi.clear();
+
+        for (int position = 0; position < blockSize; position += messageInterval)
+        {
+            const auto phase = MathConstants<double>::twoPi * (block * blockSize + position) / sampleRate;
+
+            for (int voice = 0; voice < numVoices; ++voice)
+            {
+                const auto channel = voice + 2;
+                const auto wobble = std::sin(phase * (1.0 + 0.1 * voice));
+
+                midi.addEvent(MidiMessage::pitchWheel(channel, 8192 + int(200.0 * wobble)), position);
+                midi.addEvent(MidiMessage::channelPressureChange(channel, 64 + int(60.0 * wobble)), position);
+                midi.addEvent(MidiMessage::controllerEvent(channel, NoteExpressionTracker::timbreController, 64 - int(60.0 * wobble)), position);
+            }
+        }
+    }
+
+    double timeRender(const Wavetables& wavetables, Delivery delivery)
+    {
+        Engine setup(wavetables);
+
+        for (int voice = 0; voice < numVoices; ++voice)
+            setup.engine.noteOn(voice + 2, 48 + 3 * voice, 1.0f);
+
+        // the MIDI is made up front so only the rendering is timed
+        std::vector<MidiBuffer> blocks((size_t) numTimedBlocks);
+
+        if (delivery != Delivery::None)
+            for (int block = 0; block < numTimedBlocks; ++block)
+                fillExpression(blocks[(size_t) block], block);
+
+        AudioBuffer<float> output(1, blockSize);
+
+        const auto start = Time::getHighResolutionTicks();
+
+        for (const auto& midi : blocks)
+            setup.render(output, midi, delivery);
+
+        return Time::highResolutionTicksToSeconds(Time::getHighResolutionTicks() - start);
+    }
+
+    // Plays A3 on a member channel bent up an octave, and measures its pitch
+    // from the rising zero crossings of a sine.
+    double measureBentFrequency(const Wavetables& wavetables)
+    {
+        Engine setup(wavetables, VoiceWaveform::Sine);
+
+        MidiBuffer midi;
+        midi.addEvent(MidiMessage::pitchWheel(2, 8192 + 8192 * 12 / 48), 0);
+        midi.addEvent(MidiMessage::noteOn(2, 57, 1.0f), 0);
+
+        AudioBuffer<float> output(1, blockSize);
+        std::vector<float> signal;
+
+        for (int block = 0; block < 32; ++block)
+        {
+            setup.render(output, midi, Delivery::Ramped);
+            midi.clear();
+
+            // skips the attack and the filter settling
+            if (block >= 4)
+                signal.insert(signal.end(), output.getReadPointer(0), output.getReadPointer(0) + blockSize);
+        }
+
+        int firstCrossing = -1, lastCrossing = -1, numCycles = 0;
+
+        for (size_t i = 1; i < signal.size(); ++i)
+        {
+            if (signal[i - 1] < 0.0f && signal[i] >= 0.0f)
+            {
+                if (firstCrossing < 0)
+                    firstCrossing = (int) i;
+                else
+                    ++numCycles;
+
+                lastCrossing = (int) i;
+            }
+        }
+
+        return numCycles > 0 ? numCycles * sampleRate / (lastCrossing - firstCrossing) : 0.0;
+    }
+}
+
+int main()
+{
+    Wavetables wavetables;
+    wavetables.prepareToPlay(sampleRate);
+
+    const auto messagesPerBlock = 3 * numVoices * blockSize / messageInterval;
+
+    std::cout << "Expression: " << numVoices << " MPE voices x " << numTimedBlocks << " blocks of " << blockSize << " @ " << sampleRate
+              << " Hz, " << messagesPerBlock << " expression messages per block, best of " << numRuns << std::endl;
+
+    const std::pair<Delivery, const char*> deliveries[] = {
+        { Delivery::None,     "no expression       " },
+        { Delivery::PerEvent, "per event (ignored) " },
+        { Delivery::Ramped,   "ramped per block    " }
+    };
+
+    for (const auto& delivery : deliveries)
+    {
+        auto seconds = std::numeric_limits<double>::max();
+
+        for (int run = 0; run < numRuns; ++run)
+            seconds = jmin(seconds, timeRender(wavetables, delivery.first));
+
+        std::cout << "  " << delivery.second << String(seconds, 4) << " s" << std::endl;
+    }
+
+    const auto expected = 2.0 * MidiMessage::getMidiNoteInHertz(57);
+    const auto measured = measureBentFrequency(wavetables);
+    const auto isInTune = std::abs(measured - expected) < 0.01 * expected;
+
+    std::cout << "  A3 bent up 12 of 48 semitones: " << String(measured, 1) << " Hz (expected " << String(expected, 1) << " Hz)" << std::endl;
+
+    return isInTune ? 0 : 1;
+}
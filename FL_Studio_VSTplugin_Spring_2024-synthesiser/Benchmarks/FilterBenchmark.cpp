@@ -0,0 +1,116 @@
+/**
+ * @file FilterBenchmark.cpp
+ *
+ * @brief Times the voices' StateVariableFilter against maxiFilter, with a
+ *        fixed cutoff and with the cutoff swept every sample, and checks
+ *        that both stay bounded under the sweep.
+ *
+ * @author
+ */
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "../Source/StateVariableFilter.h"
+#include "maximilian.h"
+
+
+namespace
+{
+    constexpr double sampleRate = 48000.0;
+    constexpr int numSamples = 1 << 22;
+    constexpr int numRuns = 5;
+    constexpr float resonance = 5.0f;
+
+    // A saw, which keeps plenty of energy around the cutoff at every setting.
+    std::vector<float> makeInput()
+    {
+        std::vector<float> input((size_t) numSamples);
+        double phase = 0.0;
+
+        for (auto& sample : input)
+        {
+            sample = float(2.0 * phase - 1.0);
+            phase += 110.0 / sampleRate;
+            phase -= std::floor(phase);
+        }
+
+        return input;
+    }
+
+    // Either a steady 2 kHz or a sweep from 40 Hz to 20 kHz and back ten
+    // times a second, far faster than any automation the host would send.
+    float getCutoff(int sample, bool isSwept)
+    {
+        if (! isSwept)
+            return 2000.0f;
+
+        const auto sweep = 0.5 + 0.5 * std::sin(MathConstants<double>::twoPi * 10.0 * sample / sampleRate);
+        return float(40.0 * std::pow(500.0, sweep));
+    }
+
+    struct FilterResult
+    {
+        double seconds = std::numeric_limits<double>::max();
+        float peak = 0.0f;
+    };
+
+    template <typename FilterFn>
+    void timeFilter(const std::vector<float>& input, bool isSwept, FilterResult& result, FilterFn&& filter)
+    {
+        float peak = 0.0f;
+        const auto start = Time::getHighResolutionTicks();
+
+        for (int i = 0; i < numSamples; ++i)
+            peak = jmax(peak, std::abs(filter(input[(size_t) i], getCutoff(i, isSwept))));
+
+        result.seconds = jmin(result.seconds, Time::highResolutionTicksToSeconds(Time::getHighResolutionTicks() - start));
+        result.peak = peak;
+    }
+
+    String describe(const FilterResult& result)
+    {
+        const auto isStable = std::isfinite(result.peak) && result.peak < 100.0f;
+
+        return String(1.0e9 * result.seconds / numSamples, 2) + " ns/sample, peak "
+             + (std::isfinite(result.peak) ? String(result.peak, 2) : String("inf"))
+             + (isStable ? " (stable)" : " (UNSTABLE)");
+    }
+}
+
+int main()
+{
+    maxiSettings::setup(int(sampleRate), 2, 512);
+
+    const auto input = makeInput();
+
+    std::cout << "Low pass filter: " << numSamples << " samples @ " << sampleRate << " Hz, resonance " << resonance
+              << ", best of " << numRuns << std::endl;
+
+    for (auto isSwept : { false, true })
+    {
+        FilterResult maxiResult, svfResult;
+
+        // timed alternately so neither filter is favoured by running first
+        for (int run = 0; run < numRuns; ++run)
+        {
+            maxiFilter maxi;
+            timeFilter(input, isSwept, maxiResult, [&](float in, float cutoff)
+            {
+                return float(maxi.lores(in, cutoff, resonance));
+            });
+
+            StateVariableFilter svf;
+            svf.setSampleRate(sampleRate);
+            timeFilter(input, isSwept, svfResult, [&](float in, float cutoff)
+            {
+                svf.setCutoffAndResonance(cutoff, resonance);
+                return svf.processSample<StateVariableFilter::LowPass>(in);
+            });
+        }
+
+        std::cout << "  " << (isSwept ? "swept cutoff" : "fixed cutoff") << std::endl
+                  << "    maxiFilter           " << describe(maxiResult) << std::endl
+                  << "    StateVariableFilter  " << describe(svfResult) << std::endl;
+    }
+
+    return 0;
+}
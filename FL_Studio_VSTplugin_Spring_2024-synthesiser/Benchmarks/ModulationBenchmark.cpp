@@ -0,0 +1,116 @@
+/**
+ * @file ModulationBenchmark.cpp
+ *
+ * @brief Times SynthEngine with every modulation route in use, evaluated
+ *        every sample and at control rates of 16, 32 and 64 samples, against
+ *        the same patch without modulation.
+ *
+ * @author
+ */
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "../Source/SynthEngine.h"
+
+
+namespace
+{
+    constexpr double sampleRate = 48000.0;
+    constexpr int blockSize = 512;
+    constexpr int numTimedBlocks = 2000;
+    constexpr int numVoices = 8;
+    constexpr int numRuns = 3;
+
+    const int intervals[] = { 1, 16, 32, 64 };
+
+    SynthParameterSnapshot makePatch(bool isModulated)
+    {
+        SynthParameterSnapshot parameters;
+        parameters.attack = 1.0f;
+        parameters.decay = 100.0f;
+        parameters.sustain = 1.0f;
+        parameters.release = 100.0f;
+        parameters.waveform = VoiceWaveform::Saw;
+        parameters.filterType = VoiceFilterType::LowPass;
+        parameters.filterCutoff = 1000.0f;
+        parameters.filterResonance = 2.0f;
+        parameters.version = 1;
+
+        if (isModulated)
+        {
+            auto& modulation = parameters.modulation;
+            modulation.lfos[0] = { 3.0f, float(ModulationSettings::Sine) };
+            modulation.lfos[1] = { 5.5f, float(ModulationSettings::Triangle) };
+            modulation.envelope2 = { 50.0f, 400.0f, 0.3f, 200.0f };
+
+            modulation.routes[0] = { float(ModulationSettings::Lfo1), float(ModulationSettings::Cutoff), 0.5f };
+            modulation.routes[1] = { float(ModulationSettings::Lfo2), float(ModulationSettings::Pitch), 0.02f };
+            modulation.routes[2] = { float(ModulationSettings::Envelope2), float(ModulationSettings::Cutoff), 0.3f };
+            modulation.routes[3] = { float(ModulationSettings::Lfo1), float(ModulationSettings::Amplitude), -0.3f };
+        }
+
+        return parameters;
+    }
+
+    double timeRender(const Wavetables& wavetables, bool isModulated, int interval)
+    {
+        SynthEngine engine;
+        engine.setNumVoices(numVoices, [&] { return new SynthVoice(wavetables); });
+        engine.addSound(new SynthSound());
+        engine.setCurrentPlaybackSampleRate(sampleRate);
+        engine.setModulationInterval(interval);
+
+        for (int i = 0; i < numVoices; ++i)
+            if (auto* voice = dynamic_cast<SynthVoice*>(engine.getVoice(i)))
+                voice->prepareToPlay(sampleRate, blockSize);
+
+        engine.setParameters(makePatch(isModulated));
+
+        for (int i = 0; i < numVoices; ++i)
+            engine.noteOn(1, 48 + 3 * i, 1.0f);
+
+        AudioBuffer<float> output(1, blockSize);
+        MidiBuffer midi;
+
+        const auto start = Time::getHighResolutionTicks();
+
+        for (int block = 0; block < numTimedBlocks; ++block)
+        {
+            output.clear();
+            engine.renderNextBlock(output, midi, 0, blockSize);
+        }
+
+        return Time::highResolutionTicksToSeconds(Time::getHighResolutionTicks() - start);
+    }
+
+    double bestOf(const std::function<double()>& run)
+    {
+        auto seconds = std::numeric_limits<double>::max();
+
+        for (int i = 0; i < numRuns; ++i)
+            seconds = jmin(seconds, run());
+
+        return seconds;
+    }
+}
+
+int main()
+{
+    Wavetables wavetables;
+    wavetables.prepareToPlay(sampleRate);
+
+    std::cout << "Modulation: " << numVoices << " voices, 4 routes from 2 LFOs and an envelope, " << numTimedBlocks
+              << " blocks of " << blockSize << " @ " << sampleRate << " Hz, best of " << numRuns << std::endl;
+
+    const auto unmodulated = bestOf([&] { return timeRender(wavetables, false, 32); });
+    std::cout << "  no modulation            " << String(unmodulated, 4) << " s" << std::endl;
+
+    for (auto interval : intervals)
+    {
+        const auto seconds = bestOf([&] { return timeRender(wavetables, true, interval); });
+
+        std::cout << "  every " << String(interval).paddedLeft(' ', 2) << (interval == 1 ? " sample " : " samples")
+                  << "         " << String(seconds, 4) << " s   (+" << String(100.0 * (seconds / unmodulated - 1.0), 1) << "%)" << std::endl;
+    }
+
+    return 0;
+}
@@ -0,0 +1,354 @@
+/**
+ * @file OfflineRender.cpp
+ *
+ * @brief Runs the synth processor with no host and no editor: plays a MIDI
+ *        file (or a built-in test sequence) through it as fast as it will
+ *        go, optionally writes the result to a WAV file, and reports how
+ *        long each block took.
+ *
+ * @author
+ */
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "../Source/PluginProcessor.h"
+
+
+namespace
+{
+    const char* const usage =
+        "Usage: OfflineRender [options]\n"
+        "  --midi=<file>          MIDI file to play (default: a built-in test sequence)\n"
+        "  --out=<file.wav>       write the render to a WAV file; with several rates or\n"
+        "                         block sizes each run gets its own file\n"
+        "  --rates=<list>         sample rates to run, comma separated (default 48000)\n"
+        "  --blocks=<list>        block sizes to run, comma separated (default 512)\n"
+        "  --voices=<n>           number of voices (default the plugin's own)\n"
+        "  --bank                 render through SynthVoiceBank\n"
+        "  --parallel=<n>         render on worker threads once n voices are playing\n"
+        "  --oversampling=<n>     run the voices at 1x, 2x or 4x the sample rate\n"
+        "  --samples=<dir>        play a directory of WAV files, streamed from disk,\n"
+        "                         instead of the synth voices\n";
+
+    struct RenderSettings
+    {
+        double sampleRate = 48000.0;
+        int blockSize = 512;
+        int numVoices = JuceSynthFrameworkAudioProcessor::defaultNumVoices;
+        bool useVoiceBank = false;
+        int parallelThreshold = 0;      // 0 leaves parallel rendering off
+        int oversamplingFactor = 1;
+        File sampleDirectory;           // none plays the synth
+    };
+
+    struct RenderStats
+    {
+        std::vector<double> blockSeconds;
+        double audioSeconds = 0.0;
+        double averageActiveVoices = 0.0;
+        int peakActiveVoices = 0;
+    };
+
+    // Two bars of sustained chords, then a fast arpeggio over a held bass
+    // note, repeated: enough to keep a handful of voices busy and exercise
+    // note stealing at the default voice count.
+    MidiMessageSequence makeTestSequence()
+    {
+        MidiMessageSequence sequence;
+
+        const int chords[][4] = { { 48, 55, 60, 64 }, { 45, 52, 57, 60 }, { 41, 48, 53, 57 }, { 43, 50, 55, 59 } };
+        double time = 0.0;
+
+        for (int repeat = 0; repeat < 2; ++repeat)
+        {
+            for (auto& chord : chords)
+            {
+                for (auto note : chord)
+                {
+                    sequence.addEvent(MidiMessage::noteOn(1, note, 0.8f), time);
+                    sequence.addEvent(MidiMessage::noteOff(1, note), time + 1.9);
+                }
+
+                time += 2.0;
+            }
+
+            sequence.addEvent(MidiMessage::noteOn(1, 36, 0.8f), time);
+
+            for (int step = 0; step < 64; ++step)
+            {
+                const auto note = chords[(step / 16) % 4][step % 4] + 12;
+                sequence.addEvent(MidiMessage::noteOn(1, note, 0.7f), time + step * 0.125);
+                sequence.addEvent(MidiMessage::noteOff(1, note), time + step * 0.125 + 0.1);
+            }
+
+            time += 8.0;
+            sequence.addEvent(MidiMessage::noteOff(1, 36), time);
+        }
+
+        sequence.updateMatchedPairs();
+        return sequence;
+    }
+
+    // Merges every track into one sequence timed in seconds.
+    bool readMidiFile(const File& file, MidiMessageSequence& sequence)
+    {
+        FileInputStream stream(file);
+        MidiFile midiFile;
+
+        if (! stream.openedOk() || ! midiFile.readFrom(stream))
+            return false;
+
+        midiFile.convertTimestampTicksToSeconds();
+
+        for (int track = 0; track < midiFile.getNumTracks(); ++track)
+            sequence.addSequence(*midiFile.getTrack(track), 0.0);
+
+        sequence.updateMatchedPairs();
+        return true;
+    }
+
+    Array<int> parseList(const String& text, int defaultValue)
+    {
+        Array<int> values;
+
+        for (auto& token : StringArray::fromTokens(text, ",", {}))
+            if (token.getIntValue() > 0)
+                values.add(token.getIntValue());
+
+        if (values.isEmpty())
+            values.add(defaultValue);
+
+        return values;
+    }
+
+    RenderStats render(const MidiMessageSequence& sequence, const RenderSettings& settings, AudioFormatWriter* writer)
+    {
+        JuceSynthFrameworkAudioProcessor processor;
+        processor.setNumVoices(settings.numVoices);
+        processor.setVoiceBankEnabled(settings.useVoiceBank);
+        processor.setOversamplingFactor(settings.oversamplingFactor);
+
+        const int numChannels = processor.getTotalNumOutputChannels();
+        processor.setPlayConfigDetails(0, numChannels, settings.sampleRate, settings.blockSize);
+        processor.prepareToPlay(settings.sampleRate, settings.blockSize);
+
+        if (settings.parallelThreshold > 0)
+            processor.setParallelRenderingEnabled(true, settings.parallelThreshold);
+
+        // faster than real time, so the samples are streamed between blocks
+        if (settings.sampleDirectory != File())
+        {
+            processor.setNonRealtime(true);
+            processor.loadSampleLibrary(settings.sampleDirectory);
+        }
+
+        // plays to the end of the last event, then lets the release ring out
+        const auto lengthSeconds = sequence.getEndTime() + processor.getTailLengthSeconds();
+        const auto totalSamples = (int64) std::ceil(lengthSeconds * settings.sampleRate);
+
+        AudioBuffer<float> buffer(numChannels, settings.blockSize);
+        MidiBuffer midi;
+        RenderStats stats;
+        stats.blockSeconds.reserve((size_t) (totalSamples / settings.blockSize + 1));
+
+        int nextEvent = 0;
+        int64 totalActiveVoices = 0;
+
+        for (int64 position = 0; position < totalSamples; position += settings.blockSize)
+        {
+            const int numSamples = (int) jmin((int64) settings.blockSize, totalSamples - position);
+            const auto blockEnd = position + numSamples;
+
+            midi.clear();
+
+            for (; nextEvent < sequence.getNumEvents(); ++nextEvent)
+            {
+                const auto& message = sequence.getEventPointer(nextEvent)->message;
+                const auto samplePosition = (int64) (message.getTimeStamp() * settings.sampleRate);
+
+                if (samplePosition >= blockEnd)
+                    break;
+
+                if (! message.isMetaEvent())
+                    midi.addEvent(message, (int) jmax((int64) 0, samplePosition - position));
+            }
+
+            buffer.setSize(numChannels, numSamples, false, false, true);
+
+            // Time's high resolution ticks are only microseconds on Linux,
+            // which is too coarse for small blocks
+            const auto start = std::chrono::steady_clock::now();
+            processor.processBlock(buffer, midi);
+            stats.blockSeconds.push_back(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+
+            const auto numActive = processor.getNumActiveVoices();
+            totalActiveVoices += numActive;
+            stats.peakActiveVoices = jmax(stats.peakActiveVoices, numActive);
+
+            if (writer != nullptr)
+                writer->writeFromAudioSampleBuffer(buffer, 0, numSamples);
+        }
+
+        processor.releaseResources();
+
+        stats.audioSeconds = (double) totalSamples / settings.sampleRate;
+        stats.averageActiveVoices = stats.blockSeconds.empty() ? 0.0 : (double) totalActiveVoices / (double) stats.blockSeconds.size();
+        return stats;
+    }
+
+    double getPercentile(const std::vector<double>& sorted, double percentile)
+    {
+        if (sorted.empty())
+            return 0.0;
+
+        const auto index = (size_t) jlimit(0.0, (double) sorted.size() - 1.0, std::ceil(percentile / 100.0 * (double) sorted.size()) - 1.0);
+        return sorted[index];
+    }
+
+    void report(const RenderSettings& settings, RenderStats stats)
+    {
+        std::sort(stats.blockSeconds.begin(), stats.blockSeconds.end());
+
+        const auto renderSeconds = std::accumulate(stats.blockSeconds.begin(), stats.blockSeconds.end(), 0.0);
+        const auto blockBudget = settings.blockSize / settings.sampleRate;
+        const auto toMicroseconds = [] (double seconds) { return String(1.0e6 * seconds, 2); };
+
+        std::cout << "  " << settings.sampleRate << " Hz, " << settings.blockSize << " samples: "
+                  << stats.blockSeconds.size() << " blocks, " << String(stats.audioSeconds, 2) << " s of audio" << std::endl
+                  << "    block time (us)  p50 " << toMicroseconds(getPercentile(stats.blockSeconds, 50.0))
+                  << "   p90 " << toMicroseconds(getPercentile(stats.blockSeconds, 90.0))
+                  << "   p99 " << toMicroseconds(getPercentile(stats.blockSeconds, 99.0))
+                  << "   max " << toMicroseconds(stats.blockSeconds.empty() ? 0.0 : stats.blockSeconds.back())
+                  << "   budget " << toMicroseconds(blockBudget) << std::endl
+                  << "    voices active    average " << String(stats.averageActiveVoices, 2)
+                  << "   peak " << stats.peakActiveVoices << "/" << settings.numVoices << std::endl
+                  << "    real-time factor " << String(renderSeconds / stats.audioSeconds, 5)
+                  << " (" << String(stats.audioSeconds / jmax(1.0e-9, renderSeconds), 1) << "x faster than real time)" << std::endl;
+    }
+
+    File getOutputFile(const File& requested, const RenderSettings& settings, bool isOnlyRun)
+    {
+        if (isOnlyRun)
+            return requested;
+
+        return requested.getSiblingFile(requested.getFileNameWithoutExtension()
+                                        + "-" + String((int) settings.sampleRate) + "Hz-" + String(settings.blockSize)
+                                        + requested.getFileExtension());
+    }
+
+    int runOfflineRender(const ArgumentList& args)
+    {
+        if (args.containsOption("--help|-h"))
+        {
+            std::cout << usage;
+            return 0;
+        }
+
+        // the processor's parameter state expects a message manager to exist
+        ScopedJuceInitialiser_GUI juceInitialiser;
+
+        MidiMessageSequence sequence;
+        String sequenceName = "built-in test sequence";
+
+        if (args.containsOption("--midi"))
+        {
+            const auto midiFile = args.getExistingFileForOption("--midi");
+
+            if (! readMidiFile(midiFile, sequence))
+            {
+                std::cerr << "Couldn't read MIDI file " << midiFile.getFullPathName() << std::endl;
+                return 1;
+            }
+
+            sequenceName = midiFile.getFileName();
+        }
+        else
+        {
+            sequence = makeTestSequence();
+        }
+
+        const auto sampleRates = parseList(args.getValueForOption("--rates"), 48000);
+        const auto blockSizes = parseList(args.getValueForOption("--blocks"), 512);
+
+        RenderSettings settings;
+        settings.useVoiceBank = args.containsOption("--bank");
+
+        if (args.containsOption("--voices"))
+            settings.numVoices = jmax(1, args.getValueForOption("--voices").getIntValue());
+
+        if (args.containsOption("--parallel"))
+            settings.parallelThreshold = jmax(1, args.getValueForOption("--parallel").getIntValue());
+
+        if (args.containsOption("--oversampling"))
+        {
+            settings.oversamplingFactor = args.getValueForOption("--oversampling").getIntValue();
+
+            if (settings.oversamplingFactor != 1 && settings.oversamplingFactor != 2 && settings.oversamplingFactor != 4)
+                ConsoleApplication::fail("--oversampling must be 1, 2 or 4");
+        }
+
+        if (args.containsOption("--samples"))
+        {
+            settings.sampleDirectory = args.getExistingFolderForOption("--samples");
+
+            if (settings.sampleDirectory.findChildFiles(File::findFiles, false, "*.wav;*.WAV").isEmpty())
+                ConsoleApplication::fail("No WAV files in " + settings.sampleDirectory.getFullPathName());
+        }
+
+        const auto outputFile = args.containsOption("--out") ? args.getFileForOption("--out") : File();
+        const auto isOnlyRun = sampleRates.size() == 1 && blockSizes.size() == 1;
+
+        std::cout << "Offline render: " << sequenceName << ", " << sequence.getNumEvents() << " events, "
+                  << settings.numVoices << " voices" << (settings.useVoiceBank ? ", voice bank" : "")
+                  << (settings.parallelThreshold > 0 ? ", parallel from " + String(settings.parallelThreshold) + " voices" : String())
+                  << (settings.oversamplingFactor > 1 ? ", " + String(settings.oversamplingFactor) + "x oversampled" : String())
+                  << (settings.sampleDirectory != File() ? ", samples from " + settings.sampleDirectory.getFileName() : String())
+                  << std::endl;
+
+        for (auto sampleRate : sampleRates)
+        {
+            for (auto blockSize : blockSizes)
+            {
+                settings.sampleRate = sampleRate;
+                settings.blockSize = blockSize;
+
+                std::unique_ptr<AudioFormatWriter> writer;
+                File file;
+
+                if (outputFile != File())
+                {
+                    file = getOutputFile(outputFile, settings, isOnlyRun);
+                    file.deleteFile();
+
+                    if (auto stream = std::unique_ptr<OutputStream>(file.createOutputStream()))
+                    {
+                        writer.reset(WavAudioFormat().createWriterFor(stream.get(), sampleRate, 2, 24, {}, 0));
+
+                        if (writer != nullptr)
+                            stream.release();   // the writer owns it now
+                    }
+
+                    if (writer == nullptr)
+                    {
+                        std::cerr << "Couldn't write to " << file.getFullPathName() << std::endl;
+                        return 1;
+                    }
+                }
+
+                report(settings, render(sequence, settings, writer.get()));
+
+                if (writer != nullptr)
+                    std::cout << "    wrote " << file.getFullPathName() << std::endl;
+            }
+        }
+
+        return 0;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    return ConsoleApplication::invokeCatchingFailures([&]
+    {
+        return runOfflineRender(ArgumentList(argc, argv));
+    });
+}
@@ -0,0 +1,179 @@
+/**
+ * @file OversamplingBenchmark.cpp
+ *
+ * @brief Measures how much a high saw note aliases through SynthEngine at
+ *        1x, 2x and 4x oversampling, and what each factor costs to render.
+ *
+ * @author
+ */
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "../Source/SynthEngine.h"
+
+
+namespace
+{
+    constexpr double sampleRate = 48000.0;
+    constexpr int blockSize = 512;
+    constexpr int numTimedBlocks = 2000;
+    constexpr int numTimedVoices = 8;
+    constexpr int numRuns = 3;
+
+    const int factors[] = { 1, 2, 4 };
+
+    // G6 (about 1.6 kHz): every harmonic from the 16th up is past Nyquist
+    // at the host rate, and folds back unless something band-limits it.
+    constexpr int highNote = 91;
+    constexpr int aliasingLength = 4096;
+
+    // An engine set up the way the processor does it for a given factor.
+    struct OversampledEngine
+    {
+        OversampledEngine(const Wavetables& wavetables, int factor, bool useVoiceBank, int numVoices)
+        {
+            oversampler.setFactor(factor);
+
+            engine.setNumVoices(numVoices, [&] { return new SynthVoice(wavetables); });
+            engine.addSound(new SynthSound());
+            engine.setCurrentPlaybackSampleRate(sampleRate * factor);
+
+            for (int i = 0; i < numVoices; ++i)
+                if (auto* voice = dynamic_cast<SynthVoice*>(engine.getVoice(i)))
+                    voice->prepareToPlay(sampleRate * factor, blockSize * factor);
+
+            bank->prepareToPlay(sampleRate * factor, blockSize * factor);
+            oversampler.prepare(1, blockSize);
+
+            engine.setVoiceBank(useVoiceBank ? bank.get() : nullptr);
+            engine.setOversampler(factor > 1 ? &oversampler : nullptr);
+
+            // a bright, resonant patch with the filter wide open
+            SynthParameterSnapshot parameters;
+            parameters.attack = 1.0f;
+            parameters.decay = 100.0f;
+            parameters.sustain = 1.0f;
+            parameters.release = 100.0f;
+            parameters.waveform = VoiceWaveform::Saw;
+            parameters.filterType = VoiceFilterType::LowPass;
+            parameters.filterCutoff = 18000.0f;
+            parameters.filterResonance = 3.0f;
+            parameters.version = 1;
+            engine.setParameters(parameters);
+        }
+
+        // in blocks no bigger than the ones everything was prepared for
+        void render(AudioBuffer<float>& output)
+        {
+            MidiBuffer midi;
+            output.clear();
+
+            for (int start = 0; start < output.getNumSamples(); start += blockSize)
+                engine.renderNextBlock(output, midi, start, jmin(blockSize, output.getNumSamples() - start));
+        }
+
+        std::unique_ptr<SynthVoiceBank> bank = std::make_unique<SynthVoiceBank>();
+        Oversampler oversampler;
+        SynthEngine engine;
+    };
+
+    // Energy more than a few bins away from any harmonic of the note,
+    // relative to the total, from a Blackman-Harris windowed DFT (the note
+    // doesn't fit the DFT length exactly, and the window keeps its leakage
+    // well below the aliases).
+    double measureAliasing(const float* signal)
+    {
+        const auto frequency = MidiMessage::getMidiNoteInHertz(highNote);
+        const auto binsPerHarmonic = frequency * aliasingLength / sampleRate;
+
+        std::vector<double> windowed((size_t) aliasingLength);
+
+        for (int i = 0; i < aliasingLength; ++i)
+        {
+            const auto phase = MathConstants<double>::twoPi * i / (aliasingLength - 1);
+            const auto window = 0.35875 - 0.48829 * std::cos(phase) + 0.14128 * std::cos(2.0 * phase) - 0.01168 * std::cos(3.0 * phase);
+            windowed[(size_t) i] = signal[i] * window;
+        }
+
+        double harmonicEnergy = 0.0, otherEnergy = 0.0;
+
+        for (int bin = 1; bin < aliasingLength / 2; ++bin)
+        {
+            double re = 0.0, im = 0.0;
+
+            for (int i = 0; i < aliasingLength; ++i)
+            {
+                const auto angle = MathConstants<double>::twoPi * bin * i / aliasingLength;
+                re += windowed[(size_t) i] * std::cos(angle);
+                im += windowed[(size_t) i] * std::sin(angle);
+            }
+
+            const auto energy = re * re + im * im;
+            const auto harmonic = std::round(bin / binsPerHarmonic);
+
+            if (harmonic >= 1.0 && std::abs(bin - harmonic * binsPerHarmonic) <= 4.0)
+                harmonicEnergy += energy;
+            else
+                otherEnergy += energy;
+        }
+
+        return otherEnergy / jmax(1.0e-30, harmonicEnergy + otherEnergy);
+    }
+
+    double measureAliasing(const Wavetables& wavetables, int factor, bool useVoiceBank)
+    {
+        OversampledEngine setup(wavetables, factor, useVoiceBank, 1);
+        setup.engine.noteOn(1, highNote, 1.0f);
+
+        AudioBuffer<float> output(1, aliasingLength);
+
+        // skips the attack and the decimators filling up
+        setup.render(output);
+        setup.render(output);
+
+        return measureAliasing(output.getReadPointer(0));
+    }
+
+    double timeRender(const Wavetables& wavetables, int factor, bool useVoiceBank)
+    {
+        OversampledEngine setup(wavetables, factor, useVoiceBank, numTimedVoices);
+
+        for (int i = 0; i < numTimedVoices; ++i)
+            setup.engine.noteOn(1, 48 + 3 * i, 1.0f);
+
+        AudioBuffer<float> output(1, blockSize);
+
+        const auto start = Time::getHighResolutionTicks();
+
+        for (int block = 0; block < numTimedBlocks; ++block)
+            setup.render(output);
+
+        return Time::highResolutionTicksToSeconds(Time::getHighResolutionTicks() - start);
+    }
+}
+
+int main()
+{
+    Wavetables wavetables;
+    wavetables.prepareToPlay(sampleRate);
+
+    std::cout << "Oversampling: saw through a resonant low pass @ " << sampleRate << " Hz, "
+              << numTimedVoices << " voices x " << numTimedBlocks << " blocks of " << blockSize << ", best of " << numRuns << std::endl;
+
+    for (auto useVoiceBank : { false, true })
+    {
+        std::cout << "  " << (useVoiceBank ? "SynthVoiceBank" : "SynthVoice") << std::endl;
+
+        for (auto factor : factors)
+        {
+            auto seconds = std::numeric_limits<double>::max();
+
+            for (int run = 0; run < numRuns; ++run)
+                seconds = jmin(seconds, timeRender(wavetables, factor, useVoiceBank));
+
+            std::cout << "    " << factor << "x   render " << String(seconds, 4) << " s   aliased energy at "
+                      << String(MidiMessage::getMidiNoteInHertz(highNote), 1) << " Hz " << String(100.0 * measureAliasing(wavetables, factor, useVoiceBank), 3) << "%" << std::endl;
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,144 @@
+/**
+ * @file PrecisionBenchmark.cpp
+ *
+ * @brief Times SynthEngine rendering into float and double buffers, for a
+ *        single oscillator per note and a unison stack, and checks that the
+ *        two precisions produce the same output.
+ *
+ * @author
+ */
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "../Source/SynthEngine.h"
+
+
+namespace
+{
+    constexpr double sampleRate = 48000.0;
+    constexpr int blockSize = 512;
+    constexpr int numTimedBlocks = 2000;
+    constexpr int numVoices = 8;
+    constexpr int numRuns = 3;
+
+    SynthParameterSnapshot makePatch(int unisonVoices)
+    {
+        SynthParameterSnapshot parameters;
+        parameters.attack = 1.0f;
+        parameters.decay = 100.0f;
+        parameters.sustain = 1.0f;
+        parameters.release = 100.0f;
+        parameters.waveform = VoiceWaveform::Saw;
+        parameters.filterType = VoiceFilterType::LowPass;
+        parameters.filterCutoff = 2000.0f;
+        parameters.filterResonance = 2.0f;
+        parameters.unisonVoices = float(unisonVoices);
+        parameters.unisonDetune = 25.0f;
+        parameters.unisonSpread = 0.8f;
+        parameters.version = 1;
+        return parameters;
+    }
+
+    // An engine playing a chord, rendering stereo blocks of SampleType.
+    template <typename SampleType>
+    struct Render
+    {
+        Render(const Wavetables& wavetables, int unisonVoices)
+        {
+            engine.setNumVoices(numVoices, [&] { return new SynthVoice(wavetables); });
+            engine.addSound(new SynthSound());
+            engine.setCurrentPlaybackSampleRate(sampleRate);
+
+            for (int i = 0; i < numVoices; ++i)
+                if (auto* voice = dynamic_cast<SynthVoice*>(engine.getVoice(i)))
+                    voice->prepareToPlay(sampleRate, blockSize);
+
+            engine.setParameters(makePatch(unisonVoices));
+
+            for (int i = 0; i < numVoices; ++i)
+                engine.noteOn(1, 48 + 3 * i, 1.0f);
+        }
+
+        const AudioBuffer<SampleType>& renderBlock()
+        {
+            output.clear();
+            engine.renderNextBlock(output, midi, 0, blockSize);
+            return output;
+        }
+
+        SynthEngine engine;
+        AudioBuffer<SampleType> output { 2, blockSize };
+        MidiBuffer midi;
+    };
+
+    template <typename SampleType>
+    double timeRender(const Wavetables& wavetables, int unisonVoices)
+    {
+        Render<SampleType> render(wavetables, unisonVoices);
+
+        const auto start = Time::getHighResolutionTicks();
+
+        for (int block = 0; block < numTimedBlocks; ++block)
+            render.renderBlock();
+
+        return Time::highResolutionTicksToSeconds(Time::getHighResolutionTicks() - start);
+    }
+
+    // The largest difference between the two precisions over a second of
+    // output; the float path rounds every sample, so it should be tiny.
+    double measureDifference(const Wavetables& wavetables, int unisonVoices)
+    {
+        Render<float> floatRender(wavetables, unisonVoices);
+        Render<double> doubleRender(wavetables, unisonVoices);
+
+        double difference = 0.0;
+
+        for (int block = 0; block < int(sampleRate) / blockSize; ++block)
+        {
+            const auto& floatOutput = floatRender.renderBlock();
+            const auto& doubleOutput = doubleRender.renderBlock();
+
+            for (int channel = 0; channel < 2; ++channel)
+                for (int i = 0; i < blockSize; ++i)
+                    difference = jmax(difference, std::abs(double(floatOutput.getSample(channel, i)) - doubleOutput.getSample(channel, i)));
+        }
+
+        return difference;
+    }
+
+    double bestOf(const std::function<double()>& run)
+    {
+        auto seconds = std::numeric_limits<double>::max();
+
+        for (int i = 0; i < numRuns; ++i)
+            seconds = jmin(seconds, run());
+
+        return seconds;
+    }
+}
+
+int main()
+{
+    Wavetables wavetables;
+    wavetables.prepareToPlay(sampleRate);
+
+    std::cout << "Precision: " << numVoices << " voices, stereo, " << numTimedBlocks << " blocks of " << blockSize
+              << " @ " << sampleRate << " Hz, best of " << numRuns << std::endl;
+
+    bool matches = true;
+
+    for (auto unisonVoices : { 1, 7 })
+    {
+        const auto floatSeconds = bestOf([&] { return timeRender<float>(wavetables, unisonVoices); });
+        const auto doubleSeconds = bestOf([&] { return timeRender<double>(wavetables, unisonVoices); });
+        const auto difference = measureDifference(wavetables, unisonVoices);
+
+        std::cout << "  " << unisonVoices << (unisonVoices == 1 ? " oscillator" : " voice unison") << " per note" << std::endl
+                  << "    float          " << String(floatSeconds, 4) << " s" << std::endl
+                  << "    double         " << String(doubleSeconds, 4) << " s   (" << String(doubleSeconds / floatSeconds, 2) << "x float)" << std::endl
+                  << "    largest difference " << String(Decibels::gainToDecibels(difference, -200.0), 1) << " dB" << std::endl;
+
+        matches = matches && difference < 1.0e-4;
+    }
+
+    return matches ? 0 : 1;
+}
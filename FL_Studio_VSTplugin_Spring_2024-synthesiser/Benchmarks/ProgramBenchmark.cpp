@@ -0,0 +1,172 @@
+/**
+ * @file ProgramBenchmark.cpp
+ *
+ * @brief Times building a program bank from preset files, and switching
+ *        programs while notes play, with MIDI program changes against
+ *        setting every parameter at the start of each block, and checks that
+ *        a MIDI program change ends up in the parameters.
+ *
+ * @author
+ */
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "../Source/PluginProcessor.h"
+
+
+namespace
+{
+    constexpr double sampleRate = 48000.0;
+    constexpr int blockSize = 256;
+    constexpr int numPresetFiles = 100;
+    constexpr int numNotes = 8;
+    constexpr int numBlocks = 2000;
+    constexpr int numRuns = 5;
+
+    File writePresets()
+    {
+        auto directory = File::getSpecialLocation(File::tempDirectory).getChildFile("ProgramBenchmarkPresets");
+        directory.deleteRecursively();
+        directory.createDirectory();
+
+        JuceSynthFrameworkAudioProcessor processor;
+        Random random(7);
+
+        for (int i = 0; i < numPresetFiles; ++i)
+        {
+            for (auto* parameter : processor.getParameters())
+                parameter->setValueNotifyingHost(random.nextFloat());
+
+            MemoryBlock state;
+            processor.getStateInformation(state);
+            directory.getChildFile("Preset " + String(i).paddedLeft('0', 3) + ".synpreset").replaceWithData(state.getData(), state.getSize());
+        }
+
+        return directory;
+    }
+
+    Array<float> getParameterValues(const AudioProcessor& processor)
+    {
+        Array<float> values;
+
+        for (auto* parameter : processor.getParameters())
+            values.add(parameter->getValue());
+
+        return values;
+    }
+
+    struct BlockTimes
+    {
+        double meanMs = 0.0;
+        double worstMs = 0.0;
+    };
+
+    /** Plays numNotes held notes and switches to the next program every
+        block, either with a MIDI program change or by setting the program's
+        parameters first, as a host or editor rebuilding the sound would.
+    */
+    BlockTimes timeSwitching(JuceSynthFrameworkAudioProcessor& processor, bool useMidi)
+    {
+        AudioBuffer<float> buffer(2, blockSize);
+        MidiBuffer midi;
+
+        for (int i = 0; i < numNotes; ++i)
+            midi.addEvent(MidiMessage::noteOn(1, 48 + 3 * i, 0.8f), 0);
+
+        processor.processBlock(buffer, midi);
+
+        const auto numPrograms = processor.getNumPrograms();
+        BlockTimes times;
+
+        for (int block = 0; block < numBlocks; ++block)
+        {
+            const auto program = block % numPrograms;
+            midi.clear();
+
+            const auto start = Time::getHighResolutionTicks();
+
+            if (useMidi)
+                midi.addEvent(MidiMessage::programChange(1, program), 0);
+            else
+                processor.setCurrentProgram(program);
+
+            processor.processBlock(buffer, midi);
+
+            const auto ms = 1000.0 * Time::highResolutionTicksToSeconds(Time::getHighResolutionTicks() - start);
+            times.meanMs += ms / numBlocks;
+            times.worstMs = jmax(times.worstMs, ms);
+
+            if (useMidi)
+                processor.publishProgramChange();
+        }
+
+        return times;
+    }
+}
+
+int main()
+{
+    // the processors' parameter state expects a message manager to exist
+    ScopedJuceInitialiser_GUI juceInitialiser;
+
+    const auto directory = writePresets();
+
+    JuceSynthFrameworkAudioProcessor processor;
+    processor.prepareToPlay(sampleRate, blockSize);
+
+    auto loadSeconds = std::numeric_limits<double>::max();
+    int numLoaded = 0;
+
+    for (int run = 0; run < numRuns; ++run)
+    {
+        const auto start = Time::getHighResolutionTicks();
+        numLoaded = processor.loadPresetDirectory(directory);
+        loadSeconds = jmin(loadSeconds, Time::highResolutionTicksToSeconds(Time::getHighResolutionTicks() - start));
+    }
+
+    const auto numPrograms = processor.getNumPrograms();
+
+    // a program change in a block is heard in that block; once published,
+    // the parameters match what setCurrentProgram() gives
+    JuceSynthFrameworkAudioProcessor reference;
+    reference.loadPresetDirectory(directory);
+
+    int numMismatched = 0;
+
+    for (int program = 0; program < numPrograms; program += 7)
+    {
+        AudioBuffer<float> buffer(2, blockSize);
+        MidiBuffer midi;
+        midi.addEvent(MidiMessage::programChange(1, program), 0);
+
+        processor.processBlock(buffer, midi);
+        processor.publishProgramChange();
+        reference.setCurrentProgram(program);
+
+        const auto values = getParameterValues(processor);
+        const auto expected = getParameterValues(reference);
+
+        for (int i = 0; i < values.size(); ++i)
+            if (std::abs(values[i] - expected[i]) > 1.0e-6f)
+                ++numMismatched;
+
+        if (processor.getCurrentProgram() != program)
+            ++numMismatched;
+    }
+
+    auto midiTimes = timeSwitching(processor, true);
+    auto parameterTimes = timeSwitching(processor, false);
+
+    const auto budgetMs = 1000.0 * blockSize / sampleRate;
+
+    std::cout << "Programs: " << numLoaded << " preset files plus " << numPrograms - numLoaded << " factory programs, "
+              << processor.getParameters().size() << " parameters each" << std::endl
+              << "  bank built off the audio thread in " << String(1000.0 * loadSeconds, 2) << " ms" << std::endl
+              << "  switching every block with " << numNotes << " notes held (" << blockSize << " samples, budget " << String(budgetMs, 2) << " ms)" << std::endl
+              << "    MIDI program change   mean " << String(1000.0 * midiTimes.meanMs, 1) << " us   worst " << String(1000.0 * midiTimes.worstMs, 1) << " us" << std::endl
+              << "    setting parameters    mean " << String(1000.0 * parameterTimes.meanMs, 1) << " us   worst " << String(1000.0 * parameterTimes.worstMs, 1) << " us" << std::endl
+              << "  published programs " << (numMismatched == 0 ? "match" : String(numMismatched) + " values differ") << std::endl;
+
+    directory.deleteRecursively();
+
+    return numMismatched == 0 && numLoaded == numPresetFiles ? 0 : 1;
+}
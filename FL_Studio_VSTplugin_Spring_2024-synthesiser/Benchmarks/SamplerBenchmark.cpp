@@ -0,0 +1,246 @@
+/**
+ * @file SamplerBenchmark.cpp
+ *
+ * @brief Writes a multisampled library to a temporary directory, then times
+ *        opening it with StreamingSampler against reading every file into
+ *        memory, checks that a note streamed from disk plays its sample
+ *        exactly, and counts underruns while voices stream in real time.
+ *
+ * @author
+ */
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "../Source/StreamingSampler.h"
+
+
+namespace
+{
+    constexpr double sampleRate = 48000.0;
+    constexpr int blockSize = 512;
+    constexpr int numRoots = 8;
+    constexpr int numLayers = 2;
+    constexpr double sampleSeconds = 20.0;
+    constexpr int numRealtimeVoices = 16;
+    constexpr double realtimeSeconds = 3.0;
+
+    int getRootNote(int index)    { return 36 + 6 * index; }
+
+    // A decaying tone at the root with a little noise, so that no two
+    // frames are alike and a misplaced one shows up.
+    bool writeSample(const File& file, int rootNote, float level)
+    {
+        file.deleteFile();
+        std::unique_ptr<OutputStream> stream (file.createOutputStream().release());
+
+        if (stream == nullptr)
+            return false;
+
+        WavAudioFormat wavFormat;
+        std::unique_ptr<AudioFormatWriter> writer (wavFormat.createWriterFor(stream.get(), sampleRate, 2, 24, {}, 0));
+
+        if (writer == nullptr)
+            return false;
+
+        stream.release();
+
+        const auto numFrames = int(sampleSeconds * sampleRate);
+        const auto frequency = MidiMessage::getMidiNoteInHertz(rootNote);
+        AudioBuffer<float> chunk(2, 8192);
+        Random random(rootNote);
+
+        for (int start = 0; start < numFrames; start += chunk.getNumSamples())
+        {
+            const auto numSamples = jmin(chunk.getNumSamples(), numFrames - start);
+
+            for (int i = 0; i < numSamples; ++i)
+            {
+                const auto t = (start + i) / sampleRate;
+                const auto tone = level * std::exp(-0.2 * t) * std::sin(MathConstants<double>::twoPi * frequency * t);
+
+                chunk.setSample(0, i, float(tone + 0.01 * (random.nextFloat() - 0.5f)));
+                chunk.setSample(1, i, float(tone + 0.01 * (random.nextFloat() - 0.5f)));
+            }
+
+            writer->writeFromAudioSampleBuffer(chunk, 0, numSamples);
+        }
+
+        return true;
+    }
+
+    File writeLibrary(int64& totalBytes)
+    {
+        auto directory = File::getSpecialLocation(File::tempDirectory).getChildFile("SamplerBenchmarkLibrary");
+        directory.createDirectory();
+
+        const char* const names[] = { "C", "F#" };
+        totalBytes = 0;
+
+        for (int root = 0; root < numRoots; ++root)
+        {
+            const auto note = getRootNote(root);
+            const auto noteName = String(names[(note % 12) / 6]) + String(note / 12 - 1);
+
+            for (int layer = 0; layer < numLayers; ++layer)
+            {
+                const auto velocity = 127 * (layer + 1) / numLayers;
+                auto file = directory.getChildFile("Test_" + noteName + "_v" + String(velocity) + ".wav");
+
+                if (! file.existsAsFile() && ! writeSample(file, note, 0.4f + 0.4f * layer))
+                    return {};
+
+                totalBytes += file.getSize();
+            }
+        }
+
+        return directory;
+    }
+
+    // What a sampler that keeps its samples in memory has to do on load.
+    double timeReadingIntoMemory(const File& directory, size_t& bytes)
+    {
+        WavAudioFormat wavFormat;
+        std::vector<AudioBuffer<float>> samples;
+        bytes = 0;
+
+        const auto start = Time::getHighResolutionTicks();
+
+        for (const auto& file : directory.findChildFiles(File::findFiles, false, "*.wav"))
+        {
+            std::unique_ptr<AudioFormatReader> reader (wavFormat.createReaderFor(file.createInputStream().release(), true));
+
+            if (reader == nullptr)
+                continue;
+
+            samples.emplace_back(int(reader->numChannels), int(reader->lengthInSamples));
+            reader->read(&samples.back(), 0, int(reader->lengthInSamples), 0, true, true);
+            bytes += size_t(reader->numChannels) * size_t(reader->lengthInSamples) * sizeof(float);
+        }
+
+        return Time::highResolutionTicksToSeconds(Time::getHighResolutionTicks() - start);
+    }
+
+    void prepare(StreamingSampler& sampler)
+    {
+        sampler.setCurrentPlaybackSampleRate(sampleRate);
+        sampler.setEnvelope({ 0.0f, 0.0f, 1.0f, 0.1f });
+    }
+
+    // Plays the top layer's root note with no envelope to speak of, and
+    // compares every frame with the file, well past the preloaded head.
+    bool playsExactly(const File& directory)
+    {
+        StreamingSampler sampler;
+        prepare(sampler);
+        sampler.setNonRealtime(true);
+        sampler.loadDirectory(directory);
+
+        const auto note = getRootNote(numRoots / 2);
+        const auto noteName = String(note % 12 == 0 ? "C" : "F#") + String(note / 12 - 1);
+
+        WavAudioFormat wavFormat;
+        const auto file = directory.getChildFile("Test_" + noteName + "_v127.wav");
+        std::unique_ptr<AudioFormatReader> reader (wavFormat.createReaderFor(file.createInputStream().release(), true));
+
+        if (reader == nullptr)
+            return false;
+
+        const auto numFrames = 8 * StreamingSampler::defaultPreloadLength;
+        AudioBuffer<float> expected(2, numFrames), output(2, numFrames);
+        reader->read(&expected, 0, numFrames, 0, true, true);
+        output.clear();
+
+        MidiBuffer midi;
+        midi.addEvent(MidiMessage::noteOn(1, note, 1.0f), 0);
+
+        for (int start = 0; start < numFrames; start += blockSize)
+        {
+            sampler.renderNextBlock(output, midi, start, jmin(blockSize, numFrames - start));
+            midi.clear();
+        }
+
+        for (int channel = 0; channel < 2; ++channel)
+            for (int i = 0; i < numFrames; ++i)
+                if (output.getSample(channel, i) != expected.getSample(channel, i))
+                    return false;
+
+        return sampler.getNumUnderruns() == 0;
+    }
+
+    // numRealtimeVoices notes across the keyboard and both layers, rendered
+    // block by block at the pace an audio callback would, with the streamer
+    // on its own thread.
+    int countRealtimeUnderruns(const File& directory, double& busyFraction)
+    {
+        StreamingSampler sampler;
+        prepare(sampler);
+        sampler.loadDirectory(directory);
+
+        AudioBuffer<float> output(2, blockSize);
+        MidiBuffer midi;
+
+        for (int i = 0; i < numRealtimeVoices; ++i)
+            midi.addEvent(MidiMessage::noteOn(1, 30 + 4 * i, i % 2 == 0 ? 0.4f : 1.0f), 0);
+
+        const auto blockMs = 1000.0 * blockSize / sampleRate;
+        const auto numBlocks = int(realtimeSeconds * sampleRate / blockSize);
+        const auto start = Time::getMillisecondCounterHiRes();
+        double busyMs = 0.0;
+
+        for (int block = 0; block < numBlocks; ++block)
+        {
+            const auto blockStart = Time::getMillisecondCounterHiRes();
+
+            output.clear();
+            sampler.renderNextBlock(output, midi, 0, blockSize);
+            midi.clear();
+
+            busyMs += Time::getMillisecondCounterHiRes() - blockStart;
+
+            const auto due = start + (block + 1) * blockMs;
+
+            while (Time::getMillisecondCounterHiRes() < due)
+                Thread::sleep(1);
+        }
+
+        busyFraction = busyMs / (numBlocks * blockMs);
+        return sampler.getNumUnderruns();
+    }
+}
+
+int main()
+{
+    int64 libraryBytes = 0;
+    const auto directory = writeLibrary(libraryBytes);
+
+    if (directory == File())
+    {
+        std::cerr << "Couldn't write the test library" << std::endl;
+        return 1;
+    }
+
+    std::cout << "Sampler: " << numRoots * numLayers << " stereo 24 bit files of " << sampleSeconds << " s, "
+              << File::descriptionOfSizeInBytes(libraryBytes) << " on disk" << std::endl;
+
+    size_t inMemoryBytes = 0;
+    const auto inMemorySeconds = timeReadingIntoMemory(directory, inMemoryBytes);
+
+    StreamingSampler sampler;
+    const auto start = Time::getHighResolutionTicks();
+    const auto numLoaded = sampler.loadDirectory(directory);
+    const auto streamingSeconds = Time::highResolutionTicksToSeconds(Time::getHighResolutionTicks() - start);
+
+    std::cout << "  read into memory   " << String(inMemorySeconds, 4) << " s   " << File::descriptionOfSizeInBytes(int64(inMemoryBytes)) << " resident" << std::endl
+              << "  streaming          " << String(streamingSeconds, 4) << " s   " << File::descriptionOfSizeInBytes(int64(sampler.getPreloadedBytes()))
+              << " resident   (" << numLoaded << " zones, speedup " << String(inMemorySeconds / streamingSeconds, 1) << "x)" << std::endl;
+
+    const auto isExact = playsExactly(directory);
+    std::cout << "  streamed note matches its file: " << (isExact ? "yes" : "NO") << std::endl;
+
+    double busyFraction = 0.0;
+    const auto underruns = countRealtimeUnderruns(directory, busyFraction);
+
+    std::cout << "  " << numRealtimeVoices << " voices for " << realtimeSeconds << " s in real time: " << underruns << " underruns, "
+              << String(100.0 * busyFraction, 2) << "% of the audio thread" << std::endl;
+
+    return isExact && numLoaded == numRoots * numLayers ? 0 : 1;
+}
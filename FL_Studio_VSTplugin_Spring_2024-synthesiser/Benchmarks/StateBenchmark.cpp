@@ -0,0 +1,143 @@
+/**
+ * @file StateBenchmark.cpp
+ *
+ * @brief Times saving and restoring the state of a session's worth of synth
+ *        instances with the binary SynthState format, against an XML copy
+ *        of the value tree, and checks that the binary state round-trips.
+ *
+ * @author
+ */
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "../Source/PluginProcessor.h"
+
+
+namespace
+{
+    constexpr int numInstances = 64;
+    constexpr int numRuns = 20;
+
+    using Instances = OwnedArray<JuceSynthFrameworkAudioProcessor>;
+
+    void randomiseParameters(AudioProcessor& processor, Random& random)
+    {
+        for (auto* parameter : processor.getParameters())
+            parameter->setValueNotifyingHost(random.nextFloat());
+    }
+
+    Array<float> getParameterValues(const AudioProcessor& processor)
+    {
+        Array<float> values;
+
+        for (auto* parameter : processor.getParameters())
+            values.add(parameter->getValue());
+
+        return values;
+    }
+
+    template <typename Fn>
+    double timeInstances(Instances& instances, Fn&& fn)
+    {
+        const auto start = Time::getHighResolutionTicks();
+
+        for (int i = 0; i < instances.size(); ++i)
+            fn(*instances.getUnchecked(i), i);
+
+        return Time::highResolutionTicksToSeconds(Time::getHighResolutionTicks() - start);
+    }
+
+    void saveXml(JuceSynthFrameworkAudioProcessor& processor, MemoryBlock& destData)
+    {
+        destData.setSize(0);
+
+        if (auto xml = processor.valueTree.copyState().createXml())
+            AudioProcessor::copyXmlToBinary(*xml, destData);
+    }
+
+    void restoreXml(JuceSynthFrameworkAudioProcessor& processor, const MemoryBlock& data)
+    {
+        if (auto xml = AudioProcessor::getXmlFromBinary(data.getData(), (int) data.getSize()))
+            processor.valueTree.replaceState(ValueTree::fromXml(*xml));
+    }
+}
+
+int main()
+{
+    // the processors' parameter state expects a message manager to exist
+    ScopedJuceInitialiser_GUI juceInitialiser;
+
+    Instances instances;
+    Random random(42);
+
+    for (int i = 0; i < numInstances; ++i)
+    {
+        randomiseParameters(*instances.add(new JuceSynthFrameworkAudioProcessor()), random);
+    }
+
+    std::vector<MemoryBlock> binaryStates((size_t) numInstances), xmlStates((size_t) numInstances);
+    std::vector<Array<float>> savedValues;
+
+    for (auto* instance : instances)
+        savedValues.push_back(getParameterValues(*instance));
+
+    auto binarySaveSeconds = std::numeric_limits<double>::max();
+    auto xmlSaveSeconds = std::numeric_limits<double>::max();
+    auto binaryRestoreSeconds = std::numeric_limits<double>::max();
+    auto xmlRestoreSeconds = std::numeric_limits<double>::max();
+
+    for (int run = 0; run < numRuns; ++run)
+    {
+        binarySaveSeconds = jmin(binarySaveSeconds, timeInstances(instances, [&](auto& processor, int i)
+        {
+            processor.getStateInformation(binaryStates[(size_t) i]);
+        }));
+
+        xmlSaveSeconds = jmin(xmlSaveSeconds, timeInstances(instances, [&](auto& processor, int i)
+        {
+            saveXml(processor, xmlStates[(size_t) i]);
+        }));
+
+        binaryRestoreSeconds = jmin(binaryRestoreSeconds, timeInstances(instances, [&](auto& processor, int i)
+        {
+            processor.setStateInformation(binaryStates[(size_t) i].getData(), (int) binaryStates[(size_t) i].getSize());
+        }));
+
+        xmlRestoreSeconds = jmin(xmlRestoreSeconds, timeInstances(instances, [&](auto& processor, int i)
+        {
+            restoreXml(processor, xmlStates[(size_t) i]);
+        }));
+    }
+
+    // scrambles every instance, then checks the binary state puts it back
+    int numMismatched = 0;
+
+    for (int i = 0; i < numInstances; ++i)
+    {
+        auto& processor = *instances.getUnchecked(i);
+        randomiseParameters(processor, random);
+        processor.setStateInformation(binaryStates[(size_t) i].getData(), (int) binaryStates[(size_t) i].getSize());
+
+        const auto restored = getParameterValues(processor);
+
+        for (int p = 0; p < restored.size(); ++p)
+            if (std::abs(restored[p] - savedValues[(size_t) i][p]) > 1.0e-6f)
+                ++numMismatched;
+    }
+
+    // and that anything else is refused without touching the parameters
+    auto& first = *instances.getFirst();
+    const auto before = getParameterValues(first);
+    first.setStateInformation(xmlStates.front().getData(), (int) xmlStates.front().getSize());
+    const auto rejectsForeignData = getParameterValues(first) == before;
+
+    std::cout << "Synth state: " << numInstances << " instances, " << first.getParameters().size() << " parameters each, best of " << numRuns << std::endl
+              << "  size      binary " << binaryStates.front().getSize() << " bytes   XML " << xmlStates.front().getSize() << " bytes" << std::endl
+              << "  save      binary " << String(1.0e6 * binarySaveSeconds, 1) << " us   XML " << String(1.0e6 * xmlSaveSeconds, 1)
+              << " us   speedup " << String(xmlSaveSeconds / binarySaveSeconds, 1) << "x" << std::endl
+              << "  restore   binary " << String(1.0e6 * binaryRestoreSeconds, 1) << " us   XML " << String(1.0e6 * xmlRestoreSeconds, 1)
+              << " us   speedup " << String(xmlRestoreSeconds / binaryRestoreSeconds, 1) << "x" << std::endl
+              << "  round trip " << (numMismatched == 0 ? "exact" : String(numMismatched) + " values differ")
+              << ", foreign data " << (rejectsForeignData ? "ignored" : "NOT ignored") << std::endl;
+
+    return numMismatched == 0 && rejectsForeignData ? 0 : 1;
+}
@@ -0,0 +1,121 @@
+/**
+ * @file UnisonBenchmark.cpp
+ *
+ * @brief Compares a 7 and 16 voice unison stack in one SynthEngine against
+ *        stacking separate engines, one per detuned copy, which is what
+ *        layering plugin instances amounts to.
+ *
+ * @author
+ */
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "../Source/SynthEngine.h"
+
+
+namespace
+{
+    constexpr double sampleRate = 48000.0;
+    constexpr int blockSize = 512;
+    constexpr int numTimedBlocks = 2000;
+    constexpr int numNotes = 4;
+    constexpr int numRuns = 3;
+
+    SynthParameterSnapshot makeSupersawPatch(int unisonVoices)
+    {
+        SynthParameterSnapshot parameters;
+        parameters.attack = 1.0f;
+        parameters.decay = 100.0f;
+        parameters.sustain = 1.0f;
+        parameters.release = 100.0f;
+        parameters.waveform = VoiceWaveform::Saw;
+        parameters.filterType = VoiceFilterType::LowPass;
+        parameters.filterCutoff = 6000.0f;
+        parameters.filterResonance = 1.0f;
+        parameters.unisonVoices = float(unisonVoices);
+        parameters.unisonDetune = 25.0f;
+        parameters.unisonSpread = 0.8f;
+        parameters.version = 1;
+        return parameters;
+    }
+
+    std::unique_ptr<SynthEngine> makeEngine(const Wavetables& wavetables, int unisonVoices)
+    {
+        auto engine = std::make_unique<SynthEngine>();
+
+        engine->setNumVoices(numNotes, [&] { return new SynthVoice(wavetables); });
+        engine->addSound(new SynthSound());
+        engine->setCurrentPlaybackSampleRate(sampleRate);
+
+        for (int i = 0; i < numNotes; ++i)
+            if (auto* voice = dynamic_cast<SynthVoice*>(engine->getVoice(i)))
+                voice->prepareToPlay(sampleRate, blockSize);
+
+        engine->setParameters(makeSupersawPatch(unisonVoices));
+        return engine;
+    }
+
+    // numEngines engines, each playing the same chord with unisonVoices
+    // oscillators per note, mixed into one stereo buffer.
+    double timeRender(const Wavetables& wavetables, int numEngines, int unisonVoices)
+    {
+        std::vector<std::unique_ptr<SynthEngine>> engines;
+        MidiBuffer midi;
+
+        for (int i = 0; i < numEngines; ++i)
+        {
+            engines.push_back(makeEngine(wavetables, unisonVoices));
+
+            for (int note = 0; note < numNotes; ++note)
+                engines.back()->noteOn(1, 48 + 4 * note, 1.0f);
+        }
+
+        AudioBuffer<float> output(2, blockSize);
+
+        const auto start = Time::getHighResolutionTicks();
+
+        for (int block = 0; block < numTimedBlocks; ++block)
+        {
+            output.clear();
+
+            for (auto& engine : engines)
+                engine->renderNextBlock(output, midi, 0, blockSize);
+        }
+
+        return Time::highResolutionTicksToSeconds(Time::getHighResolutionTicks() - start);
+    }
+
+    double bestOf(const std::function<double()>& run)
+    {
+        auto seconds = std::numeric_limits<double>::max();
+
+        for (int i = 0; i < numRuns; ++i)
+            seconds = jmin(seconds, run());
+
+        return seconds;
+    }
+}
+
+int main()
+{
+    Wavetables wavetables;
+    wavetables.prepareToPlay(sampleRate);
+
+    std::cout << "Unison: " << numNotes << " note saw chord, stereo, " << numTimedBlocks << " blocks of " << blockSize
+              << " @ " << sampleRate << " Hz, best of " << numRuns << std::endl;
+
+    const auto single = bestOf([&] { return timeRender(wavetables, 1, 1); });
+    std::cout << "   1 oscillator per note   " << String(single, 4) << " s" << std::endl;
+
+    for (auto stackSize : { 7, 16 })
+    {
+        const auto unison = bestOf([&] { return timeRender(wavetables, 1, stackSize); });
+        const auto stacked = bestOf([&] { return timeRender(wavetables, stackSize, 1); });
+
+        std::cout << "  " << String(stackSize).paddedLeft(' ', 2) << " voice unison          " << String(unison, 4) << " s   ("
+                  << String(unison / single, 2) << "x one oscillator)" << std::endl
+                  << "  " << String(stackSize).paddedLeft(' ', 2) << " stacked engines       " << String(stacked, 4) << " s   speedup "
+                  << String(stacked / unison, 2) << "x" << std::endl;
+    }
+
+    return 0;
+}
@@ -0,0 +1,96 @@
+/**
+ * @file VoiceAllocationBenchmark.cpp
+ *
+ * @brief Times note-on handling in SynthEngine's voice allocator against
+ *        juce::Synthesiser's linear voice search, as the voice count grows.
+ *
+ * @author
+ */
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "../Source/SynthEngine.h"
+
+
+namespace
+{
+    constexpr double sampleRate = 48000.0;
+    constexpr int numNotes = 200000;
+    constexpr int numRuns = 5;
+
+    const int voiceCounts[] = { 8, 64, 256 };
+
+    // Holds all but a few of the voices down, then plays short notes on top,
+    // so every note-on has to search a mostly busy synth. The short notes are
+    // cut off rather than released, so only the allocation is timed.
+    double timeNoteOns(Synthesiser& synth, int numVoices)
+    {
+        synth.setCurrentPlaybackSampleRate(sampleRate);
+        synth.addSound(new SynthSound());
+
+        const int numHeldNotes = numVoices - 4;
+
+        for (int i = 0; i < numHeldNotes; ++i)
+            synth.noteOn(1 + i / 128, i % 128, 0.8f);
+
+        const auto start = Time::getHighResolutionTicks();
+
+        for (int i = 0; i < numNotes; ++i)
+        {
+            const int note = i % 128;
+            synth.noteOn(16, note, 0.8f);
+            synth.noteOff(16, note, 0.0f, false);
+        }
+
+        return Time::highResolutionTicksToSeconds(Time::getHighResolutionTicks() - start);
+    }
+
+    int countActiveVoices(const Synthesiser& synth)
+    {
+        int numActive = 0;
+
+        for (int i = 0; i < synth.getNumVoices(); ++i)
+            if (synth.getVoice(i)->isVoiceActive())
+                ++numActive;
+
+        return numActive;
+    }
+}
+
+int main()
+{
+    Wavetables wavetables;
+    wavetables.prepareToPlay(sampleRate);
+
+    std::cout << "Voice allocation: " << numNotes << " note on/off pairs, best of " << numRuns << std::endl;
+
+    for (auto numVoices : voiceCounts)
+    {
+        auto synthSeconds = std::numeric_limits<double>::max();
+        auto engineSeconds = std::numeric_limits<double>::max();
+        int numHeldVoicesPlaying = 0;
+
+        for (int run = 0; run < numRuns; ++run)
+        {
+            Synthesiser synth;
+
+            for (int i = 0; i < numVoices; ++i)
+                synth.addVoice(new SynthVoice(wavetables));
+
+            synthSeconds = jmin(synthSeconds, timeNoteOns(synth, numVoices));
+
+            SynthEngine engine;
+            engine.setNumVoices(numVoices, [&] { return new SynthVoice(wavetables); });
+
+            engineSeconds = jmin(engineSeconds, timeNoteOns(engine, numVoices));
+            numHeldVoicesPlaying = countActiveVoices(engine);
+        }
+
+        std::cout << "  " << String(numVoices).paddedLeft(' ', 3) << " voices: "
+                  << "Synthesiser " << String(1.0e9 * synthSeconds / numNotes, 1) << " ns/note   "
+                  << "SynthEngine " << String(1.0e9 * engineSeconds / numNotes, 1) << " ns/note   "
+                  << "speedup " << String(synthSeconds / engineSeconds, 2) << "x   "
+                  << "held voices still playing " << numHeldVoicesPlaying << "/" << numVoices - 4 << std::endl;
+    }
+
+    return 0;
+}
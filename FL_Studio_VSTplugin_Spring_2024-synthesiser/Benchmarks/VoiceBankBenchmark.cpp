@@ -0,0 +1,110 @@
+/**
+ * @file VoiceBankBenchmark.cpp
+ *
+ * @brief Times SynthVoiceBank's lockstep renderer against the same number of
+ *        SynthVoices rendered one after another.
+ *
+ * @author
+ */
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "../Source/SynthVoice.h"
+#include "../Source/SynthVoiceBank.h"
+
+
+namespace
+{
+    constexpr double sampleRate = 96000.0;
+    constexpr int blockSize = 512;
+    constexpr int numBlocks = 2000;
+    constexpr int numRuns = 5;
+
+    const int voiceCounts[] = { 8, 32, 64 };
+
+    double timeVoices(int numVoices)
+    {
+        Wavetables wavetables;
+        wavetables.prepareToPlay(sampleRate);
+
+        // The voices are started through a Synthesiser so they count as playing.
+        Synthesiser synth;
+        synth.setCurrentPlaybackSampleRate(sampleRate);
+        synth.addSound(new SynthSound());
+
+        for (int i = 0; i < numVoices; ++i)
+        {
+            auto* voice = new SynthVoice(wavetables);
+            synth.addVoice(voice);
+            voice->prepareToPlay(sampleRate, blockSize);
+            voice->getEnvelope(10.0f, 100.0f, 0.8f, 200.0f);
+            voice->getOscWaveform(VoiceWaveform::Saw);
+            voice->getFilter(VoiceFilterType::LowPass, 2000.0f, 2.0f);
+        }
+
+        for (int i = 0; i < numVoices; ++i)
+            synth.noteOn(1, 24 + i, 1.0f);
+
+        AudioBuffer<float> output(2, blockSize);
+
+        const auto start = Time::getHighResolutionTicks();
+
+        for (int block = 0; block < numBlocks; ++block)
+        {
+            output.clear();
+
+            for (int i = 0; i < synth.getNumVoices(); ++i)
+                synth.getVoice(i)->renderNextBlock(output, 0, blockSize);
+        }
+
+        return Time::highResolutionTicksToSeconds(Time::getHighResolutionTicks() - start);
+    }
+
+    double timeBank(int numVoices)
+    {
+        auto bank = std::make_unique<SynthVoiceBank>();
+        bank->prepareToPlay(sampleRate, blockSize);
+        bank->setEnvelope(10.0f, 100.0f, 0.8f, 200.0f);
+        bank->setOscWaveform(VoiceWaveform::Saw);
+        bank->setFilter(VoiceFilterType::LowPass, 2000.0f, 2.0f);
+
+        for (int i = 0; i < numVoices; ++i)
+            bank->startVoice(i, MidiMessage::getMidiNoteInHertz(24 + i));
+
+        AudioBuffer<float> output(2, blockSize);
+
+        const auto start = Time::getHighResolutionTicks();
+
+        for (int block = 0; block < numBlocks; ++block)
+        {
+            output.clear();
+            bank->renderNextBlock(output, 0, blockSize);
+        }
+
+        return Time::highResolutionTicksToSeconds(Time::getHighResolutionTicks() - start);
+    }
+}
+
+int main()
+{
+    std::cout << "Voice bank: " << blockSize << " samples @ " << sampleRate << " Hz, " << numBlocks << " blocks, best of " << numRuns << std::endl;
+
+    for (auto numVoices : voiceCounts)
+    {
+        // Timed alternately, keeping the best run of each, so neither path is
+        // favoured by running first.
+        auto voiceSeconds = std::numeric_limits<double>::max();
+        auto bankSeconds = std::numeric_limits<double>::max();
+
+        for (int run = 0; run < numRuns; ++run)
+        {
+            voiceSeconds = jmin(voiceSeconds, timeVoices(numVoices));
+            bankSeconds = jmin(bankSeconds, timeBank(numVoices));
+        }
+
+        std::cout << "  " << String(numVoices).paddedLeft(' ', 2) << " voices: "
+                  << "SynthVoice " << String(voiceSeconds, 4) << " s   bank " << String(bankSeconds, 4)
+                  << " s   speedup " << String(voiceSeconds / bankSeconds, 2) << "x" << std::endl;
+    }
+
+    return 0;
+}
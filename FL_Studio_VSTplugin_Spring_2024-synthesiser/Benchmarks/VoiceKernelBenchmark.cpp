@@ -0,0 +1,144 @@
+/**
+ * @file VoiceKernelBenchmark.cpp
+ *
+ * @brief Times the nine specialised voice kernels against the switch-based
+ *        block renderer they replaced.
+ *
+ * @author
+ */
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "../Source/VoiceKernels.h"
+
+
+namespace
+{
+    constexpr double sampleRate = 96000.0;
+    constexpr int blockSize = 512;
+    constexpr int numBlocks = 10000;
+    constexpr int numRuns = 5;
+
+    const char* const waveformNames[] = { "Sine", "Saw", "Square" };
+    const char* const filterNames[] = { "LowPass", "HighPass", "BandPass" };
+
+    // The block renderer SynthVoice used before the kernel table: each pass
+    // switches on the runtime waveform / filter selection.
+    void renderSwitched(VoiceKernelState& state, int theWave, int filterSelection, float* data, int numSamples)
+    {
+        switch(theWave)
+        {
+            case 1:
+                for (int i = 0; i < numSamples; ++i)
+                    data[i] = float(state.osc1.getNextSample(VoiceWaveform::Saw));
+                break;
+            case 2:
+                for (int i = 0; i < numSamples; ++i)
+                    data[i] = float(state.osc1.getNextSample(VoiceWaveform::Square));
+                break;
+            default:
+                for (int i = 0; i < numSamples; ++i)
+                    data[i] = float(state.osc1.getNextSample(VoiceWaveform::Sine));
+                break;
+        }
+
+        for (int i = 0; i < numSamples; ++i)
+            data[i] = float(state.env1.adsr(data[i], state.env1.trigger));
+
+        state.filter1.setCutoffAndResonance(float(state.cutoff), float(state.resonance));
+
+        switch(filterSelection)
+        {
+            case 1:
+                for (int i = 0; i < numSamples; ++i)
+                    data[i] = state.filter1.processSample<StateVariableFilter::HighPass>(data[i]);
+                break;
+            case 2:
+                for (int i = 0; i < numSamples; ++i)
+                    data[i] = state.filter1.processSample<StateVariableFilter::BandPass>(data[i]);
+                break;
+            default:
+                for (int i = 0; i < numSamples; ++i)
+                    data[i] = state.filter1.processSample<StateVariableFilter::LowPass>(data[i]);
+                break;
+        }
+    }
+
+    VoiceKernelState makeState(const Wavetables& wavetables)
+    {
+        VoiceKernelState state;
+        state.frequency = 220.0;
+        state.osc1.setFrequency(wavetables, state.frequency, sampleRate);
+        state.cutoff = 2000.0;
+        state.resonance = 2.0;
+        state.filter1.setSampleRate(sampleRate);
+        state.env1.setAttack(10.0);
+        state.env1.setDecay(100.0);
+        state.env1.setSustain(0.8);
+        state.env1.setRelease(200.0);
+        state.env1.trigger = 1;
+        return state;
+    }
+
+    template <typename RenderFn>
+    double timeBlocks(const Wavetables& wavetables, RenderFn&& render)
+    {
+        HeapBlock<float> data(blockSize);
+        auto state = makeState(wavetables);
+
+        const auto start = Time::getHighResolutionTicks();
+
+        for (int block = 0; block < numBlocks; ++block)
+            render(state, data.get());
+
+        return Time::highResolutionTicksToSeconds(Time::getHighResolutionTicks() - start);
+    }
+}
+
+int main()
+{
+    std::cout << "Voice kernels: " << blockSize << " samples @ " << sampleRate << " Hz, " << numBlocks << " blocks, best of " << numRuns << std::endl;
+
+    Wavetables wavetables;
+    wavetables.prepareToPlay(sampleRate);
+
+    double totalSwitched = 0.0, totalKernel = 0.0;
+
+    for (int wave = 0; wave < VoiceWaveform::NumWaveforms; ++wave)
+    {
+        for (int filterType = 0; filterType < VoiceFilterType::NumFilterTypes; ++filterType)
+        {
+            const auto kernel = getVoiceKernel(wave, filterType);
+
+            // The two paths are timed alternately and the best run of each is
+            // kept, so neither one is favoured by running first.
+            auto switchedSeconds = std::numeric_limits<double>::max();
+            auto kernelSeconds = std::numeric_limits<double>::max();
+
+            for (int run = 0; run < numRuns; ++run)
+            {
+                switchedSeconds = jmin(switchedSeconds, timeBlocks(wavetables, [&](VoiceKernelState& state, float* data)
+                {
+                    renderSwitched(state, wave, filterType, data, blockSize);
+                }));
+
+                kernelSeconds = jmin(kernelSeconds, timeBlocks(wavetables, [&](VoiceKernelState& state, float* data)
+                {
+                    kernel(state, data, blockSize);
+                }));
+            }
+
+            totalSwitched += switchedSeconds;
+            totalKernel += kernelSeconds;
+
+            std::cout << "  " << String(waveformNames[wave]).paddedRight(' ', 7)
+                      << String(filterNames[filterType]).paddedRight(' ', 9)
+                      << "switched " << String(switchedSeconds, 4) << " s   kernel " << String(kernelSeconds, 4)
+                      << " s   speedup " << String(switchedSeconds / kernelSeconds, 2) << "x" << std::endl;
+        }
+    }
+
+    std::cout << "  total: switched " << totalSwitched << " s, kernel " << totalKernel
+              << " s, speedup " << totalSwitched / totalKernel << "x" << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,145 @@
+/**
+ * @file VoiceRenderBenchmark.cpp
+ *
+ * @brief Times SynthVoice's block renderer against the old per-sample path.
+ *
+ * @author
+ */
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "../Source/SynthVoice.h"
+
+
+namespace
+{
+    constexpr double sampleRate = 96000.0;
+    constexpr int blockSize = 512;
+    constexpr int numChannels = 2;
+    constexpr int numVoices = 5;
+    constexpr int numBlocks = 4000;
+
+    // The renderer SynthVoice used before the block engine: the osc -> env -> filter
+    // chain is re-evaluated (switches included) for every sample of every channel.
+    struct PerSampleVoice
+    {
+        double setOscWaveform()
+        {
+            switch(theWave)
+            {
+                case 0: return osc1.sinewave(frequency);
+                case 1: return osc1.saw(frequency);
+                case 2: return osc1.square(frequency);
+                default: return osc1.sinewave(frequency);
+            }
+        }
+
+        double setEnvelope()
+        {
+            return env1.adsr(setOscWaveform(), env1.trigger);
+        }
+
+        double setFilter()
+        {
+            switch(filterSelection)
+            {
+                case 0: return filter1.lores(setEnvelope(), cutoff, resonance);
+                case 1: return filter1.hires(setEnvelope(), cutoff, resonance);
+                case 2: return filter1.bandpass(setEnvelope(), cutoff, resonance);
+                default: return filter1.lores(setEnvelope(), cutoff, resonance);
+            }
+        }
+
+        void renderNextBlock (AudioBuffer<float>& outputBuffer, int startSample, int numSamples)
+        {
+            for (int sample = 0; sample < numSamples; ++sample)
+            {
+                for (int channel = 0; channel < outputBuffer.getNumChannels(); ++channel)
+                {
+                    outputBuffer.addSample(channel, startSample, setFilter() * 0.3f);
+                }
+                ++startSample;
+            }
+        }
+
+        double frequency = 440.0;
+        int theWave = 1;
+        int filterSelection = 0;
+        double cutoff = 400.0;
+        double resonance = 1.0;
+
+        maxiOsc osc1;
+        maxiEnv env1;
+        maxiFilter filter1;
+    };
+
+    template <typename RenderFn>
+    double timeBlocks(RenderFn&& render)
+    {
+        AudioBuffer<float> output(numChannels, blockSize);
+
+        const auto start = Time::getHighResolutionTicks();
+
+        for (int block = 0; block < numBlocks; ++block)
+        {
+            output.clear();
+            render(output);
+        }
+
+        return Time::highResolutionTicksToSeconds(Time::getHighResolutionTicks() - start);
+    }
+}
+
+int main()
+{
+    Wavetables wavetables;
+    wavetables.prepareToPlay(sampleRate);
+
+    std::vector<PerSampleVoice> perSampleVoices(numVoices);
+    // The voices are started through a Synthesiser so they count as playing.
+    Synthesiser synth;
+    synth.setCurrentPlaybackSampleRate(sampleRate);
+    synth.addSound(new SynthSound());
+
+    for (int i = 0; i < numVoices; ++i)
+    {
+        auto& legacy = perSampleVoices[(size_t) i];
+        legacy.env1.setAttack(10.0);
+        legacy.env1.setDecay(100.0);
+        legacy.env1.setSustain(0.8);
+        legacy.env1.setRelease(200.0);
+        legacy.env1.trigger = 1;
+        legacy.frequency = MidiMessage::getMidiNoteInHertz(48 + i * 4);
+
+        auto* voice = new SynthVoice(wavetables);
+        synth.addVoice(voice);
+        voice->prepareToPlay(sampleRate, blockSize);
+        voice->getOscWaveform(1.0f);
+        voice->getEnvelope(10.0f, 100.0f, 0.8f, 200.0f);
+        voice->getFilter(0.0f, 400.0f, 1.0f);
+    }
+
+    for (int i = 0; i < numVoices; ++i)
+        synth.noteOn(1, 48 + i * 4, 1.0f);
+
+    const auto perSampleSeconds = timeBlocks([&](AudioBuffer<float>& output)
+    {
+        for (auto& voice : perSampleVoices)
+            voice.renderNextBlock(output, 0, blockSize);
+    });
+
+    const auto blockSeconds = timeBlocks([&](AudioBuffer<float>& output)
+    {
+        for (int i = 0; i < synth.getNumVoices(); ++i)
+            synth.getVoice(i)->renderNextBlock(output, 0, blockSize);
+    });
+
+    const auto audioSeconds = numBlocks * blockSize / sampleRate;
+
+    std::cout << "Voice render: " << numVoices << " voices, " << numChannels << " channels, "
+              << blockSize << " samples @ " << sampleRate << " Hz, " << numBlocks << " blocks" << std::endl;
+    std::cout << "  per-sample: " << perSampleSeconds << " s (" << audioSeconds / perSampleSeconds << "x realtime)" << std::endl;
+    std::cout << "  block:      " << blockSeconds << " s (" << audioSeconds / blockSeconds << "x realtime)" << std::endl;
+    std::cout << "  speedup:    " << perSampleSeconds / blockSeconds << "x" << std::endl;
+
+    return blockSeconds < perSampleSeconds ? 0 : 1;
+}
@@ -0,0 +1,139 @@
+/**
+ * @file VoiceRenderPoolBenchmark.cpp
+ *
+ * @brief Times SynthEngine rendering 32 voices on the audio thread alone and
+ *        through a VoiceRenderPool with one worker up to one per spare core,
+ *        and checks the pool's output matches the serial render.
+ *
+ * @author
+ */
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "../Source/SynthEngine.h"
+
+
+namespace
+{
+    constexpr double sampleRate = 48000.0;
+    constexpr int blockSize = 512;
+    constexpr int numChannels = 2;
+    constexpr int numTimedBlocks = 1000;
+    constexpr int numVoices = 32;
+    constexpr int numRuns = 3;
+
+    SynthParameterSnapshot makePatch()
+    {
+        SynthParameterSnapshot parameters;
+        parameters.attack = 1.0f;
+        parameters.decay = 100.0f;
+        parameters.sustain = 1.0f;
+        parameters.release = 100.0f;
+        parameters.waveform = VoiceWaveform::Saw;
+        parameters.filterType = VoiceFilterType::LowPass;
+        parameters.filterCutoff = 2000.0f;
+        parameters.filterResonance = 2.0f;
+        parameters.version = 1;
+        return parameters;
+    }
+
+    // Renders numTimedBlocks blocks with numWorkers workers (none for the
+    // serial path), keeping the last block in lastBlock.
+    double timeRender(const Wavetables& wavetables, int numWorkers, AudioBuffer<float>& lastBlock)
+    {
+        std::unique_ptr<VoiceRenderPool> pool;
+
+        SynthEngine engine;
+        engine.setNumVoices(numVoices, [&] { return new SynthVoice(wavetables); });
+        engine.addSound(new SynthSound());
+        engine.setCurrentPlaybackSampleRate(sampleRate);
+
+        for (int i = 0; i < numVoices; ++i)
+            if (auto* voice = dynamic_cast<SynthVoice*>(engine.getVoice(i)))
+                voice->prepareToPlay(sampleRate, blockSize);
+
+        if (numWorkers > 0)
+        {
+            // a threshold of 1 sends every block through the pool
+            pool = std::make_unique<VoiceRenderPool>(numWorkers, 1);
+            pool->prepareToPlay(numChannels, blockSize);
+            engine.setRenderPool(pool.get());
+        }
+
+        engine.setParameters(makePatch());
+
+        for (int i = 0; i < numVoices; ++i)
+            engine.noteOn(1, 36 + 2 * i, 1.0f);
+
+        AudioBuffer<float> output(numChannels, blockSize);
+        MidiBuffer midi;
+
+        const auto start = Time::getHighResolutionTicks();
+
+        for (int block = 0; block < numTimedBlocks; ++block)
+        {
+            output.clear();
+            engine.renderNextBlock(output, midi, 0, blockSize);
+        }
+
+        const auto seconds = Time::highResolutionTicksToSeconds(Time::getHighResolutionTicks() - start);
+
+        lastBlock.makeCopyOf(output);
+        engine.setRenderPool(nullptr);
+        return seconds;
+    }
+
+    double bestOf(const Wavetables& wavetables, int numWorkers, AudioBuffer<float>& lastBlock)
+    {
+        auto seconds = std::numeric_limits<double>::max();
+
+        for (int i = 0; i < numRuns; ++i)
+            seconds = jmin(seconds, timeRender(wavetables, numWorkers, lastBlock));
+
+        return seconds;
+    }
+
+    // The workers' buffers are summed in a different order from the serial
+    // render, so the two only match to rounding.
+    float getMaxDifference(const AudioBuffer<float>& a, const AudioBuffer<float>& b)
+    {
+        float difference = 0.0f;
+
+        for (int channel = 0; channel < a.getNumChannels(); ++channel)
+            for (int i = 0; i < a.getNumSamples(); ++i)
+                difference = jmax(difference, std::abs(a.getSample(channel, i) - b.getSample(channel, i)));
+
+        return difference;
+    }
+}
+
+int main()
+{
+    Wavetables wavetables;
+    wavetables.prepareToPlay(sampleRate);
+
+    const auto maxWorkers = jmax(1, SystemStats::getNumCpus() - 1);
+    const auto audioSeconds = numTimedBlocks * blockSize / sampleRate;
+
+    std::cout << "Voice render pool: " << numVoices << " voices, " << numTimedBlocks << " blocks of " << blockSize
+              << " @ " << sampleRate << " Hz, " << SystemStats::getNumCpus() << " cores, best of " << numRuns << std::endl;
+
+    AudioBuffer<float> serialBlock, poolBlock;
+    const auto serialSeconds = bestOf(wavetables, 0, serialBlock);
+
+    std::cout << "  serial      " << String(serialSeconds, 4) << " s   (" << String(audioSeconds / serialSeconds, 1) << "x realtime)" << std::endl;
+
+    bool matches = true;
+
+    for (int numWorkers = 1; numWorkers <= maxWorkers; ++numWorkers)
+    {
+        const auto seconds = bestOf(wavetables, numWorkers, poolBlock);
+        const auto difference = getMaxDifference(serialBlock, poolBlock);
+        matches = matches && difference < 1.0e-4f;
+
+        std::cout << "  " << numWorkers << (numWorkers == 1 ? " worker    " : " workers   ") << String(seconds, 4) << " s   ("
+                  << String(audioSeconds / seconds, 1) << "x realtime, speedup " << String(serialSeconds / seconds, 2)
+                  << "x, max difference " << difference << ")" << std::endl;
+    }
+
+    return matches ? 0 : 1;
+}
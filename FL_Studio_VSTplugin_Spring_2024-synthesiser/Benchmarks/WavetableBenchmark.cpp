@@ -0,0 +1,138 @@
+/**
+ * @file WavetableBenchmark.cpp
+ *
+ * @brief Times the mip-mapped wavetable oscillator against maxiOsc, and
+ *        measures how much each one aliases on a high note.
+ *
+ * @author
+ */
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "maximilian.h"
+#include "../Source/Wavetables.h"
+
+
+namespace
+{
+    constexpr double sampleRate = 48000.0;
+    constexpr int numSamples = 1 << 22;
+    constexpr int numRuns = 5;
+
+    const char* const waveformNames[] = { "Sine", "Saw", "Square" };
+
+    double renderMaxi(maxiOsc& osc, int waveform, double frequency)
+    {
+        switch (waveform)
+        {
+            case Wavetables::Saw: return osc.saw(frequency);
+            case Wavetables::Square: return osc.square(frequency);
+            default: return osc.sinewave(frequency);
+        }
+    }
+
+    template <typename RenderFn>
+    double timeSamples(RenderFn&& render)
+    {
+        float sum = 0.0f;
+
+        const auto start = Time::getHighResolutionTicks();
+
+        for (int i = 0; i < numSamples; ++i)
+            sum += render();
+
+        const auto seconds = Time::highResolutionTicksToSeconds(Time::getHighResolutionTicks() - start);
+
+        // keeps the loop from being optimised away
+        if (sum == 12345.0f)
+            std::cout << sum;
+
+        return seconds;
+    }
+
+    // A note around 3 kHz that fits a whole number of periods into the DFT
+    // below without dividing the sample rate, so aliases don't land on its
+    // harmonics.
+    constexpr int aliasingLength = 4096;
+    constexpr int aliasingPeriods = 259;
+    constexpr double highFrequency = sampleRate * aliasingPeriods / aliasingLength;
+
+    // Energy at frequencies that aren't harmonics of highFrequency, relative
+    // to the total, from a plain DFT.
+    template <typename RenderFn>
+    double measureAliasing(RenderFn&& render)
+    {
+        constexpr int length = aliasingLength;
+        constexpr int numPeriods = aliasingPeriods;
+
+        std::vector<double> signal((size_t) length);
+
+        for (auto& sample : signal)
+            sample = render();
+
+        double harmonicEnergy = 0.0, otherEnergy = 0.0;
+
+        for (int bin = 1; bin < length / 2; ++bin)
+        {
+            double re = 0.0, im = 0.0;
+
+            for (int i = 0; i < length; ++i)
+            {
+                const auto angle = MathConstants<double>::twoPi * bin * i / length;
+                re += signal[(size_t) i] * std::cos(angle);
+                im += signal[(size_t) i] * std::sin(angle);
+            }
+
+            const auto energy = re * re + im * im;
+
+            if (bin % numPeriods == 0)
+                harmonicEnergy += energy;
+            else
+                otherEnergy += energy;
+        }
+
+        return otherEnergy / jmax(1.0e-30, harmonicEnergy + otherEnergy);
+    }
+}
+
+int main()
+{
+    maxiSettings::setup(int(sampleRate), 2, 512);
+
+    Wavetables wavetables;
+    wavetables.prepareToPlay(sampleRate);
+
+    const auto frequency = MidiMessage::getMidiNoteInHertz(60);
+
+    std::cout << "Wavetable oscillator: " << numSamples << " samples @ " << sampleRate << " Hz, best of " << numRuns << std::endl;
+
+    for (int waveform = 0; waveform < Wavetables::NumWaveforms; ++waveform)
+    {
+        auto maxiSeconds = std::numeric_limits<double>::max();
+        auto tableSeconds = std::numeric_limits<double>::max();
+
+        for (int run = 0; run < numRuns; ++run)
+        {
+            maxiOsc osc;
+            maxiSeconds = jmin(maxiSeconds, timeSamples([&] { return float(renderMaxi(osc, waveform, frequency)); }));
+
+            WavetableOscillator table;
+            table.setFrequency(wavetables, frequency, sampleRate);
+            tableSeconds = jmin(tableSeconds, timeSamples([&] { return table.getNextSample(waveform); }));
+        }
+
+        maxiOsc osc;
+        WavetableOscillator table;
+        table.setFrequency(wavetables, highFrequency, sampleRate);
+
+        const auto maxiAliasing = measureAliasing([&] { return renderMaxi(osc, waveform, highFrequency); });
+        const auto tableAliasing = measureAliasing([&] { return double(table.getNextSample(waveform)); });
+
+        std::cout << "  " << String(waveformNames[waveform]).paddedRight(' ', 7)
+                  << "maxiOsc " << String(maxiSeconds, 4) << " s   wavetable " << String(tableSeconds, 4)
+                  << " s   speedup " << String(maxiSeconds / tableSeconds, 2) << "x" << std::endl;
+        std::cout << "         aliased energy at " << String(highFrequency, 1) << " Hz: maxiOsc "
+                  << String(100.0 * maxiAliasing, 3) << "%   wavetable " << String(100.0 * tableAliasing, 3) << "%" << std::endl;
+    }
+
+    return 0;
+}
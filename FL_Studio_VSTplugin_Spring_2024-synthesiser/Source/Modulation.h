@@ -0,0 +1,305 @@
+/**
+ * @file Modulation.h
+ *
+ * @brief LFOs, a second envelope and the routes from them to a voice's
+ *        cutoff, resonance, pitch and level, evaluated at a control rate.
+ *
+ * @author
+ */
+
+
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include <array>
+
+
+// The modulation part of the parameters. Everything is a float, as it comes
+// from the parameters' atomics; the enums give the meaning of the switches.
+struct ModulationSettings
+{
+    static constexpr int numLfos = 2;
+    static constexpr int numRoutes = 4;
+
+    enum Source
+    {
+        None,
+        Lfo1,
+        Lfo2,
+        Envelope2,
+        NumSources
+    };
+
+    enum Target
+    {
+        Cutoff,
+        Resonance,
+        Pitch,
+        Amplitude,
+        NumTargets
+    };
+
+    enum LfoShape
+    {
+        Sine,
+        Triangle,
+        Saw,
+        Square,
+        NumLfoShapes
+    };
+
+    struct Lfo
+    {
+        float rate = 1.0f;      // Hz
+        float shape = Sine;
+
+        bool operator== (const Lfo& other) const noexcept    { return rate == other.rate && shape == other.shape; }
+    };
+
+    // times in milliseconds, like the amplitude envelope's
+    struct Envelope
+    {
+        float attack = 10.0f;
+        float decay = 200.0f;
+        float sustain = 0.5f;
+        float release = 200.0f;
+
+        bool operator== (const Envelope& other) const noexcept
+        {
+            return attack == other.attack && decay == other.decay && sustain == other.sustain && release == other.release;
+        }
+    };
+
+    // amount is -1 to 1 of the target's full range (see VoiceModulator)
+    struct Route
+    {
+        float source = None;
+        float target = Cutoff;
+        float amount = 0.0f;
+
+        bool isActive() const noexcept    { return int(source) != None && amount != 0.0f; }
+
+        bool operator== (const Route& other) const noexcept
+        {
+            return source == other.source && target == other.target && amount == other.amount;
+        }
+    };
+
+    std::array<Lfo, numLfos> lfos;
+    Envelope envelope2;
+    std::array<Route, numRoutes> routes;
+
+    bool hasActiveRoutes() const noexcept
+    {
+        for (const auto& route : routes)
+            if (route.isActive())
+                return true;
+
+        return false;
+    }
+
+    bool operator== (const ModulationSettings& other) const noexcept
+    {
+        return lfos == other.lfos && envelope2 == other.envelope2 && routes == other.routes;
+    }
+};
+
+
+/**
+    One voice's modulation sources, and the sum of the routes from them.
+
+    Nothing here runs per sample: advance() moves the LFOs and the envelope
+    on by a whole control period at once (the envelope's exponential stages
+    by raising their per-sample factor to the period's length), then adds up
+    the routes. SynthVoice calls it every few dozen samples and ramps or
+    steps its targets between the results.
+*/
+class VoiceModulator
+{
+public:
+    // How far a route with an amount of 1 moves each target.
+    static constexpr float cutoffRangeOctaves = 4.0f;
+    static constexpr float resonanceRange = 4.0f;
+    static constexpr float pitchRangeSemitones = 12.0f;
+
+    struct Values
+    {
+        float cutoffOctaves = 0.0f;
+        float resonance = 0.0f;
+        float pitchSemitones = 0.0f;
+        float gain = 1.0f;
+    };
+
+    void prepare (double newSampleRate)
+    {
+        sampleRate = newSampleRate;
+        updateEnvelopeRates();
+    }
+
+    void setSettings (const ModulationSettings& newSettings)
+    {
+        const auto envelopeChanged = ! (newSettings.envelope2 == settings.envelope2);
+
+        settings = newSettings;
+        isActive = settings.hasActiveRoutes();
+
+        if (envelopeChanged)
+            updateEnvelopeRates();
+
+        // once the last route goes, the values fall back to no modulation
+        // rather than holding wherever that route left them
+        update();
+    }
+
+    bool hasActiveRoutes() const noexcept    { return isActive; }
+
+    // LFOs restart from the top of their cycle with each note; the envelope
+    // attacks from wherever it was, as maxiEnv does.
+    void noteStarted()
+    {
+        lfoPhases.fill(0.0);
+        stage = Attack;
+        update();
+    }
+
+    void noteReleased()
+    {
+        if (stage != Idle)
+            stage = Release;
+    }
+
+    const Values& getValues() const noexcept    { return values; }
+
+    // Moves the sources on by numSamples and works out the new values.
+    void advance (int numSamples)
+    {
+        for (size_t i = 0; i < lfoPhases.size(); ++i)
+        {
+            const auto phase = lfoPhases[i] + double(settings.lfos[i].rate) * numSamples / sampleRate;
+            lfoPhases[i] = phase - std::floor(phase);
+        }
+
+        advanceEnvelope(numSamples);
+        update();
+    }
+
+private:
+    enum Stage
+    {
+        Idle,
+        Attack,
+        Decay,
+        Release
+    };
+
+    static float getLfoValue (double phase, int shape) noexcept
+    {
+        switch (shape)
+        {
+            case ModulationSettings::Triangle:  return float(4.0 * std::abs(phase - 0.5) - 1.0);
+            case ModulationSettings::Saw:       return float(2.0 * phase - 1.0);
+            case ModulationSettings::Square:    return phase < 0.5 ? 1.0f : -1.0f;
+            default:                            return float(std::sin(MathConstants<double>::twoPi * phase));
+        }
+    }
+
+    // Per-sample rates, with the same curves as the amplitude envelope: a
+    // linear attack, then decay and release that fall by 99% over their time.
+    void updateEnvelopeRates()
+    {
+        const auto samplesPerMs = sampleRate * 0.001;
+        const auto& envelope = settings.envelope2;
+
+        attackStep = 1.0 / (jmax(0.001, double(envelope.attack)) * samplesPerMs);
+        decayFactor = std::pow(0.01, 1.0 / (jmax(0.001, double(envelope.decay)) * samplesPerMs));
+        releaseFactor = std::pow(0.01, 1.0 / (jmax(0.001, double(envelope.release)) * samplesPerMs));
+        poweredForSamples = 0;
+    }
+
+    void advanceEnvelope (int numSamples)
+    {
+        if (stage == Idle)
+            return;
+
+        // the control period rarely changes, so the powers are kept
+        if (numSamples != poweredForSamples)
+        {
+            decayPowered = std::pow(decayFactor, double(numSamples));
+            releasePowered = std::pow(releaseFactor, double(numSamples));
+            poweredForSamples = numSamples;
+        }
+
+        const auto sustain = double(jlimit(0.0f, 1.0f, settings.envelope2.sustain));
+
+        switch (stage)
+        {
+            case Attack:
+                envelopeLevel += attackStep * numSamples;
+
+                if (envelopeLevel >= 1.0)
+                {
+                    envelopeLevel = 1.0;
+                    stage = Decay;
+                }
+                break;
+
+            case Decay:
+                envelopeLevel = sustain + (envelopeLevel - sustain) * decayPowered;
+                break;
+
+            case Release:
+                envelopeLevel *= releasePowered;
+
+                if (envelopeLevel < 1.0e-4)
+                {
+                    envelopeLevel = 0.0;
+                    stage = Idle;
+                }
+                break;
+
+            default:
+                break;
+        }
+    }
+
+    void update()
+    {
+        float sources[ModulationSettings::NumSources] {};
+
+        for (size_t i = 0; i < lfoPhases.size(); ++i)
+            sources[ModulationSettings::Lfo1 + i] = getLfoValue(lfoPhases[i], int(settings.lfos[i].shape));
+
+        sources[ModulationSettings::Envelope2] = float(envelopeLevel);
+
+        float totals[ModulationSettings::NumTargets] {};
+
+        for (const auto& route : settings.routes)
+        {
+            const auto source = int(route.source);
+            const auto target = int(route.target);
+
+            if (route.isActive() && isPositiveAndBelow(source, int(ModulationSettings::NumSources))
+                                 && isPositiveAndBelow(target, int(ModulationSettings::NumTargets)))
+                totals[target] += route.amount * sources[source];
+        }
+
+        values.cutoffOctaves = cutoffRangeOctaves * totals[ModulationSettings::Cutoff];
+        values.resonance = resonanceRange * totals[ModulationSettings::Resonance];
+        values.pitchSemitones = pitchRangeSemitones * totals[ModulationSettings::Pitch];
+        values.gain = jmax(0.0f, 1.0f + totals[ModulationSettings::Amplitude]);
+    }
+
+    ModulationSettings settings;
+    bool isActive = false;
+    double sampleRate = 44100.0;
+
+    std::array<double, ModulationSettings::numLfos> lfoPhases {};
+
+    Stage stage = Idle;
+    double envelopeLevel = 0.0;
+    double attackStep = 0.0, decayFactor = 0.0, releaseFactor = 0.0;
+    double decayPowered = 0.0, releasePowered = 0.0;
+    int poweredForSamples = 0;
+
+    Values values;
+};
@@ -0,0 +1,275 @@
+/**
+ * @file NoteExpression.h
+ *
+ * @brief Per-channel pitch bend, pressure and timbre, tracked the MPE way and
+ *        ramped over each block rather than applied event by event.
+ *
+ * @author
+ */
+
+
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+
+
+// What a voice is told about its note's expression.
+struct NoteExpression
+{
+    float pitchBendSemitones = 0.0f;
+    float pressure = 0.0f;      // 0 to 1
+    float timbre = 0.5f;        // 0 to 1, centred like MPE's CC74
+};
+
+
+/**
+    Collects the expression messages of each MIDI channel: pitch bend,
+    channel (or polyphonic) pressure and CC74 timbre. With an MPE zone set
+    up, each note has a member channel of its own, so these are per-note;
+    without one, every note on a channel shares them, as on any synth.
+
+    extract() pulls those messages out of a block's MIDI before the
+    Synthesiser sees it, which would otherwise split the render at every one
+    of them, and keeps only the last value of each per channel. The values
+    then ramp linearly from where they were to those targets over the block,
+    and are read every updateInterval samples by advance(), so a dense
+    controller stream costs little more than a single message.
+
+    Zone layouts come from MPE configuration messages in the MIDI, or from
+    setZoneLayout().
+*/
+class NoteExpressionTracker
+{
+public:
+    static constexpr int numChannels = 16;
+    static constexpr int timbreController = 74;
+
+    // Samples between the points at which the ramps are handed to the voices.
+    static constexpr int updateInterval = 64;
+
+    // Pitch bend range, in semitones, on channels outside any MPE zone.
+    static constexpr int defaultPitchBendRange = 2;
+
+    NoteExpressionTracker()
+    {
+        reset();
+        updateBendRanges();
+    }
+
+    void reset()
+    {
+        for (auto& channel : channels)
+        {
+            channel.pitchBend.setCurrentAndTarget(0.0f);
+            channel.pressure.setCurrentAndTarget(0.0f);
+            channel.timbre.setCurrentAndTarget(0.5f);
+        }
+
+        numRamping = 0;
+    }
+
+    void setZoneLayout (const MPEZoneLayout& newLayout)
+    {
+        zoneLayout = newLayout;
+        updateBendRanges();
+    }
+
+    const MPEZoneLayout& getZoneLayout() const noexcept    { return zoneLayout; }
+
+    /** Sets each channel ramping towards its last expression value in midi,
+        to arrive numSamples later, and returns everything else in midi.
+    */
+    const MidiBuffer& extract (const MidiBuffer& midi, int numSamples)
+    {
+        // only allocates for a block with more MIDI than any before it
+        remainingMidi.clear();
+        remainingMidi.ensureSize((size_t) midi.data.size());
+
+        for (const auto metadata : midi)
+        {
+            // read straight from the raw bytes: a dense stream is mostly
+            // these, and building a MidiMessage for each costs more than the
+            // rest of the work put together
+            const auto* data = metadata.data;
+            const auto type = metadata.numBytes == 3 ? data[0] & 0xf0 : 0;
+            auto& channel = channels[(size_t) (data[0] & 0x0f)];
+
+            if (type == 0xe0)
+                channel.pitchBend.pendingValue = float((data[1] | (data[2] << 7)) - 8192) / 8192.0f;
+            else if (type == 0xa0)
+                channel.pressure.pendingValue = float(data[2]) / 127.0f;
+            else if (type == 0xb0 && data[1] == timbreController)
+                channel.timbre.pendingValue = float(data[2]) / 127.0f;
+            else if (metadata.numBytes == 2 && (data[0] & 0xf0) == 0xd0)
+                channel.pressure.pendingValue = float(data[1]) / 127.0f;
+            else
+                passOn(metadata);
+        }
+
+        numRamping = 0;
+
+        for (auto& channel : channels)
+        {
+            for (auto* ramp : { &channel.pitchBend, &channel.pressure, &channel.timbre })
+            {
+                ramp->startRamp(numSamples);
+
+                if (ramp->isRamping())
+                    ++numRamping;
+            }
+        }
+
+        return remainingMidi;
+    }
+
+    bool isRamping() const noexcept    { return numRamping > 0; }
+
+    // Moves every ramp on by numSamples.
+    void advance (int numSamples) noexcept
+    {
+        if (numRamping == 0)
+            return;
+
+        numRamping = 0;
+
+        for (auto& channel : channels)
+        {
+            for (auto* ramp : { &channel.pitchBend, &channel.pressure, &channel.timbre })
+            {
+                ramp->advance(numSamples);
+
+                if (ramp->isRamping())
+                    ++numRamping;
+            }
+        }
+    }
+
+    /** The expression for a note on midiChannel: its own channel's, plus the
+        zone's master pitch bend when that channel is an MPE member channel.
+        Notes that are just starting pass useTargets so they begin at the
+        values sent for them, rather than ramping up from the last note's.
+    */
+    NoteExpression getExpression (int midiChannel, bool useTargets = false) const noexcept
+    {
+        const auto index = (size_t) jlimit(1, numChannels, midiChannel) - 1;
+        const auto& channel = channels[index];
+        const auto& bendRange = bendRanges[index];
+        const auto valueOf = [useTargets] (const Ramp& ramp) { return useTargets ? ramp.target : ramp.current; };
+
+        NoteExpression expression;
+        expression.pressure = valueOf(channel.pressure);
+        expression.timbre = valueOf(channel.timbre);
+        expression.pitchBendSemitones = valueOf(channel.pitchBend) * bendRange.own;
+
+        if (bendRange.masterChannel > 0)
+            expression.pitchBendSemitones += valueOf(channels[(size_t) bendRange.masterChannel - 1].pitchBend) * bendRange.master;
+
+        return expression;
+    }
+
+private:
+    // Everything else goes on to the Synthesiser; controllers may be MPE
+    // configuration messages (RPN 6), which can change the zones.
+    void passOn (const MidiMessageMetadata& metadata)
+    {
+        remainingMidi.addEvent(metadata.data, metadata.numBytes, metadata.samplePosition);
+
+        if ((metadata.data[0] & 0xf0) == 0xb0)
+        {
+            const auto zones = std::make_pair(zoneLayout.getLowerZone(), zoneLayout.getUpperZone());
+            zoneLayout.processNextMidiEvent(metadata.getMessage());
+
+            if (std::make_pair(zoneLayout.getLowerZone(), zoneLayout.getUpperZone()) != zones)
+                updateBendRanges();
+        }
+    }
+
+    // Works out, for each channel, how far its bend reaches and which
+    // master channel's bend is added to it, so getExpression() doesn't have
+    // to search the zones.
+    void updateBendRanges()
+    {
+        for (int midiChannel = 1; midiChannel <= numChannels; ++midiChannel)
+        {
+            auto& range = bendRanges[(size_t) midiChannel - 1];
+            range = { float(defaultPitchBendRange), 0, 0.0f };
+
+            for (const auto& zone : { zoneLayout.getLowerZone(), zoneLayout.getUpperZone() })
+            {
+                if (! zone.isActive())
+                    continue;
+
+                if (zone.isUsingChannelAsMemberChannel(midiChannel))
+                    range = { float(zone.perNotePitchbendRange), zone.getMasterChannel(), float(zone.masterPitchbendRange) };
+                else if (zone.getMasterChannel() == midiChannel)
+                    range = { float(zone.masterPitchbendRange), 0, 0.0f };
+            }
+        }
+    }
+
+    struct Ramp
+    {
+        float current = 0.0f;
+        float target = 0.0f;
+        float pendingValue = 0.0f;
+        float step = 0.0f;
+        int samplesLeft = 0;
+
+        void setCurrentAndTarget (float value) noexcept
+        {
+            current = target = pendingValue = value;
+            step = 0.0f;
+            samplesLeft = 0;
+        }
+
+        void startRamp (int numSamples) noexcept
+        {
+            if (pendingValue == target && samplesLeft == 0)
+                return;
+
+            target = pendingValue;
+            samplesLeft = jmax(1, numSamples);
+            step = (target - current) / float(samplesLeft);
+        }
+
+        bool isRamping() const noexcept    { return samplesLeft > 0; }
+
+        void advance (int numSamples) noexcept
+        {
+            if (samplesLeft <= 0)
+                return;
+
+            if (numSamples >= samplesLeft)
+            {
+                current = target;
+                samplesLeft = 0;
+            }
+            else
+            {
+                current += step * float(numSamples);
+                samplesLeft -= numSamples;
+            }
+        }
+    };
+
+    struct ChannelExpression
+    {
+        Ramp pitchBend, pressure, timbre;
+    };
+
+    struct BendRange
+    {
+        float own;
+        int masterChannel;      // 0 for none
+        float master;
+    };
+
+    std::array<ChannelExpression, numChannels> channels;
+    std::array<BendRange, numChannels> bendRanges;
+    int numRamping = 0;
+
+    MPEZoneLayout zoneLayout;
+    MidiBuffer remainingMidi;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (NoteExpressionTracker)
+};
@@ -0,0 +1,49 @@
+/**
+ * @file NoteScheduler.h
+ *
+ * @brief The sample timeline SynthEngine shares with its voices, so they can
+ *        start and stop notes part way through a render.
+ *
+ * @author
+ */
+
+
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+
+
+/**
+    Synthesiser::renderNextBlock() cuts the render of every voice at every
+    MIDI event in the block (or handles events up to 32 samples early, to
+    keep the pieces from getting too small), so an arpeggio or a drum roll
+    leaves every voice rendering a few samples at a time.
+
+    SynthEngine::renderNextBlock() hands all of a block's events to the
+    voices before rendering anything instead, with the time each one
+    happens; a SynthVoice keeps its note starts and stops until its render
+    gets to that sample and splits its own render there, and nowhere else.
+
+    Times count samples at the engine's rate (the oversampled one, when it
+    is) from when the engine was made. Outside a block's events, the event
+    time is immediately, and voices act on a note as soon as they're told.
+*/
+class NoteScheduler
+{
+public:
+    static constexpr int64 immediately = -1;
+
+    // The time of the first sample of the render in progress, or the next one.
+    int64 getRenderTime() const noexcept    { return renderTime; }
+
+    // The time of the event the engine is handling, or immediately.
+    int64 getEventTime() const noexcept     { return eventTime; }
+
+    // The engine's side.
+    void setEventTime (int64 newTime) noexcept    { eventTime = newTime; }
+    void advance (int numSamples) noexcept        { renderTime += numSamples; }
+
+private:
+    int64 renderTime = 0;
+    int64 eventTime = immediately;
+};
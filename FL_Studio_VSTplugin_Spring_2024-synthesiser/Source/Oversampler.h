@@ -0,0 +1,262 @@
+/**
+ * @file Oversampler.h
+ *
+ * @brief Polyphase half-band FIR decimators, and the buffer the synth's
+ *        voices render into when they run at 2x or 4x the host rate.
+ *
+ * @author
+ */
+
+
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+
+
+/**
+    Halves the sample rate with a linear-phase half-band FIR of 4 * halfLength
+    + 3 taps, designed with a Kaiser window when the decimator is made.
+
+    Every other tap of a half-band filter is zero except the centre one
+    (which is 0.5), so the filter is split into its two polyphase branches:
+    the even input samples go through the non-zero taps, and the odd ones
+    only need delaying by half the filter length. The even taps are also
+    symmetric, so each output sample costs halfLength + 1 multiplies, on
+    contiguous arrays the compiler can vectorise.
+*/
+class HalfBandDecimator
+{
+public:
+    HalfBandDecimator (int halfLength, double kaiserBeta)
+        : numEvenTaps(2 * halfLength + 2),
+          oddDelay(halfLength + 1)
+    {
+        // h[n] = 0.5 sinc((n - centre) / 2) windowed; only even n are non-zero
+        const int numTaps = 4 * halfLength + 3;
+        const int centre = (numTaps - 1) / 2;
+
+        const auto besselI0 = [] (double x)
+        {
+            double sum = 1.0, term = 1.0;
+
+            for (int k = 1; k < 50; ++k)
+            {
+                term *= (x * 0.5 / k) * (x * 0.5 / k);
+                sum += term;
+            }
+
+            return sum;
+        };
+
+        double sum = 0.0;
+
+        for (int i = 0; i < numEvenTaps; ++i)
+        {
+            const auto offset = double(2 * i - centre);
+            const auto ratio = offset / centre;
+            const auto window = besselI0(kaiserBeta * std::sqrt(1.0 - ratio * ratio)) / besselI0(kaiserBeta);
+            const auto x = MathConstants<double>::pi * offset * 0.5;
+
+            evenTaps.push_back(std::sin(x) / x * 0.5 * window);
+            sum += evenTaps.back();
+        }
+
+        // together with the 0.5 centre tap, that gives exactly unity gain at DC
+        for (auto& tap : evenTaps)
+            tap = float(tap * 0.5 / sum);
+    }
+
+    // Group delay, in samples at the input rate.
+    int getLatencyInInputSamples() const noexcept    { return 2 * oddDelay - 1; }
+
+    void prepare (int numChannels, int maxOutputSamples)
+    {
+        channels.resize((size_t) numChannels);
+
+        for (auto& channel : channels)
+        {
+            channel.even.assign((size_t) (numEvenTaps - 1 + maxOutputSamples), 0.0f);
+            channel.odd.assign((size_t) (oddDelay + maxOutputSamples), 0.0f);
+        }
+
+        maxNumOutputSamples = maxOutputSamples;
+    }
+
+    void reset()
+    {
+        for (auto& channel : channels)
+        {
+            std::fill(channel.even.begin(), channel.even.end(), 0.0f);
+            std::fill(channel.odd.begin(), channel.odd.end(), 0.0f);
+        }
+    }
+
+    // Reads 2 * numOutputSamples samples of input and writes numOutputSamples.
+    void process (int channelIndex, const float* input, float* output, int numOutputSamples) noexcept
+    {
+        jassert(isPositiveAndBelow(channelIndex, (int) channels.size()) && numOutputSamples <= maxNumOutputSamples);
+
+        auto& channel = channels[(size_t) channelIndex];
+        auto* even = channel.even.data() + numEvenTaps - 1;
+        auto* odd = channel.odd.data() + oddDelay;
+
+        // the newest input goes after each branch's history
+        for (int i = 0; i < numOutputSamples; ++i)
+        {
+            even[i] = input[2 * i];
+            odd[i] = input[2 * i + 1];
+        }
+
+        const auto* taps = evenTaps.data();
+        const int numPairs = numEvenTaps / 2;
+
+        for (int i = 0; i < numOutputSamples; ++i)
+        {
+            // even[i - j] and even[i - (numEvenTaps - 1 - j)] share a tap
+            const auto* newest = even + i;
+            const auto* oldest = even + i - (numEvenTaps - 1);
+            float sum = 0.0f;
+
+            for (int j = 0; j < numPairs; ++j)
+                sum += taps[j] * (newest[-j] + oldest[j]);
+
+            output[i] = sum + 0.5f * odd[i - oddDelay];
+        }
+
+        // keep the end of this block as the next one's history
+        std::copy(even + numOutputSamples - (numEvenTaps - 1), even + numOutputSamples, channel.even.data());
+        std::copy(odd + numOutputSamples - oddDelay, odd + numOutputSamples, channel.odd.data());
+    }
+
+private:
+    struct ChannelState
+    {
+        std::vector<float> even, odd;
+    };
+
+    const int numEvenTaps;
+    const int oddDelay;
+    std::vector<float> evenTaps;
+
+    std::vector<ChannelState> channels;
+    int maxNumOutputSamples = 0;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (HalfBandDecimator)
+};
+
+
+/**
+    Owns the buffer the voices render into while the synth is oversampled,
+    and the decimators that bring it back down to the host rate: one
+    half-band stage for 2x, two for 4x.
+
+    The stage that lands on the host rate is the long one, since it has to
+    keep everything up to 20 kHz or so while removing everything that would
+    fold back below it. The 4x-to-2x stage before it only has to clear the
+    top half of its band, so it gets away with far fewer taps.
+*/
+class Oversampler
+{
+public:
+    static constexpr int maxFactor = 4;
+
+    Oversampler()
+        : finalStage(15, 7.86),     // 63 taps, ~80 dB stopband
+          firstStage(5, 7.86)       // 23 taps, for the 4x-to-2x step
+    {
+    }
+
+    // 1, 2 or 4. Takes effect at the next prepare().
+    void setFactor (int newFactor)
+    {
+        jassert(newFactor == 1 || newFactor == 2 || newFactor == 4);
+        factor = newFactor >= 4 ? 4 : (newFactor >= 2 ? 2 : 1);
+    }
+
+    int getFactor() const noexcept    { return factor; }
+
+    void prepare (int numChannels, int maxHostSamples)
+    {
+        if (factor > 1)
+        {
+            oversampledBuffer.setSize(numChannels, maxHostSamples * factor, false, false, true);
+            intermediateBuffer.setSize(1, maxHostSamples * 2, false, false, true);
+            finalStage.prepare(numChannels, maxHostSamples);
+            firstStage.prepare(numChannels, maxHostSamples * 2);
+            decimatedBuffer.setSize(1, maxHostSamples, false, false, true);
+        }
+        else
+        {
+            oversampledBuffer.setSize(0, 0);
+            intermediateBuffer.setSize(0, 0);
+            decimatedBuffer.setSize(0, 0);
+        }
+
+        reset();
+    }
+
+    void reset()
+    {
+        finalStage.reset();
+        firstStage.reset();
+    }
+
+    // The decimators' delay, in host-rate samples.
+    double getLatencyInSamples() const noexcept
+    {
+        if (factor == 1)
+            return 0.0;
+
+        const auto finalLatency = finalStage.getLatencyInInputSamples() / 2.0;
+
+        return factor == 4 ? finalLatency + firstStage.getLatencyInInputSamples() / 4.0 : finalLatency;
+    }
+
+    // Clears and returns the buffer for numHostSamples * getFactor() samples.
+    AudioBuffer<float>& getBufferToRenderInto (int numHostSamples) noexcept
+    {
+        oversampledBuffer.clear(0, numHostSamples * factor);
+        return oversampledBuffer;
+    }
+
+    // Decimates what was rendered into the buffer and adds it to output. The
+    // filters run in float either way; a double output only gets the result
+    // added in double.
+    template <typename SampleType>
+    void addDecimated (AudioBuffer<SampleType>& output, int startSample, int numHostSamples) noexcept
+    {
+        jassert(factor > 1 && output.getNumChannels() <= oversampledBuffer.getNumChannels());
+
+        auto* decimated = decimatedBuffer.getWritePointer(0);
+
+        for (int channel = 0; channel < output.getNumChannels(); ++channel)
+        {
+            const auto* input = oversampledBuffer.getReadPointer(channel);
+
+            if (factor == 4)
+            {
+                auto* intermediate = intermediateBuffer.getWritePointer(0);
+                firstStage.process(channel, input, intermediate, numHostSamples * 2);
+                input = intermediate;
+            }
+
+            finalStage.process(channel, input, decimated, numHostSamples);
+
+            auto* destination = output.getWritePointer(channel, startSample);
+
+            if constexpr (std::is_same_v<SampleType, float>)
+                FloatVectorOperations::add(destination, decimated, numHostSamples);
+            else
+                for (int i = 0; i < numHostSamples; ++i)
+                    destination[i] += double(decimated[i]);
+        }
+    }
+
+private:
+    int factor = 1;
+
+    HalfBandDecimator finalStage, firstStage;
+    AudioBuffer<float> oversampledBuffer, intermediateBuffer, decimatedBuffer;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (Oversampler)
+};
@@ -19,20 +19,21 @@ JuceSynthFrameworkAudioProcessor::JuceSynthFrameworkAudioProcessor()
                       #endif
                        .withOutput ("Output", AudioChannelSet::stereo(), true)
                      #endif
-                       ), valueTree(*this, nullptr, "Parameters", createParameters())
+                       ), valueTree(*this, nullptr, "Parameters", createParameters()),
+                         parameters(valueTree)
 #endif
 {
 
-    mySynth.clearVoices();
-
-    for (int i = 0; i < 5; i++)
-    {
-        mySynth.addVoice(new SynthVoice());
-    }
+    setNumVoices(defaultNumVoices);
 
     mySynth.clearSounds();
     mySynth.addSound(new SynthSound());
 
+    ProgramBank::Builder builder(*this, parameters);
+    addFactoryPrograms(builder);
+    programs.setPrograms(builder.build());
+
+    startTimerHz(30);
 }
 
 JuceSynthFrameworkAudioProcessor::~JuceSynthFrameworkAudioProcessor()
@@ -74,38 +75,133 @@ bool JuceSynthFrameworkAudioProcessor::isMidiEffect() const
 
 double JuceSynthFrameworkAudioProcessor::getTailLengthSeconds() const
 {
-    return 0.0;
+    // The release falls to 1% in RELEASE milliseconds, and voices are freed
+    // at SynthVoice::silenceThreshold (0.01%), twice as far down. The host
+    // can ask from any thread, so this reads the parameter itself rather
+    // than the snapshot the audio thread is rewriting.
+    return 2.0 * valueTree.getRawParameterValue("RELEASE")->load() / 1000.0;
 }
 
 int JuceSynthFrameworkAudioProcessor::getNumPrograms()
 {
-    return 1;   // NB: some hosts don't cope very well if you tell them there are 0 programs,
-                // so this should be at least 1, even if you're not really implementing programs.
+    return jmax(1, programs.getNumPrograms());   // NB: some hosts don't cope very well if you tell them there are 0 programs,
+                                                 // so this should be at least 1, even if you're not really implementing programs.
 }
 
 int JuceSynthFrameworkAudioProcessor::getCurrentProgram()
 {
-    return 0;
+    return currentProgram.load();
 }
 
 void JuceSynthFrameworkAudioProcessor::setCurrentProgram (int index)
 {
+    // Off the audio thread the values can go straight to the parameters;
+    // the next block picks them all up at once, ramped like any other
+    // parameter change.
+    Array<float> values;
+
+    if (! programs.getValues(index, values))
+        return;
+
+    programToPublish.store(-1);
+    currentProgram.store(index);
+    SynthState::apply(*this, parameters, values);
 }
 
 const String JuceSynthFrameworkAudioProcessor::getProgramName (int index)
 {
-    return {};
+    return programs.getName(index);
 }
 
 void JuceSynthFrameworkAudioProcessor::changeProgramName (int index, const String& newName)
 {
+    programs.setName(index, newName);
+}
+
+int JuceSynthFrameworkAudioProcessor::loadPresetDirectory (const File& directory)
+{
+    ProgramBank::Builder builder(*this, parameters);
+    addFactoryPrograms(builder);
+    const auto numLoaded = builder.addDirectory(directory);
+
+    programs.setPrograms(builder.build());
+    updateHostDisplay(ChangeDetails().withProgramChanged(true));
+
+    return numLoaded;
+}
+
+void JuceSynthFrameworkAudioProcessor::applyProgramChanges (const MidiBuffer& midiMessages)
+{
+    for (const auto metadata : midiMessages)
+        if (metadata.numBytes >= 2 && (metadata.data[0] & 0xf0) == 0xc0)
+            pendingMidiProgram = metadata.data[1];
+
+    if (! isPositiveAndBelow(pendingMidiProgram, programs.getNumPrograms()))
+    {
+        pendingMidiProgram = -1;
+        return;
+    }
+
+    // false only while the bank is being swapped, so it's tried again next block
+    if (! programs.getSnapshot(pendingMidiProgram, programSnapshot))
+        return;
+
+    parameters.holdSnapshot(programSnapshot);
+    currentProgram.store(pendingMidiProgram);
+    programToPublish.store(pendingMidiProgram);
+    pendingMidiProgram = -1;
+}
+
+void JuceSynthFrameworkAudioProcessor::publishProgramChange()
+{
+    const auto index = programToPublish.exchange(-1);
+    Array<float> values;
+
+    if (index < 0 || ! programs.getValues(index, values))
+        return;
+
+    // this change is what releases the audio thread's hold on the snapshot
+    SynthState::apply(*this, parameters, values);
+    updateHostDisplay(ChangeDetails().withProgramChanged(true));
+}
+
+void JuceSynthFrameworkAudioProcessor::timerCallback()
+{
+    publishProgramChange();
 }
 
 void JuceSynthFrameworkAudioProcessor::prepareToPlay (double sampleRate, int samplesPerBlock)
 {
-    ignoreUnused(samplesPerBlock);
     lastSampleRate = sampleRate;
-    mySynth.setCurrentPlaybackSampleRate(lastSampleRate);
+
+    // the voices run at the oversampled rate, but the wavetables stay
+    // band-limited to the host's Nyquist, which is all that survives decimation
+    const int factor = oversampler.getFactor();
+    const auto engineSampleRate = lastSampleRate * factor;
+    const int engineBlockSize = samplesPerBlock * factor;
+
+    wavetables.prepareToPlay(lastSampleRate);
+    mySynth.setCurrentPlaybackSampleRate(engineSampleRate);
+
+    for (int i = 0; i < mySynth.getNumVoices(); i++)
+    {
+        if ((myVoice = dynamic_cast<SynthVoice*>(mySynth.getVoice(i))))
+        {
+            myVoice->prepareToPlay(engineSampleRate, engineBlockSize);
+        }
+    }
+
+    voiceBank.prepareToPlay(engineSampleRate, engineBlockSize);
+
+    if (renderPool != nullptr)
+        renderPool->prepareToPlay(getTotalNumOutputChannels(), engineBlockSize);
+
+    oversampler.prepare(getTotalNumOutputChannels(), samplesPerBlock);
+    mySynth.setOversampler(factor > 1 ? &oversampler : nullptr);
+    setLatencySamples(roundToInt(oversampler.getLatencyInSamples()));
+
+    // samples play at the host's rate; oversampling is for the oscillators
+    sampler.setCurrentPlaybackSampleRate(sampleRate);
 }
 
 void JuceSynthFrameworkAudioProcessor::releaseResources()
@@ -138,38 +234,182 @@ bool JuceSynthFrameworkAudioProcessor::isBusesLayoutSupported (const BusesLayout
 }
 #endif
 
+template <typename SampleType>
+void JuceSynthFrameworkAudioProcessor::render (AudioBuffer<SampleType>& buffer, MidiBuffer& midiMessages)
+{
+    // A program change swaps its snapshot in before the block's values are
+    // read, so it's heard from the start of the block it arrives in.
+    applyProgramChanges(midiMessages);
+
+    const auto& snapshot = parameters.update();
+    mySynth.setParameters(snapshot);
+
+    buffer.clear();
+
+    if (sampler.hasLibrary())
+    {
+        sampler.setEnvelope({ snapshot.attack / 1000.0f, snapshot.decay / 1000.0f, snapshot.sustain, snapshot.release / 1000.0f });
+
+        if (! midiMessages.isEmpty() || sampler.isAnyVoiceActive())
+            sampler.renderNextBlock(buffer, midiMessages, 0, buffer.getNumSamples());
+
+        return;
+    }
+
+    // Nothing sounding and no notes coming in: the block is silent as it is,
+    // though the parameter ramps still move on through it.
+    if (midiMessages.isEmpty() && ! mySynth.isAnyVoiceActive())
+    {
+        mySynth.skipSilentBlock(buffer.getNumSamples());
+        return;
+    }
+
+    // pitch bend, pressure and timbre are ramped in by the engine, so only
+    // the rest of the MIDI splits the render
+    const auto& noteMessages = mySynth.extractExpression(midiMessages, buffer.getNumSamples());
+
+    mySynth.renderNextBlock(buffer, noteMessages, 0, buffer.getNumSamples());
+}
+
 void JuceSynthFrameworkAudioProcessor::processBlock (AudioSampleBuffer& buffer, MidiBuffer& midiMessages)
 {
+    render(buffer, midiMessages);
+}
 
-    for (int i = 0; i < mySynth.getNumVoices(); i++)
+void JuceSynthFrameworkAudioProcessor::processBlock (AudioBuffer<double>& buffer, MidiBuffer& midiMessages)
+{
+    render(buffer, midiMessages);
+}
+
+bool JuceSynthFrameworkAudioProcessor::supportsDoublePrecisionProcessing() const
+{
+    return true;
+}
+
+void JuceSynthFrameworkAudioProcessor::setNonRealtime (bool isNonRealtime) noexcept
+{
+    AudioProcessor::setNonRealtime(isNonRealtime);
+    sampler.setNonRealtime(isNonRealtime);
+}
+
+void JuceSynthFrameworkAudioProcessor::setNumVoices (int numVoices)
+{
+    mySynth.setNumVoices(jmax(1, numVoices), [this]
     {
-        if ((myVoice = dynamic_cast<SynthVoice*>(mySynth.getVoice(i))))
-        {
-            auto attackValue = valueTree.getRawParameterValue("ATTACK");
-            auto decayValue = valueTree.getRawParameterValue("DECAY");
-            auto sustainValue = valueTree.getRawParameterValue("SUSTAIN");
-            auto releaseValue = valueTree.getRawParameterValue("RELEASE");
+        auto* voice = new SynthVoice(wavetables);
+
+        if (lastSampleRate > 0.0)
+            voice->prepareToPlay(lastSampleRate * oversampler.getFactor(), getBlockSize() * oversampler.getFactor());
 
-            myVoice->getEnvelope(attackValue->load(),
-                                 decayValue->load(),
-                                 sustainValue->load(),
-                                 releaseValue->load());
+        return voice;
+    });
+}
 
-            auto waveformValue = valueTree.getRawParameterValue("WAVEFORM");
+int JuceSynthFrameworkAudioProcessor::getNumVoices() const
+{
+    return mySynth.getNumVoices();
+}
 
-            myVoice->getOscWaveform(waveformValue->load());
+int JuceSynthFrameworkAudioProcessor::getNumActiveVoices() const
+{
+    return sampler.hasLibrary() ? sampler.getNumActiveVoices() : mySynth.getNumActiveVoices();
+}
 
-            auto filterTypeValue = valueTree.getRawParameterValue("FILTER_TYPE");
-            auto filterCutoffValue = valueTree.getRawParameterValue("FILTER_CUTOFF");
-            auto filterResonanceValue = valueTree.getRawParameterValue("FILTER_RESONANCE");
+void JuceSynthFrameworkAudioProcessor::setVoiceStealing (VoiceAllocator::StealingPolicy policy, bool retriggerSameNote)
+{
+    mySynth.setStealingPolicy(policy);
+    mySynth.setRetriggerSameNote(retriggerSameNote);
+}
 
-            myVoice->getFilter(filterTypeValue->load(), filterCutoffValue->load(), filterResonanceValue->load());
-        }
+void JuceSynthFrameworkAudioProcessor::setVoiceBankEnabled (bool shouldBeEnabled)
+{
+    mySynth.setVoiceBank(shouldBeEnabled ? &voiceBank : nullptr);
+}
+
+bool JuceSynthFrameworkAudioProcessor::isVoiceBankEnabled() const
+{
+    return mySynth.getVoiceBank() != nullptr;
+}
+
+void JuceSynthFrameworkAudioProcessor::setParallelRenderingEnabled (bool shouldBeEnabled, int activeVoiceThreshold)
+{
+    if (! shouldBeEnabled)
+    {
+        mySynth.setRenderPool(nullptr);
+        renderPool.reset();
+        return;
     }
 
-    buffer.clear();
-    mySynth.renderNextBlock(buffer, midiMessages, 0, buffer.getNumSamples());
-    
+    if (renderPool == nullptr)
+    {
+        renderPool = std::make_unique<VoiceRenderPool>();
+        renderPool->prepareToPlay(getTotalNumOutputChannels(), getBlockSize() * oversampler.getFactor());
+    }
+
+    renderPool->setActiveVoiceThreshold(activeVoiceThreshold);
+    mySynth.setRenderPool(renderPool.get());
+}
+
+bool JuceSynthFrameworkAudioProcessor::isParallelRenderingEnabled() const
+{
+    return mySynth.getRenderPool() != nullptr;
+}
+
+void JuceSynthFrameworkAudioProcessor::setOversamplingFactor (int factor)
+{
+    if (factor == oversampler.getFactor())
+        return;
+
+    oversampler.setFactor(factor);
+
+    // everything downstream of the sample rate has to be prepared again
+    if (lastSampleRate > 0.0)
+    {
+        suspendProcessing(true);
+        prepareToPlay(lastSampleRate, getBlockSize());
+        suspendProcessing(false);
+    }
+}
+
+int JuceSynthFrameworkAudioProcessor::getOversamplingFactor() const
+{
+    return oversampler.getFactor();
+}
+
+void JuceSynthFrameworkAudioProcessor::setMPEZoneLayout (const MPEZoneLayout& layout)
+{
+    mySynth.setZoneLayout(layout);
+}
+
+MPEZoneLayout JuceSynthFrameworkAudioProcessor::getMPEZoneLayout() const
+{
+    return mySynth.getZoneLayout();
+}
+
+void JuceSynthFrameworkAudioProcessor::setModulationInterval (int numSamples)
+{
+    mySynth.setModulationInterval(numSamples);
+}
+
+int JuceSynthFrameworkAudioProcessor::getModulationInterval() const
+{
+    return mySynth.getModulationInterval();
+}
+
+int JuceSynthFrameworkAudioProcessor::loadSampleLibrary (const File& directory)
+{
+    mySynth.allNotesOff(0, false);
+    return sampler.loadDirectory(directory);
+}
+
+void JuceSynthFrameworkAudioProcessor::clearSampleLibrary()
+{
+    sampler.clearLibrary();
+}
+
+bool JuceSynthFrameworkAudioProcessor::hasSampleLibrary() const
+{
+    return sampler.hasLibrary();
 }
 
 bool JuceSynthFrameworkAudioProcessor::hasEditor() const
@@ -184,15 +424,15 @@ AudioProcessorEditor* JuceSynthFrameworkAudioProcessor::createEditor()
 
 void JuceSynthFrameworkAudioProcessor::getStateInformation (MemoryBlock& destData)
 {
-    // You should use this method to store your parameters in the memory block.
-    // You could do that either as raw data, or use the XML or ValueTree classes
-    // as intermediaries to make it easy to save and load complex data.
+    SynthState::write(*this, destData);
 }
 
 void JuceSynthFrameworkAudioProcessor::setStateInformation (const void* data, int sizeInBytes)
 {
-    // You should use this method to restore your parameters from this memory block,
-    // whose contents will have been created by the getStateInformation() call.
+    // The new values reach the voices through the next block's snapshot,
+    // ramped like any other parameter change. Nothing here runs on, or
+    // allocates for, the audio thread.
+    SynthState::read(*this, parameters, data, sizeInBytes);
 }
 
 // This creates new instances of the plugin..
@@ -213,6 +453,68 @@ AudioProcessorValueTreeState::ParameterLayout JuceSynthFrameworkAudioProcessor::
     params.push_back(std::make_unique<AudioParameterFloat>("FILTER_CUTOFF", "FilterCutoff", 2.0f, 10000.0f, 400.0f));
     params.push_back(std::make_unique<AudioParameterFloat>("FILTER_RESONANCE", "FilterResonance", 1.0f, 5.0f, 1.0f));
     params.push_back(std::make_unique<AudioParameterInt>("FILTER_TYPE", "FilterType", 0, 2, 0));
+    params.push_back(std::make_unique<AudioParameterInt>("UNISON_VOICES", "UnisonVoices", 1, UnisonOscillator::maxVoices, 1));
+    params.push_back(std::make_unique<AudioParameterFloat>("UNISON_DETUNE", "UnisonDetune", 0.0f, 100.0f, 20.0f));
+    params.push_back(std::make_unique<AudioParameterFloat>("UNISON_SPREAD", "UnisonSpread", 0.0f, 1.0f, 0.5f));
+
+    for (int i = 1; i <= ModulationSettings::numLfos; ++i)
+    {
+        const auto id = "LFO" + String(i);
+        params.push_back(std::make_unique<AudioParameterFloat>(id + "_RATE", "Lfo" + String(i) + "Rate", NormalisableRange<float>(0.01f, 20.0f, 0.0f, 0.3f), 2.0f));
+        params.push_back(std::make_unique<AudioParameterInt>(id + "_SHAPE", "Lfo" + String(i) + "Shape", 0, ModulationSettings::NumLfoShapes - 1, 0));
+    }
+
+    params.push_back(std::make_unique<AudioParameterFloat>("ENV2_ATTACK", "Env2Attack", 0.1f, 5000.0f, 10.0f));
+    params.push_back(std::make_unique<AudioParameterFloat>("ENV2_DECAY", "Env2Decay", 1.0f, 2000.0f, 200.0f));
+    params.push_back(std::make_unique<AudioParameterFloat>("ENV2_SUSTAIN", "Env2Sustain", 0.0f, 1.0f, 0.5f));
+    params.push_back(std::make_unique<AudioParameterFloat>("ENV2_RELEASE", "Env2Release", 0.1f, 5000.0f, 200.0f));
+
+    for (int i = 1; i <= ModulationSettings::numRoutes; ++i)
+    {
+        const auto id = "MOD" + String(i);
+        params.push_back(std::make_unique<AudioParameterInt>(id + "_SOURCE", "Mod" + String(i) + "Source", 0, ModulationSettings::NumSources - 1, 0));
+        params.push_back(std::make_unique<AudioParameterInt>(id + "_TARGET", "Mod" + String(i) + "Target", 0, ModulationSettings::NumTargets - 1, 0));
+        params.push_back(std::make_unique<AudioParameterFloat>(id + "_AMOUNT", "Mod" + String(i) + "Amount", -1.0f, 1.0f, 0.0f));
+    }
 
     return {params.begin(), params.end()};
 }
+
+void JuceSynthFrameworkAudioProcessor::addFactoryPrograms (ProgramBank::Builder& builder)
+{
+    using Mod = ModulationSettings;
+
+    builder.add("Init", {});
+
+    builder.add("Warm Pad", { { "ATTACK", 800.0f }, { "DECAY", 600.0f }, { "SUSTAIN", 0.8f }, { "RELEASE", 1500.0f },
+                              { "WAVEFORM", VoiceWaveform::Saw }, { "FILTER_CUTOFF", 1200.0f },
+                              { "UNISON_VOICES", 5.0f }, { "UNISON_DETUNE", 15.0f }, { "UNISON_SPREAD", 0.8f },
+                              { "LFO1_RATE", 0.3f }, { "MOD1_SOURCE", Mod::Lfo1 }, { "MOD1_TARGET", Mod::Cutoff }, { "MOD1_AMOUNT", 0.2f } });
+
+    builder.add("Supersaw Lead", { { "ATTACK", 5.0f }, { "DECAY", 300.0f }, { "SUSTAIN", 0.7f }, { "RELEASE", 200.0f },
+                                   { "WAVEFORM", VoiceWaveform::Saw }, { "FILTER_CUTOFF", 6000.0f }, { "FILTER_RESONANCE", 1.5f },
+                                   { "UNISON_VOICES", 7.0f }, { "UNISON_DETUNE", 30.0f }, { "UNISON_SPREAD", 1.0f } });
+
+    builder.add("Square Bass", { { "ATTACK", 1.0f }, { "DECAY", 250.0f }, { "SUSTAIN", 0.5f }, { "RELEASE", 60.0f },
+                                 { "WAVEFORM", VoiceWaveform::Square }, { "FILTER_CUTOFF", 300.0f }, { "FILTER_RESONANCE", 3.0f },
+                                 { "ENV2_ATTACK", 1.0f }, { "ENV2_DECAY", 180.0f }, { "ENV2_SUSTAIN", 0.0f }, { "ENV2_RELEASE", 60.0f },
+                                 { "MOD1_SOURCE", Mod::Envelope2 }, { "MOD1_TARGET", Mod::Cutoff }, { "MOD1_AMOUNT", 0.6f } });
+
+    builder.add("Pluck", { { "ATTACK", 0.1f }, { "DECAY", 400.0f }, { "SUSTAIN", 0.0f }, { "RELEASE", 300.0f },
+                           { "WAVEFORM", VoiceWaveform::Saw }, { "FILTER_CUTOFF", 2500.0f }, { "FILTER_RESONANCE", 2.0f },
+                           { "ENV2_ATTACK", 0.1f }, { "ENV2_DECAY", 120.0f }, { "ENV2_SUSTAIN", 0.0f },
+                           { "MOD1_SOURCE", Mod::Envelope2 }, { "MOD1_TARGET", Mod::Cutoff }, { "MOD1_AMOUNT", 0.5f } });
+
+    builder.add("Vibrato Keys", { { "ATTACK", 10.0f }, { "DECAY", 800.0f }, { "SUSTAIN", 0.6f }, { "RELEASE", 400.0f },
+                                  { "WAVEFORM", VoiceWaveform::Sine }, { "FILTER_CUTOFF", 5000.0f },
+                                  { "LFO1_RATE", 5.5f }, { "MOD1_SOURCE", Mod::Lfo1 }, { "MOD1_TARGET", Mod::Pitch }, { "MOD1_AMOUNT", 0.05f } });
+
+    builder.add("Wobble", { { "ATTACK", 1.0f }, { "SUSTAIN", 1.0f }, { "RELEASE", 100.0f },
+                            { "WAVEFORM", VoiceWaveform::Saw }, { "FILTER_CUTOFF", 500.0f }, { "FILTER_RESONANCE", 4.0f },
+                            { "LFO2_RATE", 4.0f }, { "LFO2_SHAPE", Mod::Triangle },
+                            { "MOD1_SOURCE", Mod::Lfo2 }, { "MOD1_TARGET", Mod::Cutoff }, { "MOD1_AMOUNT", 0.8f } });
+
+    builder.add("Tremolo Organ", { { "ATTACK", 5.0f }, { "SUSTAIN", 1.0f }, { "RELEASE", 80.0f },
+                                   { "WAVEFORM", VoiceWaveform::Square }, { "FILTER_CUTOFF", 2000.0f },
+                                   { "LFO1_RATE", 6.0f }, { "MOD1_SOURCE", Mod::Lfo1 }, { "MOD1_TARGET", Mod::Amplitude }, { "MOD1_AMOUNT", 0.4f } });
+}
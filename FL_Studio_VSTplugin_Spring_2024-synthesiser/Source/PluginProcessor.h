@@ -12,9 +12,16 @@
 #include "../JuceLibraryCode/JuceHeader.h"
 #include "SynthVoice.h"
 #include "SynthSound.h"
+#include "SynthEngine.h"
+#include "Wavetables.h"
+#include "SynthParameters.h"
+#include "SynthState.h"
+#include "ProgramBank.h"
+#include "StreamingSampler.h"
 
 
-class JuceSynthFrameworkAudioProcessor  : public AudioProcessor
+class JuceSynthFrameworkAudioProcessor  : public AudioProcessor,
+                                          private Timer
 {
 public:
 
@@ -30,6 +37,14 @@ public:
     #endif
 
     void processBlock (AudioSampleBuffer&, MidiBuffer&) override;
+    void processBlock (AudioBuffer<double>&, MidiBuffer&) override;
+
+    // The voices render straight into double buffers, so 64-bit hosts don't
+    // need to convert through float.
+    bool supportsDoublePrecisionProcessing() const override;
+
+    // Offline renders fill the sampler's streams on the rendering thread.
+    void setNonRealtime (bool isNonRealtime) noexcept override;
 
     AudioProcessorEditor* createEditor() override;
     bool hasEditor() const override;
@@ -47,18 +62,97 @@ public:
     const String getProgramName (int index) override;
     void changeProgramName (int index, const String& newName) override;
 
+    // Replaces the programs with the factory ones followed by every preset
+    // (a saved state, see ProgramBank::Builder::addDirectory()) in
+    // directory. Returns how many presets loaded. Not for the audio thread.
+    int loadPresetDirectory (const File& directory);
+
+    /** A MIDI program change takes effect on the audio thread straight away,
+        and the program's values are written to the parameters afterwards,
+        here, so the host and the editor see them. A timer calls this on the
+        message thread; hosts without a message loop can call it themselves.
+    */
+    void publishProgramChange();
+
     void getStateInformation (MemoryBlock& destData) override;
     void setStateInformation (const void* data, int sizeInBytes) override;
 
     AudioProcessorValueTreeState valueTree;
 
+    static constexpr int defaultNumVoices = 5;
+
+    void setNumVoices (int numVoices);
+    int getNumVoices() const;
+
+    // How many voices are playing or still releasing.
+    int getNumActiveVoices() const;
+
+    // How note-ons pick a voice once they're all playing.
+    void setVoiceStealing (VoiceAllocator::StealingPolicy policy, bool retriggerSameNote);
+
+    // Renders all voices in lockstep through a SynthVoiceBank instead of one
+    // SynthVoice at a time. Off by default.
+    void setVoiceBankEnabled (bool shouldBeEnabled);
+    bool isVoiceBankEnabled() const;
+
+    // Spreads voice rendering over a pool of worker threads whenever at least
+    // activeVoiceThreshold voices are playing. Off by default.
+    void setParallelRenderingEnabled (bool shouldBeEnabled, int activeVoiceThreshold = VoiceRenderPool::defaultActiveVoiceThreshold);
+    bool isParallelRenderingEnabled() const;
+
+    // Runs the voices at 1x, 2x or 4x the host's sample rate and decimates
+    // them back down, reporting the decimators' delay as latency. 1 (off) by
+    // default. Don't call this from the audio thread.
+    void setOversamplingFactor (int factor);
+    int getOversamplingFactor() const;
+
+    // MPE zones for hosts that don't send the configuration messages. An MPE
+    // controller's own messages set them up too.
+    void setMPEZoneLayout (const MPEZoneLayout& layout);
+    MPEZoneLayout getMPEZoneLayout() const;
+
+    // Samples between evaluations of the modulation routes (32 by default),
+    // counted at the engine's rate, which is the oversampled one.
+    void setModulationInterval (int numSamples);
+    int getModulationInterval() const;
+
+    // Plays a directory of WAV files (see StreamingSampler::loadDirectory())
+    // instead of the synth voices, streaming them from disk, with the
+    // amplitude envelope parameters. Returns how many samples loaded; with
+    // none, the synth plays as before. Don't call these from the audio thread.
+    int loadSampleLibrary (const File& directory);
+    void clearSampleLibrary();
+    bool hasSampleLibrary() const;
+
 private:
-    Synthesiser mySynth;
+    SynthParameters parameters;
+
+    Wavetables wavetables;
+    std::unique_ptr<VoiceRenderPool> renderPool;
+    SynthEngine mySynth;
     SynthVoice* myVoice;
+    SynthVoiceBank voiceBank;
+    Oversampler oversampler;
+    StreamingSampler sampler;
 
-    double lastSampleRate;
+    ProgramBank programs;
+    SynthParameterSnapshot programSnapshot;
+    std::atomic<int> currentProgram { 0 };
+    std::atomic<int> programToPublish { -1 };
+    int pendingMidiProgram = -1;
+
+    double lastSampleRate = 0.0;
 
     AudioProcessorValueTreeState::ParameterLayout createParameters();
+    void addFactoryPrograms (ProgramBank::Builder& builder);
+
+    // Swaps in the snapshot of the last program change in midiMessages.
+    void applyProgramChanges (const MidiBuffer& midiMessages);
+
+    void timerCallback() override;
+
+    template <typename SampleType>
+    void render (AudioBuffer<SampleType>& buffer, MidiBuffer& midiMessages);
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (JuceSynthFrameworkAudioProcessor)
 };
@@ -0,0 +1,217 @@
+/**
+ * @file ProgramBank.h
+ *
+ * @brief The plugin's programs, parsed and validated ahead of time so that a
+ *        program change on the audio thread is a copy of a ready snapshot.
+ *
+ * @author
+ */
+
+
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "SynthParameters.h"
+#include "SynthState.h"
+
+
+/**
+    A bank of up to maxPrograms programs, each a name, the values of every
+    processor parameter (laid out as SynthState::parse() lays them out) and
+    the SynthParameterSnapshot those values make.
+
+    Banks are put together with a Builder, off the audio thread: a preset
+    file is parsed and validated once, when it's added, and never again.
+    setPrograms() then swaps the whole bank in under a SpinLock held only
+    for the swap; the audio thread only ever try-locks it, in getSnapshot(),
+    and copies out one snapshot. If it loses the race with a swap it gets
+    false and can try again next block, so it never waits.
+*/
+class ProgramBank
+{
+public:
+    // one per MIDI program number
+    static constexpr int maxPrograms = 128;
+
+    struct Program
+    {
+        String name;
+        Array<float> values;
+        SynthParameterSnapshot snapshot;
+    };
+
+    using Programs = std::vector<Program>;
+
+    class Builder
+    {
+    public:
+        Builder (const AudioProcessor& processorToUse, const SynthParameters& parametersToUse)
+            : processor(processorToUse),
+              parameters(parametersToUse),
+              programs(std::make_unique<Programs>())
+        {
+            programs->reserve(maxPrograms);
+        }
+
+        /** Adds a program that's the default for every parameter except
+            the ones given, which are snapped to their parameters' ranges.
+            Unknown IDs are ignored.
+        */
+        bool add (const String& name, std::initializer_list<std::pair<const char*, float>> changedValues)
+        {
+            auto values = SynthState::getDefaultValues(processor);
+            const auto& allParameters = processor.getParameters();
+
+            for (const auto& changed : changedValues)
+            {
+                for (int i = 0; i < allParameters.size(); ++i)
+                {
+                    auto* ranged = dynamic_cast<const RangedAudioParameter*>(allParameters.getUnchecked(i));
+
+                    if (ranged != nullptr && ranged->getParameterID() == changed.first)
+                    {
+                        values.setUnchecked(i, ranged->getNormalisableRange().snapToLegalValue(changed.second));
+                        break;
+                    }
+                }
+            }
+
+            return add(name, values);
+        }
+
+        // Adds a program from a state getStateInformation() wrote, or returns
+        // false if it isn't one.
+        bool add (const String& name, const void* stateData, int sizeInBytes)
+        {
+            Array<float> values;
+            return SynthState::parse(processor, stateData, sizeInBytes, values) && add(name, values);
+        }
+
+        // Adds every preset file (a saved state) in directory, in name order,
+        // skipping the ones that can't be read. Returns how many were added.
+        int addDirectory (const File& directory, const String& wildcard = "*.synpreset")
+        {
+            auto files = directory.findChildFiles(File::findFiles, false, wildcard);
+            files.sort();
+
+            int numAdded = 0;
+
+            for (const auto& file : files)
+            {
+                MemoryBlock data;
+
+                if (file.loadFileAsData(data) && add(file.getFileNameWithoutExtension(), data.getData(), (int) data.getSize()))
+                    ++numAdded;
+            }
+
+            return numAdded;
+        }
+
+        int size() const noexcept    { return (int) programs->size(); }
+
+        // Hands the programs over for ProgramBank::setPrograms(); the builder is empty afterwards.
+        std::unique_ptr<Programs> build()
+        {
+            auto built = std::move(programs);
+            programs = std::make_unique<Programs>();
+            programs->reserve(maxPrograms);
+            return built;
+        }
+
+    private:
+        bool add (const String& name, const Array<float>& values)
+        {
+            if (size() >= maxPrograms)
+                return false;
+
+            programs->push_back({ name, values, parameters.makeSnapshot(values) });
+            return true;
+        }
+
+        const AudioProcessor& processor;
+        const SynthParameters& parameters;
+        std::unique_ptr<Programs> programs;
+
+        JUCE_DECLARE_NON_COPYABLE (Builder)
+    };
+
+    ProgramBank()
+        : programs(std::make_unique<Programs>())
+    {
+    }
+
+    /** Swaps newPrograms in for the bank, and frees the old one after the
+        lock is released. Don't call this from the audio thread.
+    */
+    void setPrograms (std::unique_ptr<Programs> newPrograms)
+    {
+        jassert(newPrograms != nullptr && (int) newPrograms->size() <= maxPrograms);
+
+        const SpinLock::ScopedLockType sl (lock);
+        std::swap(programs, newPrograms);
+        numPrograms.store((int) programs->size());
+    }
+
+    // Lock-free, so the audio thread can tell a program that doesn't exist
+    // from a swap in progress.
+    int getNumPrograms() const noexcept    { return numPrograms.load(); }
+
+    /** Copies the snapshot of program index into destination. Returns false
+        if there's no such program, or if the bank is being swapped right
+        now; either way destination is left alone. For the audio thread.
+    */
+    bool getSnapshot (int index, SynthParameterSnapshot& destination) const noexcept
+    {
+        const SpinLock::ScopedTryLockType sl (lock);
+
+        if (! sl.isLocked() || ! isPositiveAndBelow(index, (int) programs->size()))
+            return false;
+
+        destination = (*programs)[(size_t) index].snapshot;
+        return true;
+    }
+
+    // The rest are for the message thread.
+    String getName (int index) const
+    {
+        const SpinLock::ScopedLockType sl (lock);
+        return isPositiveAndBelow(index, (int) programs->size()) ? (*programs)[(size_t) index].name : String();
+    }
+
+    void setName (int index, const String& newName)
+    {
+        // the copy is made outside the lock, so the audio thread never
+        // waits on an allocation
+        String name (newName);
+
+        const SpinLock::ScopedLockType sl (lock);
+
+        if (isPositiveAndBelow(index, (int) programs->size()))
+            (*programs)[(size_t) index].name.swapWith(name);
+    }
+
+    // Copies program index's parameter values into values, or returns false.
+    bool getValues (int index, Array<float>& values) const
+    {
+        Array<float> copy;
+
+        {
+            const SpinLock::ScopedLockType sl (lock);
+
+            if (! isPositiveAndBelow(index, (int) programs->size()))
+                return false;
+
+            copy = (*programs)[(size_t) index].values;
+        }
+
+        values.swapWith(copy);
+        return true;
+    }
+
+private:
+    std::unique_ptr<Programs> programs;
+    std::atomic<int> numPrograms { 0 };
+    SpinLock lock;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (ProgramBank)
+};
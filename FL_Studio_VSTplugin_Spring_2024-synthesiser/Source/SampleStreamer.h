@@ -0,0 +1,234 @@
+/**
+ * @file SampleStreamer.h
+ *
+ * @brief Background thread that reads the rest of each playing sample from
+ *        its memory-mapped file into the voice's ring buffer.
+ *
+ * @author
+ */
+
+
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "StreamingSamplerSound.h"
+
+
+/**
+    Keeps every sampler voice's Stream topped up from disk, so the audio
+    thread never touches a page of a mapped file that might not be resident.
+
+    Each voice has one Stream, a ring of ringSize frames written only by this
+    thread and read only by the voice. A stream holds the sample from the end
+    of its preloaded head onwards; the voice plays the head while the first
+    chunks come in. Everything between the two threads goes through atomics:
+    the voice asks for a new sample by bumping the stream's generation, and
+    only reads the ring again once the streamer has answered that generation.
+    Until then the streamer owns the ring outright and can reset it.
+
+    The thread sleeps for pollIntervalMs whenever no stream has room for
+    another chunk, so the audio thread never has to wake it.
+*/
+class SampleStreamer : private Thread
+{
+public:
+    static constexpr int chunkSize = 4096;
+    static constexpr int ringSize = 8 * chunkSize;
+    static constexpr int pollIntervalMs = 2;
+
+    class Stream
+    {
+    public:
+        Stream()
+            : ring(StreamingSamplerSound::maxChannels, ringSize)
+        {
+            ring.clear();
+        }
+
+        // The voice calls these, on the audio thread. start() streams sound
+        // from the end of its head, or stops with nullptr.
+        void start (const StreamingSamplerSound* sound) noexcept
+        {
+            requestedSound.store(sound, std::memory_order_relaxed);
+            requestedGeneration.store(++generation, std::memory_order_release);
+        }
+
+        void stop() noexcept    { start(nullptr); }
+
+        /** How many frames past the head are in the ring, or 0 while the
+            streamer hasn't picked up the last start() yet.
+        */
+        int64 getNumFramesAvailable() const noexcept
+        {
+            if (servedGeneration.load(std::memory_order_acquire) != generation)
+                return 0;
+
+            return framesWritten.load(std::memory_order_acquire);
+        }
+
+        // A frame past the head; it must be below getNumFramesAvailable().
+        float getSample (int channel, int64 frame) const noexcept
+        {
+            return ring.getSample(channel, int(frame & (ringSize - 1)));
+        }
+
+        // Hands back the ring space of every frame before this one.
+        void releaseFramesBefore (int64 frame) noexcept
+        {
+            if (servedGeneration.load(std::memory_order_relaxed) == generation)
+                framesReleased.store(jmax(framesReleased.load(std::memory_order_relaxed), frame), std::memory_order_release);
+        }
+
+        int getNumUnderruns() const noexcept    { return underruns.load(std::memory_order_relaxed); }
+
+        void underran() noexcept                { underruns.fetch_add(1, std::memory_order_relaxed); }
+
+    private:
+        friend class SampleStreamer;
+
+        // Called on the streamer's thread. Returns true if it read anything.
+        bool service (AudioBuffer<float>& scratch)
+        {
+            const auto wanted = requestedGeneration.load(std::memory_order_acquire);
+
+            if (wanted != servedGeneration.load(std::memory_order_relaxed))
+            {
+                // the voice isn't reading the ring until this generation is served
+                sound = requestedSound.load(std::memory_order_relaxed);
+                readPosition = sound != nullptr ? sound->getHeadLength() : 0;
+                framesWritten.store(0, std::memory_order_relaxed);
+                framesReleased.store(0, std::memory_order_relaxed);
+
+                if (sound != nullptr)
+                    fill(scratch);
+
+                servedGeneration.store(wanted, std::memory_order_release);
+                return true;
+            }
+
+            return sound != nullptr && fill(scratch);
+        }
+
+        bool fill (AudioBuffer<float>& scratch)
+        {
+            const auto written = framesWritten.load(std::memory_order_relaxed);
+            const auto space = ringSize - (written - framesReleased.load(std::memory_order_acquire));
+            const auto numFrames = int(jmin(int64(chunkSize), space, sound->getLength() - readPosition));
+
+            // only whole chunks, unless it's the end of the sample
+            if (numFrames <= 0 || (numFrames < chunkSize && readPosition + numFrames < sound->getLength()))
+                return false;
+
+            sound->readFrames(scratch, readPosition, numFrames);
+
+            const auto start = int(written & (ringSize - 1));
+            const auto firstPart = jmin(numFrames, ringSize - start);
+
+            for (int channel = 0; channel < sound->getNumChannels(); ++channel)
+            {
+                ring.copyFrom(channel, start, scratch, channel, 0, firstPart);
+
+                if (firstPart < numFrames)
+                    ring.copyFrom(channel, 0, scratch, channel, firstPart, numFrames - firstPart);
+            }
+
+            readPosition += numFrames;
+            framesWritten.store(written + numFrames, std::memory_order_release);
+            return true;
+        }
+
+        AudioBuffer<float> ring;
+
+        // the voice's side
+        uint32 generation = 0;
+
+        std::atomic<const StreamingSamplerSound*> requestedSound { nullptr };
+        std::atomic<uint32> requestedGeneration { 0 };
+        std::atomic<uint32> servedGeneration { 0 };
+        std::atomic<int64> framesWritten { 0 };
+        std::atomic<int64> framesReleased { 0 };
+        std::atomic<int> underruns { 0 };
+
+        // the streamer's side
+        const StreamingSamplerSound* sound = nullptr;
+        int64 readPosition = 0;
+
+        JUCE_DECLARE_NON_COPYABLE (Stream)
+    };
+
+    SampleStreamer()
+        : Thread("Sample streamer"),
+          scratch(StreamingSamplerSound::maxChannels, chunkSize)
+    {
+    }
+
+    ~SampleStreamer() override
+    {
+        stop();
+    }
+
+    /** Makes numStreams streams, one per voice, in place of the old ones.
+        Only call this while the thread is stopped and no voice is using a
+        stream.
+    */
+    void setNumStreams (int numStreams)
+    {
+        jassert(! isThreadRunning());
+
+        streams.clear();
+
+        for (int i = 0; i < numStreams; ++i)
+            streams.add(new Stream());
+    }
+
+    Stream& getStream (int index) noexcept    { return *streams.getUnchecked(index); }
+    int getNumStreams() const noexcept        { return streams.size(); }
+
+    void start()    { startThread(Thread::Priority::high); }
+    void stop()     { stopThread(1000); }
+
+    /** Does the thread's work on the calling thread, until every stream has
+        answered its last request and has a full ring (or the whole sample).
+        For rendering faster than the thread could keep up with; only call
+        this while the thread is stopped.
+    */
+    void fillAll()
+    {
+        jassert(! isThreadRunning());
+
+        while (serviceStreams()) {}
+    }
+
+    int getNumUnderruns() const noexcept
+    {
+        int total = 0;
+
+        for (auto* stream : streams)
+            total += stream->getNumUnderruns();
+
+        return total;
+    }
+
+private:
+    void run() override
+    {
+        while (! threadShouldExit())
+            if (! serviceStreams())
+                wait(pollIntervalMs);
+    }
+
+    bool serviceStreams()
+    {
+        bool didWork = false;
+
+        for (auto* stream : streams)
+            didWork = stream->service(scratch) || didWork;
+
+        return didWork;
+    }
+
+    OwnedArray<Stream> streams;
+    AudioBuffer<float> scratch;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (SampleStreamer)
+};
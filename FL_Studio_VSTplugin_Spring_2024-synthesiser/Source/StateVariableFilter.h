@@ -0,0 +1,151 @@
+/**
+ * @file StateVariableFilter.h
+ *
+ * @brief Topology-preserving (zero-delay feedback) state variable filter
+ *        used for the voices' low, high and band pass modes.
+ *
+ * @author
+ */
+
+
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+
+
+/**
+    Trapezoidal-integrated state variable filter (Simper / Zavalishin). The
+    three outputs come from the same two integrator states, so switching mode
+    doesn't need a different filter, and because the structure is solved
+    without a unit delay in the feedback path it stays stable however fast
+    the cutoff moves.
+
+    The coefficients are only worked out again when the cutoff, resonance or
+    sample rate actually change. processSample() runs in the precision it's
+    given: float and double each have their own coefficients and integrator
+    states, so the float path stays as narrow as it was and the double one
+    never rounds through float.
+*/
+class StateVariableFilter
+{
+public:
+    // Same values as VoiceFilterType.
+    enum Mode
+    {
+        LowPass,
+        HighPass,
+        BandPass,
+        NumModes
+    };
+
+    template <typename ValueType>
+    struct CoefficientsOf
+    {
+        ValueType a1 = 1;
+        ValueType a2 = 0;
+        ValueType a3 = 0;
+        ValueType k = 1;
+    };
+
+    using Coefficients = CoefficientsOf<float>;
+
+    /** The RESONANCE parameter runs from 1 to 5; 1 gives a Butterworth
+        response (Q = 0.707) and each step up raises Q in proportion.
+        The cutoff is kept just under Nyquist, where tan() blows up.
+    */
+    template <typename ValueType = float>
+    static CoefficientsOf<ValueType> makeCoefficients (double sampleRate, float cutoff, float resonance)
+    {
+        const auto frequency = jlimit(10.0, sampleRate * 0.49, double(cutoff));
+        const auto q = MathConstants<double>::sqrt2 * 0.5 * jmax(1.0, double(resonance));
+
+        const auto g = std::tan(MathConstants<double>::pi * frequency / sampleRate);
+        const auto k = 1.0 / q;
+        const auto a1 = 1.0 / (1.0 + g * (g + k));
+
+        CoefficientsOf<ValueType> c;
+        c.a1 = ValueType(a1);
+        c.a2 = ValueType(g * a1);
+        c.a3 = ValueType(g * g * a1);
+        c.k = ValueType(k);
+        return c;
+    }
+
+    void setSampleRate (double newSampleRate)
+    {
+        if (newSampleRate != sampleRate)
+        {
+            sampleRate = newSampleRate;
+            updateCoefficients();
+        }
+    }
+
+    void setCutoffAndResonance (float newCutoff, float newResonance)
+    {
+        if (newCutoff != cutoff || newResonance != resonance)
+        {
+            cutoff = newCutoff;
+            resonance = newResonance;
+            updateCoefficients();
+        }
+    }
+
+    void reset()
+    {
+        floatState = {};
+        doubleState = {};
+    }
+
+    template <int FilterMode, typename SampleType>
+    SampleType processSample (SampleType input)
+    {
+        static_assert(std::is_same_v<SampleType, float> || std::is_same_v<SampleType, double>, "float or double only");
+
+        auto& state = getState<SampleType>();
+        const auto& c = state.coefficients;
+
+        const auto v3 = input - state.ic2;
+        const auto v1 = c.a1 * state.ic1 + c.a2 * v3;
+        const auto v2 = state.ic2 + c.a2 * state.ic1 + c.a3 * v3;
+
+        state.ic1 = SampleType(2) * v1 - state.ic1;
+        state.ic2 = SampleType(2) * v2 - state.ic2;
+
+        if constexpr (FilterMode == HighPass)
+            return input - c.k * v1 - v2;
+        else if constexpr (FilterMode == BandPass)
+            return c.k * v1;     // unity gain at the cutoff
+        else
+            return v2;
+    }
+
+private:
+    template <typename ValueType>
+    struct State
+    {
+        CoefficientsOf<ValueType> coefficients;
+        ValueType ic1 = 0, ic2 = 0;
+    };
+
+    template <typename SampleType>
+    State<SampleType>& getState() noexcept
+    {
+        if constexpr (std::is_same_v<SampleType, double>)
+            return doubleState;
+        else
+            return floatState;
+    }
+
+    void updateCoefficients()
+    {
+        floatState.coefficients = makeCoefficients<float>(sampleRate, cutoff, resonance);
+        doubleState.coefficients = makeCoefficients<double>(sampleRate, cutoff, resonance);
+    }
+
+    double sampleRate = 44100.0;
+    float cutoff = 400.0f;
+    float resonance = 1.0f;
+
+    State<float> floatState { makeCoefficients<float>(sampleRate, cutoff, resonance) };
+    State<double> doubleState { makeCoefficients<double>(sampleRate, cutoff, resonance) };
+};
@@ -0,0 +1,373 @@
+/**
+ * @file StreamingSampler.h
+ *
+ * @brief Synthesiser that plays a multisampled instrument from disk, with
+ *        StreamingSamplerVoices fed by a SampleStreamer.
+ *
+ * @author
+ */
+
+
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "StreamingSamplerSound.h"
+#include "StreamingSamplerVoice.h"
+#include "SampleStreamer.h"
+
+
+/**
+    Loads a library of WAV files as StreamingSamplerSounds and plays them.
+
+    Loading only maps each file and reads its head, so a library of several
+    gigabytes opens in about as long as it takes to read defaultPreloadLength
+    frames of every file, and keeps only those in memory; the streamer reads
+    the rest of a sample while it plays.
+
+    The streamer runs on its own thread, which keeps up with any real-time
+    playback. Rendering faster than real time (see setNonRealtime()) stops
+    the thread and fills the streams on the rendering thread before each
+    block instead, so an offline render never underruns.
+*/
+class StreamingSampler : public Synthesiser
+{
+public:
+    static constexpr int defaultNumVoices = 32;
+    static constexpr int defaultPreloadLength = 16384;
+
+    StreamingSampler()
+    {
+        setNumVoices(defaultNumVoices);
+    }
+
+    ~StreamingSampler() override
+    {
+        streamer.stop();
+    }
+
+    /** Replaces the voices, and their streams, with numVoices new ones.
+        Don't call this from the audio thread.
+    */
+    void setNumVoices (int numVoices)
+    {
+        const auto wasStreaming = isStreaming;
+        stopStreaming();
+
+        {
+            const ScopedLock sl (lock);
+
+            clearVoices();
+            streamer.setNumStreams(numVoices);
+
+            for (int i = 0; i < numVoices; ++i)
+                addVoice(new StreamingSamplerVoice(streamer.getStream(i)));
+
+            for (auto* voice : voices)
+                if (auto* samplerVoice = dynamic_cast<StreamingSamplerVoice*>(voice))
+                    samplerVoice->setEnvelope(envelope);
+        }
+
+        if (wasStreaming)
+            startStreaming();
+    }
+
+    /** Loads every zone's file, skipping the ones that can't be opened, and
+        swaps them in for the current library. Returns how many loaded.
+        Don't call this from the audio thread.
+    */
+    int loadZones (const Array<SampleZone>& zones, int preloadLength = defaultPreloadLength)
+    {
+        ReferenceCountedArray<StreamingSamplerSound> loaded;
+
+        for (const auto& zone : zones)
+            if (auto sound = StreamingSamplerSound::load(zone, preloadLength))
+                loaded.add(sound);
+
+        setSounds(loaded);
+        return loaded.size();
+    }
+
+    /** Loads every WAV file in directory as a zone. A file's root note is
+        the one in its sampler chunk or, failing that, a note name in its
+        file name ("Piano_C#3_v80.wav"; C4 is middle C), and the keyboard is
+        split halfway between neighbouring roots. Files that share a root
+        are velocity layers: a "v<n>" in the name gives the layer's highest
+        velocity, and each layer starts above the one below. Returns how many
+        files loaded. Don't call this from the audio thread.
+    */
+    int loadDirectory (const File& directory, int preloadLength = defaultPreloadLength)
+    {
+        auto files = directory.findChildFiles(File::findFiles, false, "*.wav;*.WAV");
+        files.sort();
+
+        ReferenceCountedArray<StreamingSamplerSound> loaded;
+
+        for (const auto& file : files)
+        {
+            SampleZone zone;
+            zone.file = file;
+            zone.rootNote = parseNoteName(file.getFileNameWithoutExtension());
+            zone.highVelocity = parseVelocityLayer(file.getFileNameWithoutExtension());
+
+            if (auto sound = StreamingSamplerSound::load(zone, preloadLength))
+                loaded.add(sound);
+        }
+
+        layOutZones(loaded);
+        setSounds(loaded);
+        return loaded.size();
+    }
+
+    // Stops every note and drops the library.
+    void clearLibrary()
+    {
+        setSounds({});
+    }
+
+    bool hasLibrary() const
+    {
+        const ScopedLock sl (lock);
+        return ! sounds.isEmpty();
+    }
+
+    // The memory held by the preloaded heads.
+    size_t getPreloadedBytes() const
+    {
+        const ScopedLock sl (lock);
+
+        size_t total = 0;
+
+        for (auto* sound : sounds)
+            if (auto* samplerSound = dynamic_cast<StreamingSamplerSound*>(sound))
+                total += samplerSound->getPreloadedBytes();
+
+        return total;
+    }
+
+    // How many times a voice has had to wait for its stream, since the voices were made.
+    int getNumUnderruns() const    { return streamer.getNumUnderruns(); }
+
+    void setEnvelope (const ADSR::Parameters& newEnvelope)
+    {
+        const ScopedLock sl (lock);
+
+        if (newEnvelope.attack == envelope.attack && newEnvelope.decay == envelope.decay
+             && newEnvelope.sustain == envelope.sustain && newEnvelope.release == envelope.release)
+            return;
+
+        envelope = newEnvelope;
+
+        for (auto* voice : voices)
+            if (auto* samplerVoice = dynamic_cast<StreamingSamplerVoice*>(voice))
+                samplerVoice->setEnvelope(envelope);
+    }
+
+    bool isAnyVoiceActive() const
+    {
+        return getNumActiveVoices() > 0;
+    }
+
+    int getNumActiveVoices() const
+    {
+        const ScopedLock sl (lock);
+
+        int numActive = 0;
+
+        for (auto* voice : voices)
+            if (voice->isVoiceActive())
+                ++numActive;
+
+        return numActive;
+    }
+
+    /** With shouldBeNonRealtime, the streamer's thread is stopped and
+        renderNextBlock() fills the streams itself before rendering. Don't
+        call this from the audio thread.
+    */
+    void setNonRealtime (bool shouldBeNonRealtime)
+    {
+        if (shouldBeNonRealtime == isNonRealtime)
+            return;
+
+        isNonRealtime = shouldBeNonRealtime;
+
+        if (isStreaming)
+        {
+            stopStreaming();
+            startStreaming();
+        }
+    }
+
+    // Like Synthesiser::noteOn(), but only velocity layers that cover the
+    // velocity play.
+    void noteOn (int midiChannel, int midiNoteNumber, float velocity) override
+    {
+        const ScopedLock sl (lock);
+
+        const auto midiVelocity = jlimit(1, 127, roundToInt(velocity * 127.0f));
+
+        // a note that's still ringing is let go first
+        for (auto* voice : voices)
+            if (voice->getCurrentlyPlayingNote() == midiNoteNumber && voice->isPlayingChannel(midiChannel))
+                stopVoice(voice, 1.0f, true);
+
+        for (auto* sound : sounds)
+        {
+            auto* samplerSound = dynamic_cast<StreamingSamplerSound*>(sound);
+
+            if (samplerSound == nullptr || ! samplerSound->appliesToNote(midiNoteNumber) || ! samplerSound->appliesToChannel(midiChannel)
+                 || ! samplerSound->appliesToVelocity(midiVelocity))
+                continue;
+
+            startVoice(findFreeVoice(sound, midiChannel, midiNoteNumber, isNoteStealingEnabled()),
+                       sound, midiChannel, midiNoteNumber, velocity);
+        }
+    }
+
+protected:
+    void renderVoices (AudioBuffer<float>& outputAudio, int startSample, int numSamples) override
+    {
+        fillStreamsIfNonRealtime();
+        Synthesiser::renderVoices(outputAudio, startSample, numSamples);
+    }
+
+    void renderVoices (AudioBuffer<double>& outputAudio, int startSample, int numSamples) override
+    {
+        fillStreamsIfNonRealtime();
+        Synthesiser::renderVoices(outputAudio, startSample, numSamples);
+    }
+
+private:
+    void fillStreamsIfNonRealtime()
+    {
+        if (isNonRealtime)
+            streamer.fillAll();
+    }
+
+    // Swaps the library in with every voice stopped and the streamer idle,
+    // as the streams hold raw pointers to the sounds they're reading.
+    void setSounds (const ReferenceCountedArray<StreamingSamplerSound>& newSounds)
+    {
+        stopStreaming();
+
+        {
+            const ScopedLock sl (lock);
+
+            allNotesOff(0, false);
+            clearSounds();
+
+            for (auto* sound : newSounds)
+                addSound(sound);
+        }
+
+        // the voices' stop requests are answered before anything plays again
+        streamer.fillAll();
+
+        if (! newSounds.isEmpty())
+            startStreaming();
+    }
+
+    void startStreaming()
+    {
+        isStreaming = true;
+
+        if (! isNonRealtime)
+            streamer.start();
+    }
+
+    void stopStreaming()
+    {
+        isStreaming = false;
+        streamer.stop();
+    }
+
+    // "C4", "F#2", "Bb-1" anywhere in name, between separators, or -1.
+    static int parseNoteName (const String& name)
+    {
+        auto tokens = StringArray::fromTokens(name, "_ .", {});
+
+        for (const auto& token : tokens)
+        {
+            const auto letter = token.substring(0, 1).toUpperCase();
+            const auto pitchClass = String("C D EF G A B").indexOf(letter);
+
+            if (pitchClass < 0 || token.length() < 2)
+                continue;
+
+            auto rest = token.substring(1);
+            auto note = pitchClass;
+
+            if (rest.startsWithChar('#'))
+                ++note;
+            else if (rest.startsWithChar('b'))
+                --note;
+
+            if (rest.startsWithChar('#') || rest.startsWithChar('b'))
+                rest = rest.substring(1);
+
+            if (rest.isEmpty() || ! rest.trimCharactersAtStart("-").containsOnly("0123456789"))
+                continue;
+
+            note += (rest.getIntValue() + 1) * 12;
+
+            if (isPositiveAndBelow(note, 128))
+                return note;
+        }
+
+        return -1;
+    }
+
+    // The n of a "v<n>" token, or 127.
+    static int parseVelocityLayer (const String& name)
+    {
+        auto tokens = StringArray::fromTokens(name, "_ .", {});
+
+        for (const auto& token : tokens)
+            if ((token.startsWithChar('v') || token.startsWithChar('V')) && token.length() > 1
+                 && token.substring(1).containsOnly("0123456789"))
+                return jlimit(1, 127, token.substring(1).getIntValue());
+
+        return 127;
+    }
+
+    // Splits the keyboard between the distinct root notes, and the
+    // velocities between the layers on each root.
+    static void layOutZones (ReferenceCountedArray<StreamingSamplerSound>& sounds)
+    {
+        SortedSet<int> roots;
+
+        for (auto* sound : sounds)
+            roots.add(sound->getZone().rootNote);
+
+        for (auto* sound : sounds)
+        {
+            const auto& zone = sound->getZone();
+            const auto index = roots.indexOf(zone.rootNote);
+
+            const auto lowNote = index > 0 ? (roots[index - 1] + zone.rootNote) / 2 + 1 : 0;
+            const auto highNote = index < roots.size() - 1 ? (zone.rootNote + roots[index + 1]) / 2 : 127;
+
+            // the highest layer below this one on the same root
+            auto lowVelocity = 1;
+
+            for (auto* other : sounds)
+            {
+                const auto& otherZone = other->getZone();
+
+                if (other != sound && otherZone.rootNote == zone.rootNote && otherZone.highVelocity < zone.highVelocity)
+                    lowVelocity = jmax(lowVelocity, otherZone.highVelocity + 1);
+            }
+
+            sound->setKeyRange(lowNote, highNote);
+            sound->setVelocityRange(lowVelocity, zone.highVelocity);
+        }
+    }
+
+    SampleStreamer streamer;
+    ADSR::Parameters envelope { 0.001f, 0.1f, 1.0f, 0.3f };
+
+    bool isStreaming = false;
+    bool isNonRealtime = false;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (StreamingSampler)
+};
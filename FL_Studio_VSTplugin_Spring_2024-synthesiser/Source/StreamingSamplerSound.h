@@ -0,0 +1,141 @@
+/**
+ * @file StreamingSamplerSound.h
+ *
+ * @brief One zone of a multisampled instrument: a memory-mapped WAV file
+ *        with its first few thousand frames preloaded into RAM.
+ *
+ * @author
+ */
+
+
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+
+
+// Where a sample plays: the note it was recorded at and the key and
+// velocity ranges it covers. A negative rootNote is taken from the file's
+// sampler chunk, or is middle C if it hasn't got one.
+struct SampleZone
+{
+    File file;
+    int rootNote = -1;
+    int lowNote = 0;
+    int highNote = 127;
+    int lowVelocity = 1;
+    int highVelocity = 127;
+};
+
+
+/**
+    A sample played by StreamingSamplerVoice. Only the head, the first
+    preloadLength frames, is read into memory; the file as a whole is mapped
+    with WavAudioFormat's MemoryMappedAudioFormatReader, which costs address
+    space but no RAM until SampleStreamer reads the rest on its thread as
+    notes play. Opening a library is therefore one small read per file
+    however large the files are, and what stays resident is the heads.
+
+    A voice starts playing from the head straight away, which gives the
+    streamer the head's length to catch up.
+*/
+class StreamingSamplerSound : public SynthesiserSound
+{
+public:
+    using Ptr = ReferenceCountedObjectPtr<StreamingSamplerSound>;
+
+    static constexpr int maxChannels = 2;
+
+    /** Opens zone's file, or returns nullptr if it isn't a WAV file that can
+        be mapped. Files with more than two channels play their first two.
+    */
+    static Ptr load (const SampleZone& zone, int preloadLength)
+    {
+        WavAudioFormat wavFormat;
+        std::unique_ptr<MemoryMappedAudioFormatReader> reader (wavFormat.createMemoryMappedReader(zone.file));
+
+        if (reader == nullptr || reader->lengthInSamples <= 0 || reader->numChannels == 0 || ! reader->mapEntireFile())
+            return nullptr;
+
+        return new StreamingSamplerSound(zone, std::move(reader), preloadLength);
+    }
+
+    bool appliesToNote (int midiNoteNumber) override
+    {
+        return midiNoteNumber >= zone.lowNote && midiNoteNumber <= zone.highNote;
+    }
+
+    bool appliesToChannel (int) override    { return true; }
+
+    // The Synthesiser doesn't ask this; StreamingSampler::noteOn() does.
+    bool appliesToVelocity (int velocity) const noexcept
+    {
+        return velocity >= zone.lowVelocity && velocity <= zone.highVelocity;
+    }
+
+    const SampleZone& getZone() const noexcept        { return zone; }
+
+    // For laying out a library; only call these before the sound is added
+    // to a sampler.
+    void setKeyRange (int lowNote, int highNote) noexcept
+    {
+        zone.lowNote = lowNote;
+        zone.highNote = highNote;
+    }
+
+    void setVelocityRange (int lowVelocity, int highVelocity) noexcept
+    {
+        zone.lowVelocity = lowVelocity;
+        zone.highVelocity = highVelocity;
+    }
+
+    double getSourceSampleRate() const noexcept       { return sourceSampleRate; }
+    int64 getLength() const noexcept                  { return length; }
+    int getNumChannels() const noexcept               { return head.getNumChannels(); }
+
+    // The preloaded frames, which are getHeadLength() long (or the whole
+    // sample, if that's shorter).
+    const AudioBuffer<float>& getHead() const noexcept    { return head; }
+    int getHeadLength() const noexcept                    { return head.getNumSamples(); }
+
+    size_t getPreloadedBytes() const noexcept
+    {
+        return size_t(head.getNumChannels()) * size_t(head.getNumSamples()) * sizeof(float);
+    }
+
+    /** Reads numFrames from the mapped file, starting at startFrame, into the
+        start of destination. Only SampleStreamer's thread calls this: it's
+        where the file's pages get touched, so it can wait on the disk.
+    */
+    void readFrames (AudioBuffer<float>& destination, int64 startFrame, int numFrames) const
+    {
+        jassert(destination.getNumChannels() >= getNumChannels() && destination.getNumSamples() >= numFrames);
+
+        reader->read(&destination, 0, numFrames, startFrame, true, true);
+    }
+
+private:
+    StreamingSamplerSound (const SampleZone& newZone, std::unique_ptr<MemoryMappedAudioFormatReader> newReader, int preloadLength)
+        : zone(newZone),
+          reader(std::move(newReader)),
+          sourceSampleRate(reader->sampleRate),
+          length(reader->lengthInSamples)
+    {
+        if (zone.rootNote < 0)
+            zone.rootNote = jlimit(0, 127, reader->metadataValues.getValue("MidiUnityNote", "60").getIntValue());
+
+        const auto numChannels = jmin(maxChannels, int(reader->numChannels));
+        const auto headLength = int(jmin(int64(jmax(1, preloadLength)), length));
+
+        head.setSize(numChannels, headLength);
+        readFrames(head, 0, headLength);
+    }
+
+    SampleZone zone;
+    std::unique_ptr<MemoryMappedAudioFormatReader> reader;
+    double sourceSampleRate;
+    int64 length;
+
+    AudioBuffer<float> head;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (StreamingSamplerSound)
+};
@@ -0,0 +1,174 @@
+/**
+ * @file StreamingSamplerVoice.h
+ *
+ * @brief Plays a StreamingSamplerSound from its preloaded head and then from
+ *        the frames SampleStreamer brings in behind it.
+ *
+ * @author
+ */
+
+
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "StreamingSamplerSound.h"
+#include "SampleStreamer.h"
+
+
+/**
+    A sampler voice that resamples its sound to the note's pitch (by linear
+    interpolation, up to maxPitchRatio times the recorded speed) with an ADSR
+    on top. The first getHeadLength() frames come from RAM, the rest from
+    the voice's stream; if the stream hasn't got the next frames yet the
+    voice holds its place and outputs silence until it has, and the stream
+    counts an underrun.
+
+    Renders into float or double buffers; the samples themselves are float.
+*/
+class StreamingSamplerVoice : public SynthesiserVoice
+{
+public:
+    static constexpr double maxPitchRatio = 4.0;
+
+    explicit StreamingSamplerVoice (SampleStreamer::Stream& streamToUse)
+        : stream(streamToUse)
+    {
+    }
+
+    bool canPlaySound (SynthesiserSound* sound) override
+    {
+        return dynamic_cast<StreamingSamplerSound*>(sound) != nullptr;
+    }
+
+    void setEnvelope (const ADSR::Parameters& parameters)
+    {
+        envelope.setParameters(parameters);
+    }
+
+    void startNote (int midiNoteNumber, float velocity, SynthesiserSound* sound, int /*currentPitchWheelPosition*/) override
+    {
+        playingSound = dynamic_cast<StreamingSamplerSound*>(sound);
+
+        if (playingSound == nullptr)
+        {
+            jassertfalse;
+            return;
+        }
+
+        const auto semitones = midiNoteNumber - playingSound->getZone().rootNote;
+        pitchRatio = jmin(maxPitchRatio, std::exp2(semitones / 12.0) * playingSound->getSourceSampleRate() / getSampleRate());
+        position = 0.0;
+        gain = velocity;
+
+        envelope.setSampleRate(getSampleRate());
+        envelope.noteOn();
+
+        if (playingSound->getLength() > playingSound->getHeadLength())
+            stream.start(playingSound);
+        else
+            stream.stop();
+    }
+
+    void stopNote (float /*velocity*/, bool allowTailOff) override
+    {
+        if (allowTailOff)
+            envelope.noteOff();
+        else
+            finishNote();
+    }
+
+    void pitchWheelMoved (int) override          {}
+    void controllerMoved (int, int) override     {}
+
+    void renderNextBlock (AudioBuffer<float>& outputBuffer, int startSample, int numSamples) override
+    {
+        renderInto(outputBuffer, startSample, numSamples);
+    }
+
+    void renderNextBlock (AudioBuffer<double>& outputBuffer, int startSample, int numSamples) override
+    {
+        renderInto(outputBuffer, startSample, numSamples);
+    }
+
+private:
+    template <typename SampleType>
+    void renderInto (AudioBuffer<SampleType>& outputBuffer, int startSample, int numSamples)
+    {
+        if (playingSound == nullptr)
+            return;
+
+        const auto& head = playingSound->getHead();
+        const auto headLength = int64(head.getNumSamples());
+        const auto length = playingSound->getLength();
+        const auto lastSourceChannel = playingSound->getNumChannels() - 1;
+        const auto numOutputs = jmin(outputBuffer.getNumChannels(), 2);
+
+        // everything up to here can be read this block, without waiting
+        const auto available = headLength + stream.getNumFramesAvailable();
+
+        for (int i = 0; i < numSamples; ++i)
+        {
+            const auto frame = int64(position);
+
+            // the last frame has nothing to interpolate towards
+            if (frame + 1 >= length)
+            {
+                finishNote();
+                break;
+            }
+
+            if (frame + 1 >= available)
+            {
+                stream.underran();
+                break;
+            }
+
+            const auto fraction = SampleType(position - double(frame));
+            const auto level = SampleType(gain * envelope.getNextSample());
+
+            for (int channel = 0; channel < numOutputs; ++channel)
+            {
+                const auto sourceChannel = jmin(channel, lastSourceChannel);
+                const auto a = SampleType(getFrame(head, sourceChannel, frame));
+                const auto b = SampleType(getFrame(head, sourceChannel, frame + 1));
+
+                outputBuffer.addSample(channel, startSample + i, level * (a + fraction * (b - a)));
+            }
+
+            position += pitchRatio;
+
+            if (! envelope.isActive())
+            {
+                finishNote();
+                break;
+            }
+        }
+
+        if (playingSound != nullptr)
+            stream.releaseFramesBefore(jmax(int64(0), int64(position) - headLength));
+    }
+
+    float getFrame (const AudioBuffer<float>& head, int channel, int64 frame) const noexcept
+    {
+        return frame < head.getNumSamples() ? head.getSample(channel, int(frame))
+                                            : stream.getSample(channel, frame - head.getNumSamples());
+    }
+
+    void finishNote()
+    {
+        stream.stop();
+        envelope.reset();
+        playingSound = nullptr;
+        clearCurrentNote();
+    }
+
+    SampleStreamer::Stream& stream;
+    StreamingSamplerSound* playingSound = nullptr;
+
+    ADSR envelope;
+    double position = 0.0;
+    double pitchRatio = 1.0;
+    float gain = 1.0f;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (StreamingSamplerVoice)
+};
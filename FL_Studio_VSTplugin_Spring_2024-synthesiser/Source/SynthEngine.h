@@ -0,0 +1,563 @@
+/**
+ * @file SynthEngine.h
+ *
+ * @brief Synthesiser that allocates voices in constant time, starts and
+ *        stops their notes on the exact sample without splitting the render,
+ *        smooths parameter changes across them, ramps per-note (MPE)
+ *        expression into them, can hand their rendering over to a
+ *        SynthVoiceBank or spread it over a VoiceRenderPool, and can run
+ *        them oversampled.
+ *
+ * @author
+ */
+
+
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "SynthVoice.h"
+#include "SynthVoiceBank.h"
+#include "SynthParameters.h"
+#include "VoiceRenderPool.h"
+#include "VoiceAllocator.h"
+#include "Oversampler.h"
+#include "NoteExpression.h"
+#include "NoteScheduler.h"
+
+
+class SynthEngine : public Synthesiser
+{
+public:
+    /** Replaces all the voices with numVoices made by createVoice, and sizes
+        the allocator for them. Don't call this from the audio thread.
+    */
+    void setNumVoices (int numVoices, const std::function<SynthesiserVoice*()>& createVoice)
+    {
+        const ScopedLock sl (lock);
+
+        clearVoices();
+
+        for (int i = 0; i < numVoices; i++)
+            addVoice(createVoice());
+
+        allocator.setNumVoices(numVoices);
+
+        for (int i = 0; i < numVoices; i++)
+        {
+            if (auto* voice = dynamic_cast<SynthVoice*>(getVoice(i)))
+            {
+                voice->setVoiceAllocator(&allocator, i);
+                voice->setNoteScheduler(&scheduler);
+                voice->setModulationInterval(modulationInterval);
+            }
+        }
+
+        activeVoices.ensureStorageAllocated(numVoices);
+
+        if (voiceBank != nullptr)
+            setVoiceBank(voiceBank);
+
+        appliedParameterVersion = 0;
+    }
+
+    /** Chooses which playing voice a note-on takes over when none are free
+        (and note stealing is enabled).
+    */
+    void setStealingPolicy (VoiceAllocator::StealingPolicy newPolicy)
+    {
+        const ScopedLock sl (lock);
+        stealingPolicy = newPolicy;
+    }
+
+    /** When enabled, a note-on for a note that is still sounding restarts that
+        voice instead of letting it ring out and starting another.
+    */
+    void setRetriggerSameNote (bool shouldRetrigger)
+    {
+        const ScopedLock sl (lock);
+        retriggerSameNote = shouldRetrigger;
+    }
+
+    // True while any voice is playing a note or its release tail.
+    bool isAnyVoiceActive() const
+    {
+        const ScopedLock sl (lock);
+
+        if (isAllocatorInSync())
+            return allocator.getOldestBusyVoice() != VoiceAllocator::noVoice;
+
+        for (auto* voice : voices)
+            if (voice->isVoiceActive())
+                return true;
+
+        return false;
+    }
+
+    /** Moves the parameter ramps on by a block that wasn't rendered because
+        nothing was playing, so a change made during the silence is in place
+        by the next note rather than gliding in under it.
+    */
+    void skipSilentBlock (int numSamples)
+    {
+        const ScopedLock sl (lock);
+
+        const int factor = oversampler != nullptr ? oversampler->getFactor() : 1;
+        applyParameters(smoothedParameters.advance(numSamples * factor));
+    }
+
+    int getNumActiveVoices() const
+    {
+        const ScopedLock sl (lock);
+
+        int numActive = 0;
+
+        for (auto* voice : voices)
+            if (voice->isVoiceActive())
+                ++numActive;
+
+        return numActive;
+    }
+
+    void noteOn (int midiChannel, int midiNoteNumber, float velocity) override
+    {
+        const ScopedLock sl (lock);
+
+        // voices added some other way than setNumVoices() aren't tracked
+        if (! isAllocatorInSync())
+        {
+            Synthesiser::noteOn(midiChannel, midiNoteNumber, velocity);
+            return;
+        }
+
+        for (auto* sound : sounds)
+        {
+            if (! (sound->appliesToNote(midiNoteNumber) && sound->appliesToChannel(midiChannel)))
+                continue;
+
+            int index = allocator.getVoicePlayingNote(midiChannel, midiNoteNumber);
+
+            if (index != VoiceAllocator::noVoice && ! retriggerSameNote)
+            {
+                // like Synthesiser::noteOn(), a note that's still ringing is
+                // let go before the new one starts
+                stopVoice(voices.getUnchecked(index), 1.0f, true);
+                index = VoiceAllocator::noVoice;
+            }
+
+            if (index == VoiceAllocator::noVoice)
+                index = allocator.getFreeVoice();
+
+            if (index == VoiceAllocator::noVoice && isNoteStealingEnabled())
+                index = findVoiceIndexToSteal();
+
+            if (index == VoiceAllocator::noVoice)
+                continue;
+
+            auto* voice = voices.getUnchecked(index);
+
+            // a stolen or retriggered voice is cut off before it restarts
+            if (voice->isVoiceActive())
+                voice->stopNote(0.0f, false);
+
+            startVoice(voice, sound, midiChannel, midiNoteNumber, velocity);
+            allocator.voiceStarted(index, midiChannel, midiNoteNumber);
+
+            // the expression sent ahead of a note applies from its first sample
+            if (auto* synthVoice = dynamic_cast<SynthVoice*>(voice))
+                synthVoice->setExpression(expression.getExpression(midiChannel, true), true);
+        }
+    }
+
+    void noteOff (int midiChannel, int midiNoteNumber, float velocity, bool allowTailOff) override
+    {
+        const ScopedLock sl (lock);
+
+        if (! isAllocatorInSync())
+        {
+            Synthesiser::noteOff(midiChannel, midiNoteNumber, velocity, allowTailOff);
+            return;
+        }
+
+        // Only the newest voice on a note can still have its key down, so it
+        // is the only one to look at. The rest is as Synthesiser::noteOff().
+        const int index = allocator.getVoicePlayingNote(midiChannel, midiNoteNumber);
+
+        if (index == VoiceAllocator::noVoice)
+            return;
+
+        auto* voice = voices.getUnchecked(index);
+
+        if (voice->getCurrentlyPlayingNote() != midiNoteNumber || ! voice->isPlayingChannel(midiChannel))
+            return;
+
+        if (auto sound = voice->getCurrentlyPlayingSound())
+        {
+            if (sound->appliesToNote(midiNoteNumber) && sound->appliesToChannel(midiChannel))
+            {
+                voice->setKeyDown(false);
+
+                if (! (voice->isSustainPedalDown() || voice->isSostenutoPedalDown()))
+                    stopVoice(voice, velocity, allowTailOff);
+            }
+        }
+    }
+
+    void setCurrentPlaybackSampleRate (double newRate) override
+    {
+        Synthesiser::setCurrentPlaybackSampleRate(newRate);
+
+        const ScopedLock sl (lock);
+
+        smoothedParameters.reset(newRate);
+
+        // envelope and filter coefficients depend on the sample rate
+        appliedParameterVersion = 0;
+    }
+
+    /** Sets how many samples apart the voices evaluate their modulation
+        routes. Shorter is smoother and costs more; 16 to 32 is plenty for
+        LFOs and envelopes.
+    */
+    void setModulationInterval (int numSamples)
+    {
+        const ScopedLock sl (lock);
+
+        modulationInterval = jmax(1, numSamples);
+
+        for (auto* voice : voices)
+            if (auto* synthVoice = dynamic_cast<SynthVoice*>(voice))
+                synthVoice->setModulationInterval(modulationInterval);
+    }
+
+    int getModulationInterval() const noexcept    { return modulationInterval; }
+
+    /** Sets the values the voices should move to. Changes are ramped in over
+        the following blocks, in sub-blocks of
+        SmoothedSynthParameters::subBlockSize samples.
+    */
+    void setParameters (const SynthParameterSnapshot& params)
+    {
+        const ScopedLock sl (lock);
+        smoothedParameters.setTargets(params);
+    }
+
+    /** Attaches every SynthVoice to a lane of the bank (voice i uses lane i),
+        or detaches them again when bank is nullptr. While attached, voices only
+        handle note on/off and the bank renders all of them in one pass.
+    */
+    void setVoiceBank (SynthVoiceBank* bank)
+    {
+        const ScopedLock sl (lock);
+
+        jassert(bank == nullptr || getNumVoices() <= SynthVoiceBank::maxVoices);
+
+        if (bank != nullptr)
+            bank->reset();
+
+        for (int i = 0; i < getNumVoices(); i++)
+        {
+            if (auto* voice = dynamic_cast<SynthVoice*>(getVoice(i)))
+                voice->setVoiceBank(bank, i);
+        }
+
+        voiceBank = bank;
+        appliedParameterVersion = 0;
+    }
+
+    SynthVoiceBank* getVoiceBank() const noexcept    { return voiceBank; }
+
+    /** Renders the voices on pool's threads whenever at least its threshold
+        of voices are active, or always on the audio thread when pool is
+        nullptr. The pool must already be prepared for the block size.
+    */
+    void setRenderPool (VoiceRenderPool* pool)
+    {
+        const ScopedLock sl (lock);
+
+        activeVoices.ensureStorageAllocated(getNumVoices());
+        renderPool = pool;
+    }
+
+    VoiceRenderPool* getRenderPool() const noexcept    { return renderPool; }
+
+    /** While an oversampler with a factor above 1 is attached, the voices
+        render into its buffer and it decimates them into the output. The
+        engine's playback rate (and the voices' block sizes) must already be
+        the host's multiplied by that factor, and the oversampler prepared
+        for the host's block size.
+    */
+    void setOversampler (Oversampler* newOversampler)
+    {
+        const ScopedLock sl (lock);
+        oversampler = newOversampler;
+    }
+
+    Oversampler* getOversampler() const noexcept    { return oversampler; }
+
+    /** Takes the pitch bend, pressure and CC74 messages out of a block's MIDI
+        and returns the rest, which is what should be passed on to
+        renderNextBlock() for the same numSamples. The expression reaches the
+        voices as ramps across the block instead of one render split per
+        message. See NoteExpressionTracker.
+    */
+    const MidiBuffer& extractExpression (const MidiBuffer& midi, int numSamples)
+    {
+        const ScopedLock sl (lock);
+        return expression.extract(midi, numSamples);
+    }
+
+    /** Sets up MPE zones directly, for hosts that don't send the MPE
+        configuration messages. Without zones, each MIDI channel's expression
+        applies to every note on it.
+    */
+    void setZoneLayout (const MPEZoneLayout& newLayout)
+    {
+        const ScopedLock sl (lock);
+        expression.setZoneLayout(newLayout);
+    }
+
+    MPEZoneLayout getZoneLayout() const
+    {
+        const ScopedLock sl (lock);
+        return expression.getZoneLayout();
+    }
+
+    /** Like Synthesiser::renderNextBlock(), but every MIDI event in the block
+        is handled before anything renders, and the voices start and stop
+        their notes on the event's sample (see NoteScheduler). The render is
+        only split for parameter and expression ramps, however dense the
+        MIDI, where Synthesiser::renderNextBlock() splits it at every event.
+        With a voice bank attached, or voices that weren't made by
+        setNumVoices(), it is Synthesiser::renderNextBlock().
+    */
+    template <typename SampleType>
+    void renderNextBlock (AudioBuffer<SampleType>& outputAudio, const MidiBuffer& inputMidi, int startSample, int numSamples)
+    {
+        // must set the sample rate before using this!
+        jassert(getSampleRate() != 0);
+
+        const ScopedLock sl (lock);
+
+        if (voiceBank != nullptr || ! isAllocatorInSync())
+        {
+            Synthesiser::renderNextBlock(outputAudio, inputMidi, startSample, numSamples);
+            return;
+        }
+
+        const int factor = oversampler != nullptr ? oversampler->getFactor() : 1;
+        const auto endSample = startSample + numSamples;
+
+        for (auto it = inputMidi.findNextSamplePosition(startSample); it != inputMidi.cend(); ++it)
+        {
+            const auto metadata = *it;
+
+            if (metadata.samplePosition >= endSample)
+                break;
+
+            scheduler.setEventTime(scheduler.getRenderTime() + int64(metadata.samplePosition - startSample) * factor);
+            handleMidiEvent(metadata.getMessage());
+        }
+
+        scheduler.setEventTime(NoteScheduler::immediately);
+
+        renderVoices(outputAudio, startSample, numSamples);
+    }
+
+protected:
+    void renderVoices (AudioBuffer<float>& outputAudio, int startSample, int numSamples) override
+    {
+        renderVoicesInto(outputAudio, startSample, numSamples);
+    }
+
+    /** The voices render into double buffers directly (see SynthVoice), so
+        a host running in double precision doesn't round them through float.
+        The voice bank and the oversampler stay float inside and add their
+        results to the double output; the render pool isn't used, so the
+        voices render on the calling thread.
+    */
+    void renderVoices (AudioBuffer<double>& outputAudio, int startSample, int numSamples) override
+    {
+        renderVoicesInto(outputAudio, startSample, numSamples);
+    }
+
+private:
+    template <typename SampleType>
+    void renderVoicesInto (AudioBuffer<SampleType>& outputAudio, int startSample, int numSamples)
+    {
+        while (numSamples > 0)
+        {
+            int subBlockSize = numSamples;
+
+            if (smoothedParameters.isSmoothing())
+                subBlockSize = jmin(subBlockSize, SmoothedSynthParameters::subBlockSize);
+            else if (expression.isRamping())
+                subBlockSize = jmin(subBlockSize, NoteExpressionTracker::updateInterval);
+
+            const int factor = oversampler != nullptr ? oversampler->getFactor() : 1;
+
+            // the parameter ramps run at the engine's rate, which is the
+            // oversampled one; the expression ramps count host samples
+            applyParameters(smoothedParameters.advance(subBlockSize * factor));
+            applyExpression(subBlockSize);
+
+            if (factor > 1)
+            {
+                renderSubBlock(oversampler->getBufferToRenderInto(subBlockSize), 0, subBlockSize * factor);
+                oversampler->addDecimated(outputAudio, startSample, subBlockSize);
+            }
+            else
+            {
+                renderSubBlock(outputAudio, startSample, subBlockSize);
+            }
+
+            scheduler.advance(subBlockSize * factor);
+            clearReleasedVoices();
+
+            startSample += subBlockSize;
+            numSamples -= subBlockSize;
+        }
+    }
+
+    template <typename SampleType>
+    void renderSubBlock (AudioBuffer<SampleType>& outputAudio, int startSample, int numSamples)
+    {
+        if (voiceBank != nullptr)
+            voiceBank->renderNextBlock(outputAudio, startSample, numSamples);
+        else if (! renderOnPool(outputAudio, startSample, numSamples))
+            Synthesiser::renderVoices(outputAudio, startSample, numSamples);
+    }
+
+    bool isAllocatorInSync() const noexcept    { return allocator.getNumVoices() == getNumVoices(); }
+
+    // Frees the voices whose release finished during the last render.
+    void clearReleasedVoices()
+    {
+        if (! isAllocatorInSync())
+        {
+            for (auto* voice : voices)
+                if (auto* synthVoice = dynamic_cast<SynthVoice*>(voice))
+                    synthVoice->clearNoteIfReleased();
+
+            return;
+        }
+
+        for (int i = allocator.getOldestBusyVoice(); i != VoiceAllocator::noVoice;)
+        {
+            // clearing takes the voice off the busy list, so step on first
+            const int next = allocator.getNextBusyVoice(i);
+
+            if (auto* voice = dynamic_cast<SynthVoice*>(voices.getUnchecked(i)))
+                voice->clearNoteIfReleased();
+
+            i = next;
+        }
+    }
+
+    int findVoiceIndexToSteal() const
+    {
+        if (stealingPolicy == VoiceAllocator::StealOldest)
+            return allocator.getOldestBusyVoice();
+
+        // Quietest by envelope level; on a tie the older note goes.
+        auto quietest = VoiceAllocator::noVoice;
+        auto quietestLevel = std::numeric_limits<float>::max();
+
+        for (int i = allocator.getOldestBusyVoice(); i != VoiceAllocator::noVoice; i = allocator.getNextBusyVoice(i))
+        {
+            auto* voice = dynamic_cast<SynthVoice*>(voices.getUnchecked(i));
+            const auto voiceLevel = voice != nullptr ? voice->getEnvelopeLevel() : 1.0f;
+
+            if (voiceLevel < quietestLevel)
+            {
+                quietest = i;
+                quietestLevel = voiceLevel;
+            }
+        }
+
+        return quietest;
+    }
+
+    // The pool's workers only mix float buffers.
+    bool renderOnPool (AudioBuffer<double>&, int, int)    { return false; }
+
+    bool renderOnPool (AudioBuffer<float>& outputAudio, int startSample, int numSamples)
+    {
+        if (renderPool == nullptr)
+            return false;
+
+        // voices that have never been started, or have been stopped, are
+        // silent, so only playing ones are handed out
+        activeVoices.clearQuick();
+
+        for (auto* voice : voices)
+            if (voice->isVoiceActive())
+                activeVoices.add(voice);
+
+        if (! renderPool->shouldRender(activeVoices.size()))
+            return false;
+
+        renderPool->renderVoices(activeVoices.getRawDataPointer(), activeVoices.size(), outputAudio, startSample, numSamples);
+        return true;
+    }
+
+    // Pushes params to the voices (and the bank) when they differ from the
+    // ones applied last.
+    void applyParameters (const SynthParameterSnapshot& params)
+    {
+        if (params.version == appliedParameterVersion)
+            return;
+
+        for (int i = 0; i < getNumVoices(); i++)
+        {
+            if (auto* voice = dynamic_cast<SynthVoice*>(getVoice(i)))
+            {
+                voice->getEnvelope(params.attack, params.decay, params.sustain, params.release);
+                voice->getOscWaveform(params.waveform);
+                voice->getFilter(params.filterType, params.filterCutoff, params.filterResonance);
+                voice->getUnison(params.unisonVoices, params.unisonDetune, params.unisonSpread);
+                voice->getModulation(params.modulation);
+            }
+        }
+
+        if (voiceBank != nullptr)
+        {
+            voiceBank->setEnvelope(params.attack, params.decay, params.sustain, params.release);
+            voiceBank->setOscWaveform(params.waveform);
+            voiceBank->setFilter(params.filterType, params.filterCutoff, params.filterResonance);
+        }
+
+        appliedParameterVersion = params.version;
+    }
+
+    // Moves the expression ramps on and hands each playing voice where its
+    // channel's have got to by the end of the sub-block.
+    void applyExpression (int numSamples)
+    {
+        if (! expression.isRamping())
+            return;
+
+        expression.advance(numSamples);
+
+        for (auto* voice : voices)
+            if (voice->isVoiceActive())
+                if (auto* synthVoice = dynamic_cast<SynthVoice*>(voice))
+                    synthVoice->setExpression(expression.getExpression(synthVoice->getMidiChannel()));
+    }
+
+    VoiceAllocator allocator;
+    VoiceAllocator::StealingPolicy stealingPolicy = VoiceAllocator::StealOldest;
+    bool retriggerSameNote = false;
+
+    SmoothedSynthParameters smoothedParameters;
+    uint32 appliedParameterVersion = 0;
+
+    NoteExpressionTracker expression;
+    int modulationInterval = 32;
+
+    NoteScheduler scheduler;
+
+    SynthVoiceBank* voiceBank = nullptr;
+    VoiceRenderPool* renderPool = nullptr;
+    Oversampler* oversampler = nullptr;
+    Array<SynthesiserVoice*> activeVoices;
+};
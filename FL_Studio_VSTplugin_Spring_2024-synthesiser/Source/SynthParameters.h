@@ -0,0 +1,382 @@
+/**
+ * @file SynthParameters.h
+ *
+ * @brief Cached handles to the synth's parameters, the per-block snapshot
+ *        the voices are set up from, and the ramps that smooth it.
+ *
+ * @author
+ */
+
+
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "Modulation.h"
+
+
+// The values every voice is configured with. version goes up each time any
+// of them changes, so users only need to compare it with the version they
+// last applied.
+struct SynthParameterSnapshot
+{
+    float attack = 0.0f;
+    float decay = 0.0f;
+    float sustain = 0.0f;
+    float release = 0.0f;
+    float waveform = 0.0f;
+    float filterType = 0.0f;
+    float filterCutoff = 0.0f;
+    float filterResonance = 0.0f;
+    float unisonVoices = 1.0f;
+    float unisonDetune = 0.0f;
+    float unisonSpread = 0.0f;
+    ModulationSettings modulation;
+
+    uint32 version = 0;
+
+    bool hasSameValues (const SynthParameterSnapshot& other) const noexcept
+    {
+        return attack == other.attack
+            && decay == other.decay
+            && sustain == other.sustain
+            && release == other.release
+            && waveform == other.waveform
+            && filterType == other.filterType
+            && filterCutoff == other.filterCutoff
+            && filterResonance == other.filterResonance
+            && unisonVoices == other.unisonVoices
+            && unisonDetune == other.unisonDetune
+            && unisonSpread == other.unisonSpread
+            && modulation == other.modulation;
+    }
+};
+
+
+/**
+    Looks up the parameters' atomics once, when the processor is built, so
+    the audio thread never searches the value tree by ID. update() reads them
+    all into a fresh snapshot once per block.
+
+    Code that changes several parameters as one (restoring a saved state)
+    does so inside a ScopedChange; update() keeps returning the previous
+    snapshot until the change is complete, so a block never picks up half
+    of it.
+
+    A program change on the audio thread can't wait for the parameters to
+    be set: holdSnapshot() swaps the program's snapshot in straight away,
+    and update() keeps returning it until the next ScopedChange, which is
+    where the program's values are written to the parameters.
+*/
+class SynthParameters
+{
+public:
+    explicit SynthParameters (AudioProcessorValueTreeState& valueTreeToUse)
+        : valueTree       (valueTreeToUse),
+          attack          (getParameter(valueTreeToUse, "ATTACK")),
+          decay           (getParameter(valueTreeToUse, "DECAY")),
+          sustain         (getParameter(valueTreeToUse, "SUSTAIN")),
+          release         (getParameter(valueTreeToUse, "RELEASE")),
+          waveform        (getParameter(valueTreeToUse, "WAVEFORM")),
+          filterType      (getParameter(valueTreeToUse, "FILTER_TYPE")),
+          filterCutoff    (getParameter(valueTreeToUse, "FILTER_CUTOFF")),
+          filterResonance (getParameter(valueTreeToUse, "FILTER_RESONANCE")),
+          unisonVoices    (getParameter(valueTreeToUse, "UNISON_VOICES")),
+          unisonDetune    (getParameter(valueTreeToUse, "UNISON_DETUNE")),
+          unisonSpread    (getParameter(valueTreeToUse, "UNISON_SPREAD"))
+    {
+        for (int i = 0; i < ModulationSettings::numLfos; ++i)
+        {
+            const auto prefix = "LFO" + String(i + 1) + "_";
+            lfos[(size_t) i] = { getParameter(valueTree, prefix + "RATE"), getParameter(valueTree, prefix + "SHAPE") };
+        }
+
+        envelope2 = { getParameter(valueTree, "ENV2_ATTACK"), getParameter(valueTree, "ENV2_DECAY"),
+                      getParameter(valueTree, "ENV2_SUSTAIN"), getParameter(valueTree, "ENV2_RELEASE") };
+
+        for (int i = 0; i < ModulationSettings::numRoutes; ++i)
+        {
+            const auto prefix = "MOD" + String(i + 1) + "_";
+            routes[(size_t) i] = { getParameter(valueTree, prefix + "SOURCE"), getParameter(valueTree, prefix + "TARGET"),
+                                   getParameter(valueTree, prefix + "AMOUNT") };
+        }
+
+        update();
+    }
+
+    struct ScopedChange
+    {
+        explicit ScopedChange (SynthParameters& p) noexcept  : parameters(p)    { parameters.changeCount.fetch_add(1); }
+        ~ScopedChange() noexcept                                               { parameters.changeCount.fetch_add(1); }
+
+        SynthParameters& parameters;
+
+        JUCE_DECLARE_NON_COPYABLE (ScopedChange)
+    };
+
+    // Reads the current values, bumping the version only if one has moved.
+    const SynthParameterSnapshot& update() noexcept
+    {
+        // odd while a ScopedChange is open
+        const auto changeCountBefore = changeCount.load();
+
+        if ((changeCountBefore & 1) != 0)
+            return snapshot;
+
+        if (isHolding)
+        {
+            if (int32(changeCountBefore - holdReleaseCount) < 0)
+                return snapshot;
+
+            isHolding = false;
+        }
+
+        SynthParameterSnapshot latest;
+        readValues(latest, [] (const std::atomic<float>* value) { return value->load(); });
+
+        // a change started or finished while reading, so this may be a mix
+        if (changeCount.load() != changeCountBefore)
+            return snapshot;
+
+        if (snapshot.version == 0 || ! latest.hasSameValues(snapshot))
+        {
+            latest.version = snapshot.version + 1;
+            snapshot = latest;
+        }
+
+        return snapshot;
+    }
+
+    /** Makes newSnapshot the current one on the audio thread, without
+        touching the parameters, until a ScopedChange that starts after this
+        call has finished. Copies the values and nothing else.
+    */
+    void holdSnapshot (const SynthParameterSnapshot& newSnapshot) noexcept
+    {
+        const auto version = snapshot.version;
+        snapshot = newSnapshot;
+        snapshot.version = version + 1;
+
+        // the first even count after a whole change that hasn't begun yet
+        const auto count = changeCount.load();
+        holdReleaseCount = ((count + 1) & ~1u) + 2;
+        isHolding = true;
+    }
+
+    /** The snapshot update() would return if the parameters held values,
+        one per processor parameter as SynthState reads them. Parameters the
+        snapshot doesn't use are ignored. Not for the audio thread.
+    */
+    SynthParameterSnapshot makeSnapshot (const Array<float>& values) const
+    {
+        // the handles are the value tree's own atomics, so they identify
+        // the parameters
+        std::map<const std::atomic<float>*, float> valuesByHandle;
+        const auto& allParameters = valueTree.processor.getParameters();
+
+        for (int i = 0; i < jmin(allParameters.size(), values.size()); ++i)
+            if (auto* ranged = dynamic_cast<const RangedAudioParameter*>(allParameters.getUnchecked(i)))
+                valuesByHandle[valueTree.getRawParameterValue(ranged->getParameterID())] = values.getUnchecked(i);
+
+        SynthParameterSnapshot result;
+        readValues(result, [&] (const std::atomic<float>* value)
+        {
+            const auto found = valuesByHandle.find(value);
+            return found != valuesByHandle.end() ? found->second : value->load();
+        });
+
+        result.version = 1;
+        return result;
+    }
+
+    const SynthParameterSnapshot& getSnapshot() const noexcept    { return snapshot; }
+
+private:
+    // Fills in every value of destination with readValue(handle).
+    template <typename ReadValue>
+    void readValues (SynthParameterSnapshot& latest, ReadValue&& readValue) const
+    {
+        latest.attack = readValue(attack);
+        latest.decay = readValue(decay);
+        latest.sustain = readValue(sustain);
+        latest.release = readValue(release);
+        latest.waveform = readValue(waveform);
+        latest.filterType = readValue(filterType);
+        latest.filterCutoff = readValue(filterCutoff);
+        latest.filterResonance = readValue(filterResonance);
+        latest.unisonVoices = readValue(unisonVoices);
+        latest.unisonDetune = readValue(unisonDetune);
+        latest.unisonSpread = readValue(unisonSpread);
+
+        for (size_t i = 0; i < lfos.size(); ++i)
+            latest.modulation.lfos[i] = { readValue(lfos[i].rate), readValue(lfos[i].shape) };
+
+        latest.modulation.envelope2 = { readValue(envelope2.attack), readValue(envelope2.decay),
+                                        readValue(envelope2.sustain), readValue(envelope2.release) };
+
+        for (size_t i = 0; i < routes.size(); ++i)
+            latest.modulation.routes[i] = { readValue(routes[i].source), readValue(routes[i].target), readValue(routes[i].amount) };
+    }
+
+    static std::atomic<float>* getParameter (AudioProcessorValueTreeState& valueTree, StringRef parameterID)
+    {
+        auto* value = valueTree.getRawParameterValue(parameterID);
+
+        // every ID used here must be in the processor's parameter layout
+        jassert(value != nullptr);
+
+        return value;
+    }
+
+    AudioProcessorValueTreeState& valueTree;
+
+    std::atomic<float>* attack;
+    std::atomic<float>* decay;
+    std::atomic<float>* sustain;
+    std::atomic<float>* release;
+    std::atomic<float>* waveform;
+    std::atomic<float>* filterType;
+    std::atomic<float>* filterCutoff;
+    std::atomic<float>* filterResonance;
+    std::atomic<float>* unisonVoices;
+    std::atomic<float>* unisonDetune;
+    std::atomic<float>* unisonSpread;
+
+    struct LfoParameters        { std::atomic<float>* rate; std::atomic<float>* shape; };
+    struct EnvelopeParameters   { std::atomic<float>* attack; std::atomic<float>* decay; std::atomic<float>* sustain; std::atomic<float>* release; };
+    struct RouteParameters      { std::atomic<float>* source; std::atomic<float>* target; std::atomic<float>* amount; };
+
+    std::array<LfoParameters, ModulationSettings::numLfos> lfos {};
+    EnvelopeParameters envelope2 {};
+    std::array<RouteParameters, ModulationSettings::numRoutes> routes {};
+
+    SynthParameterSnapshot snapshot;
+    std::atomic<uint32> changeCount { 0 };
+
+    // audio thread only
+    bool isHolding = false;
+    uint32 holdReleaseCount = 0;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (SynthParameters)
+};
+
+
+/**
+    Ramps the continuous parameters towards the latest snapshot so that host
+    automation doesn't reach the voices as one step per block. Cutoff and the
+    envelope times glide multiplicatively, sustain, resonance and the unison
+    detune and spread linearly; waveform, filter type, the number of
+    unison voices and the modulation settings change straight away (the
+    modulation is only applied at its control rate anyway).
+
+    advance() is called once per sub-block of up to subBlockSize samples
+    while a ramp is running, and returns a snapshot whose version only moves
+    while something is still ramping.
+*/
+class SmoothedSynthParameters
+{
+public:
+    static constexpr int subBlockSize = 32;
+    static constexpr double rampLengthSeconds = 0.05;
+
+    SmoothedSynthParameters() = default;
+
+    void reset (double sampleRate)
+    {
+        attack.reset(sampleRate, rampLengthSeconds);
+        decay.reset(sampleRate, rampLengthSeconds);
+        sustain.reset(sampleRate, rampLengthSeconds);
+        release.reset(sampleRate, rampLengthSeconds);
+        filterCutoff.reset(sampleRate, rampLengthSeconds);
+        filterResonance.reset(sampleRate, rampLengthSeconds);
+        unisonDetune.reset(sampleRate, rampLengthSeconds);
+        unisonSpread.reset(sampleRate, rampLengthSeconds);
+    }
+
+    void setTargets (const SynthParameterSnapshot& target) noexcept
+    {
+        if (target.version == targetVersion)
+            return;
+
+        targetVersion = target.version;
+
+        // the first values jump straight in rather than gliding up from zero
+        if (current.version == 0)
+        {
+            attack.setCurrentAndTargetValue(target.attack);
+            decay.setCurrentAndTargetValue(target.decay);
+            sustain.setCurrentAndTargetValue(target.sustain);
+            release.setCurrentAndTargetValue(target.release);
+            filterCutoff.setCurrentAndTargetValue(target.filterCutoff);
+            filterResonance.setCurrentAndTargetValue(target.filterResonance);
+            unisonDetune.setCurrentAndTargetValue(target.unisonDetune);
+            unisonSpread.setCurrentAndTargetValue(target.unisonSpread);
+        }
+        else
+        {
+            attack.setTargetValue(target.attack);
+            decay.setTargetValue(target.decay);
+            sustain.setTargetValue(target.sustain);
+            release.setTargetValue(target.release);
+            filterCutoff.setTargetValue(target.filterCutoff);
+            filterResonance.setTargetValue(target.filterResonance);
+            unisonDetune.setTargetValue(target.unisonDetune);
+            unisonSpread.setTargetValue(target.unisonSpread);
+        }
+
+        current.waveform = target.waveform;
+        current.filterType = target.filterType;
+        current.unisonVoices = target.unisonVoices;
+        current.modulation = target.modulation;
+        readCurrentValues();
+    }
+
+    bool isSmoothing() const noexcept
+    {
+        return attack.isSmoothing() || decay.isSmoothing() || sustain.isSmoothing()
+            || release.isSmoothing() || filterCutoff.isSmoothing() || filterResonance.isSmoothing()
+            || unisonDetune.isSmoothing() || unisonSpread.isSmoothing();
+    }
+
+    // Moves every ramp on by numSamples.
+    const SynthParameterSnapshot& advance (int numSamples) noexcept
+    {
+        if (isSmoothing())
+        {
+            attack.skip(numSamples);
+            decay.skip(numSamples);
+            sustain.skip(numSamples);
+            release.skip(numSamples);
+            filterCutoff.skip(numSamples);
+            filterResonance.skip(numSamples);
+            unisonDetune.skip(numSamples);
+            unisonSpread.skip(numSamples);
+            readCurrentValues();
+        }
+
+        return current;
+    }
+
+    const SynthParameterSnapshot& getCurrent() const noexcept    { return current; }
+
+private:
+    void readCurrentValues() noexcept
+    {
+        current.attack = attack.getCurrentValue();
+        current.decay = decay.getCurrentValue();
+        current.sustain = sustain.getCurrentValue();
+        current.release = release.getCurrentValue();
+        current.filterCutoff = filterCutoff.getCurrentValue();
+        current.filterResonance = filterResonance.getCurrentValue();
+        current.unisonDetune = unisonDetune.getCurrentValue();
+        current.unisonSpread = unisonSpread.getCurrentValue();
+        ++current.version;
+    }
+
+    SmoothedValue<float, ValueSmoothingTypes::Multiplicative> attack, decay, release, filterCutoff;
+    SmoothedValue<float, ValueSmoothingTypes::Linear> sustain, filterResonance, unisonDetune, unisonSpread;
+
+    SynthParameterSnapshot current;
+    uint32 targetVersion = 0;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (SmoothedSynthParameters)
+};
@@ -0,0 +1,180 @@
+/**
+ * @file SynthState.h
+ *
+ * @brief Compact, versioned binary form of the plugin's parameter state,
+ *        used by getStateInformation() / setStateInformation().
+ *
+ * @author
+ */
+
+
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "SynthParameters.h"
+
+
+/**
+    The state is a short header followed by one entry per parameter:
+
+        uint32  magic ('SYNS')
+        uint16  format version
+        uint16  number of entries
+        then per entry:
+            uint32  FNV-1a hash of the parameter ID
+            float32 the parameter's (denormalised) value
+
+    all little-endian, which is 8 bytes per parameter instead of the few
+    hundred an XML copy of the value tree takes, and needs no parsing
+    beyond reading fixed-size fields. Entries are keyed by ID rather than
+    position, so parameters can be added or reordered later: unknown IDs
+    are skipped and parameters missing from older states get their
+    defaults.
+*/
+class SynthState
+{
+public:
+    static constexpr uint32 magic = 0x534e5953;     // "SYNS" when read as bytes
+    static constexpr int currentVersion = 1;
+    static constexpr int headerSize = 8;
+    static constexpr int entrySize = 8;
+
+    static uint32 hashParameterID (const String& parameterID) noexcept
+    {
+        uint32 hash = 2166136261u;
+
+        for (auto* c = parameterID.toRawUTF8(); *c != 0; ++c)
+        {
+            hash ^= (uint8) *c;
+            hash *= 16777619u;
+        }
+
+        return hash;
+    }
+
+    // Replaces destData with the current values of every ranged parameter.
+    static void write (const AudioProcessor& processor, MemoryBlock& destData)
+    {
+        const auto& allParameters = processor.getParameters();
+
+        destData.setSize(0);
+        destData.ensureSize((size_t) (headerSize + entrySize * allParameters.size()));
+
+        MemoryOutputStream stream(destData, false);
+        stream.writeInt((int) magic);
+        stream.writeShort((short) currentVersion);
+        stream.writeShort((short) countRangedParameters(processor));
+
+        for (auto* parameter : allParameters)
+        {
+            if (auto* ranged = dynamic_cast<const RangedAudioParameter*>(parameter))
+            {
+                stream.writeInt((int) hashParameterID(ranged->getParameterID()));
+                stream.writeFloat(ranged->convertFrom0to1(ranged->getValue()));
+            }
+        }
+    }
+
+    /** Sets every ranged parameter from data, or returns false without
+        touching any of them if data isn't a state this version can read.
+        The audio thread sees the old values or the new ones, never a mix,
+        because the changes are made inside a SynthParameters::ScopedChange.
+    */
+    static bool read (AudioProcessor& processor, SynthParameters& parameters, const void* data, int sizeInBytes)
+    {
+        Array<float> newValues;
+
+        if (! parse(processor, data, sizeInBytes, newValues))
+            return false;
+
+        apply(processor, parameters, newValues);
+        return true;
+    }
+
+    /** Reads data into values, one (denormalised) value per processor
+        parameter, without touching the parameters. Values are snapped to
+        their parameter's range and missing ones are the defaults. Returns
+        false if data isn't a state this version can read.
+    */
+    static bool parse (const AudioProcessor& processor, const void* data, int sizeInBytes, Array<float>& values)
+    {
+        if (data == nullptr || sizeInBytes < headerSize)
+            return false;
+
+        MemoryInputStream stream(data, (size_t) sizeInBytes, false);
+
+        if ((uint32) stream.readInt() != magic)
+            return false;
+
+        const auto version = (int) (uint16) stream.readShort();
+        const auto numEntries = (int) (uint16) stream.readShort();
+
+        if (version < 1 || version > currentVersion || sizeInBytes < headerSize + numEntries * entrySize)
+            return false;
+
+        const auto& allParameters = processor.getParameters();
+        values = getDefaultValues(processor);
+
+        for (int entry = 0; entry < numEntries; ++entry)
+        {
+            const auto hash = (uint32) stream.readInt();
+            const auto value = stream.readFloat();
+
+            for (int i = 0; i < allParameters.size(); ++i)
+            {
+                auto* ranged = dynamic_cast<const RangedAudioParameter*>(allParameters.getUnchecked(i));
+
+                if (ranged != nullptr && hashParameterID(ranged->getParameterID()) == hash)
+                {
+                    if (std::isfinite(value))
+                        values.setUnchecked(i, ranged->getNormalisableRange().snapToLegalValue(value));
+
+                    break;
+                }
+            }
+        }
+
+        return true;
+    }
+
+    // Every parameter's default, as parse() lays the values out.
+    static Array<float> getDefaultValues (const AudioProcessor& processor)
+    {
+        const auto& allParameters = processor.getParameters();
+        Array<float> values;
+        values.resize(allParameters.size());
+
+        for (int i = 0; i < allParameters.size(); ++i)
+            if (auto* ranged = dynamic_cast<const RangedAudioParameter*>(allParameters.getUnchecked(i)))
+                values.setUnchecked(i, ranged->convertFrom0to1(ranged->getDefaultValue()));
+
+        return values;
+    }
+
+    /** Sets every ranged parameter to its entry in values, as parse() lays
+        them out, inside a SynthParameters::ScopedChange.
+    */
+    static void apply (AudioProcessor& processor, SynthParameters& parameters, const Array<float>& values)
+    {
+        const auto& allParameters = processor.getParameters();
+        jassert(values.size() == allParameters.size());
+
+        const SynthParameters::ScopedChange change(parameters);
+
+        for (int i = 0; i < jmin(values.size(), allParameters.size()); ++i)
+            if (auto* ranged = dynamic_cast<RangedAudioParameter*>(allParameters.getUnchecked(i)))
+                ranged->setValueNotifyingHost(ranged->convertTo0to1(values.getUnchecked(i)));
+    }
+
+private:
+    static int countRangedParameters (const AudioProcessor& processor)
+    {
+        int numRanged = 0;
+
+        for (auto* parameter : processor.getParameters())
+            if (dynamic_cast<const RangedAudioParameter*>(parameter) != nullptr)
+                ++numRanged;
+
+        return numRanged;
+    }
+};
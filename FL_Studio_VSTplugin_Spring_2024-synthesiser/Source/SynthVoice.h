@@ -11,12 +11,34 @@
 
 #include "../JuceLibraryCode/JuceHeader.h"
 #include "SynthSound.h"
-#include "maximilian.h"
+#include "VoiceKernels.h"
+#include "SynthVoiceBank.h"
+#include "VoiceAllocator.h"
+#include "NoteExpression.h"
+#include "Modulation.h"
+#include "NoteScheduler.h"
 
 
 class SynthVoice : public SynthesiserVoice
 {
 public:
+    // Envelope level (-80 dB) below which a released note counts as finished.
+    static constexpr double silenceThreshold = 1.0e-4;
+
+    // Note starts and stops a voice can hold for later in a block; past
+    // that, the oldest is acted on early.
+    static constexpr int maxScheduledNotes = 8;
+
+    // Samples between checks for the end of a release, which stops the render.
+    static constexpr int releaseCheckInterval = 64;
+
+    explicit SynthVoice (const Wavetables& tables)
+        : wavetables(tables)
+    {
+        state.osc1.setFrequency(wavetables, state.frequency, getSampleRate());
+        state.unison.setFrequency(wavetables, state.frequency, getSampleRate());
+    }
+
     bool canPlaySound (SynthesiserSound* sound) override
     {
         return dynamic_cast <SynthSound*>(sound) != nullptr;
@@ -24,67 +46,132 @@ public:
 
     void getOscWaveform(float waveform)
     {
-        theWave = int(waveform);
+        if (int(waveform) != theWave)
+        {
+            theWave = int(waveform);
+            updateKernels();
+        }
+    }
+
+    void getEnvelope(float attack, float decay, float sustain, float release)
+    {
+        state.env1.setAttack(double(attack));
+        state.env1.setDecay(double(decay));
+        state.env1.setSustain(double(sustain));
+        state.env1.setRelease(double(release));
     }
 
-    double setOscWaveform()
+    void getFilter(float filterType, float filterCutoff, float filterResonance)
     {
-        switch(theWave)
+        if (int(filterType) != filterSelection)
         {
-            case 0: return osc1.sinewave(frequency);
-            case 1: return osc1.saw(frequency);
-            case 2: return osc1.square(frequency);
-            default: return osc1.sinewave(frequency); 
+            filterSelection = int(filterType);
+            updateKernels();
         }
+
+        baseCutoff = double(filterCutoff);
+        baseResonance = double(filterResonance);
+        updateFilterSettings();
     }
 
-    void getEnvelope(float attack, float decay, float sustain, float release)
+    /** Routes the LFOs and second envelope to the cutoff, resonance, pitch
+        and level (see VoiceModulator). They're evaluated every
+        modulationInterval samples: the level is ramped between those points
+        and the rest are stepped, which the filter and the oscillators' phase
+        take without clicks. Like timbre, this only reaches voices rendered by
+        SynthVoice, not by the voice bank.
+    */
+    void getModulation(const ModulationSettings& settings)
     {
-        env1.setAttack(double(attack));
-        env1.setDecay(double(decay));
-        env1.setSustain(double(sustain));
-        env1.setRelease(double(release));
+        modulator.setSettings(settings);
     }
 
-    double setEnvelope()
+    // Samples between modulation updates, from 1 up to the block size.
+    void setModulationInterval(int numSamples)
     {
-        return env1.adsr(setOscWaveform(), env1.trigger);
+        modulationInterval = jmax(1, numSamples);
     }
 
-    void getFilter(float filterType, float filterCutoff, float filterResonance)
+    /** With more than one unison voice, the note is played by a stack of
+        that many detuned oscillators spread across the stereo field (see
+        UnisonOscillator) instead of a single one. The voice bank always
+        plays one oscillator per note, so this has no effect while a bank is
+        attached.
+    */
+    void getUnison(float unisonVoices, float detuneCents, float spread)
     {
-        filterSelection = int(filterType);
-        cutoff = filterCutoff;
-        resonance = filterResonance;
+        if (int(unisonVoices) == numUnisonVoices && detuneCents == unisonDetune && spread == unisonSpread)
+            return;
+
+        numUnisonVoices = jlimit(1, UnisonOscillator::maxVoices, int(unisonVoices));
+        unisonDetune = detuneCents;
+        unisonSpread = spread;
+
+        state.unison.setVoices(numUnisonVoices, unisonDetune, unisonSpread);
+        state.unison.setFrequency(wavetables, state.frequency, getSampleRate());
     }
 
-    double setFilter()
+    void startNote (int midiNoteNumber, float velocity, SynthesiserSound* sound, int currentPitchWheelPosition) override
     {
-        switch(filterSelection)
-        {
-            case 0: return filter1.lores(setEnvelope(), cutoff, resonance);
-            case 1: return filter1.hires(setEnvelope(), cutoff, resonance);
-            case 2: return filter1.bandpass(setEnvelope(), cutoff, resonance);
-            default: return filter1.lores(setEnvelope(), cutoff, resonance);
-        }
+        // the Synthesiser has already set the channel, but only lets us test it
+        for (midiChannel = 1; midiChannel < NoteExpressionTracker::numChannels; ++midiChannel)
+            if (isPlayingChannel(midiChannel))
+                break;
+
+        if (! schedule(ScheduledNote::start(midiNoteNumber, velocity)))
+            beginNote(midiNoteNumber, velocity);
     }
-    
-    void startNote (int midiNoteNumber, float velocity, SynthesiserSound* sound, int currentPitchWheelPosition) override
+
+    int getMidiChannel() const noexcept    { return midiChannel; }
+
+    /** Bends the note's pitch, scales its level by 1 + pressure and moves the
+        filter cutoff up to two octaves either side of its setting with the
+        timbre. SynthEngine calls this between sub-blocks with the ramped
+        values for the note's channel; the level change is ramped over the
+        next render, the pitch and cutoff change as a step. Pass startsNote
+        for a note that hasn't rendered yet, so its level starts where it
+        should rather than ramping there; if the note's start is scheduled,
+        the expression waits for it.
+    */
+    void setExpression (const NoteExpression& newExpression, bool startsNote = false)
     {
-        env1.trigger = 1;
-        frequency = MidiMessage::getMidiNoteInHertz(midiNoteNumber);
-        level = velocity;
+        if (startsNote && numScheduled > 0)
+        {
+            auto& last = getScheduled(numScheduled - 1);
+
+            if (last.type == ScheduledNote::Start)
+            {
+                last.expression = newExpression;
+                last.hasExpression = true;
+                return;
+            }
+        }
+
+        useExpression(newExpression, startsNote);
     }
     
     void stopNote (float velocity, bool allowTailOff) override
     {
-        env1.trigger = 0;
-        allowTailOff = true;
-        
-        if (velocity == 0)
-            clearCurrentNote();
+        // Without a tail, the voice is free, and silent, straight away; one
+        // that's been taken for another note plays the old one until the new
+        // one is due.
+        if (! allowTailOff)
+        {
+            if (! isScheduling())
+                releaseNote(false);
+
+            clearNote();
+            return;
+        }
+
+        // with one, the note is cleared by clearNoteIfReleased() once the
+        // release has died away
+        if (! schedule(ScheduledNote::release()))
+            releaseNote(true);
     }
     
+    // Pitch bend, pressure and timbre never get here: SynthEngine takes them
+    // out of the MIDI and passes them on through setExpression().
     void pitchWheelMoved (int newPitchWheelValue) override
     {
         
@@ -95,30 +182,468 @@ public:
         
     }
     
+    void prepareToPlay (double sampleRate, int samplesPerBlock)
+    {
+        state.filter1.setSampleRate(sampleRate);
+        state.filter2.setSampleRate(sampleRate);
+        modulator.prepare(sampleRate);
+
+        // the oscillators' increments depend on the rate, so a voice that
+        // replays its last pitch after a rate change would be off-pitch
+        setOscillatorFrequency(sampleRate);
+
+        // the second channel is only used for unison's right channel; the
+        // double buffer is for hosts that render in double precision
+        voiceBuffer.setSize(2, samplesPerBlock, false, false, true);
+        doubleVoiceBuffer.setSize(2, samplesPerBlock, false, false, true);
+    }
+
+    // While a bank is attached, this voice's lane is rendered by the bank
+    // together with every other voice, so renderNextBlock() does nothing.
+    void setVoiceBank (SynthVoiceBank* bank, int lane)
+    {
+        clearNote();
+
+        voiceBank = bank;
+        bankLane = lane;
+    }
+
+    // The allocator is told whenever this voice's note is cleared, so it can
+    // put the voice back on its free queue.
+    void setVoiceAllocator (VoiceAllocator* newAllocator, int index)
+    {
+        allocator = newAllocator;
+        allocatorIndex = index;
+    }
+
+    /** The engine's timeline. Notes started and stopped while it has an
+        event time are held until the render reaches that sample; without a
+        scheduler, or with a voice bank attached, they start and stop at once.
+    */
+    void setNoteScheduler (const NoteScheduler* newScheduler)
+    {
+        scheduler = newScheduler;
+    }
+
+    // Current envelope amplitude, used to pick the quietest voice to steal.
+    float getEnvelopeLevel() const
+    {
+        return float(state.env1.amplitude);
+    }
+
+    /** Frees the voice if its note has been released and the envelope has
+        fallen below silenceThreshold. Rendering only flags this, so that it
+        can run on a worker thread; the synth calls this afterwards on the
+        audio thread.
+    */
+    void clearNoteIfReleased()
+    {
+        if (! isVoiceActive())
+            return;
+
+        const bool isFinished = voiceBank != nullptr ? ! voiceBank->isVoicePlaying(bankLane)
+                                                     : releaseHasFinished;
+
+        if (isFinished)
+            clearNote();
+    }
+
     void renderNextBlock (AudioBuffer <float> &outputBuffer, int startSample, int numSamples) override
     {
-        for (int sample = 0; sample < numSamples; ++sample)
+        renderInto(outputBuffer, startSample, numSamples);
+    }
+
+    // Renders straight into a double buffer, without going through float.
+    void renderNextBlock (AudioBuffer <double> &outputBuffer, int startSample, int numSamples) override
+    {
+        renderInto(outputBuffer, startSample, numSamples);
+    }
+
+private:
+    struct ScheduledNote
+    {
+        enum Type
+        {
+            Start,
+            Release
+        };
+
+        int64 time = 0;
+        Type type = Start;
+        int midiNoteNumber = 0;
+        float velocity = 0.0f;
+
+        // what SynthEngine::noteOn() set for the note, applied as it starts
+        NoteExpression expression;
+        bool hasExpression = false;
+
+        // schedule() fills in the time
+        static ScheduledNote start (int midiNoteNumber, float velocity) noexcept
+        {
+            ScheduledNote note;
+            note.midiNoteNumber = midiNoteNumber;
+            note.velocity = velocity;
+            return note;
+        }
+
+        static ScheduledNote release() noexcept
+        {
+            ScheduledNote note;
+            note.type = Release;
+            return note;
+        }
+    };
+
+    bool isScheduling() const noexcept
+    {
+        return scheduler != nullptr && scheduler->getEventTime() != NoteScheduler::immediately && voiceBank == nullptr;
+    }
+
+    // Holds note for the scheduler's event time, or returns false if it
+    // should happen now, after anything already held.
+    bool schedule (ScheduledNote note)
+    {
+        if (! isScheduling())
+        {
+            playScheduledNotes(std::numeric_limits<int64>::max());
+            return false;
+        }
+
+        if (numScheduled == maxScheduledNotes)
+            playNextScheduledNote();
+
+        note.time = scheduler->getEventTime();
+        getScheduled(numScheduled++) = note;
+        return true;
+    }
+
+    ScheduledNote& getScheduled (int index) noexcept
+    {
+        return scheduledNotes[(size_t) ((firstScheduled + index) % maxScheduledNotes)];
+    }
+
+    // Starts and stops every held note due by time, in order.
+    void playScheduledNotes (int64 time)
+    {
+        while (numScheduled > 0 && getScheduled(0).time <= time)
+            playNextScheduledNote();
+    }
+
+    void playNextScheduledNote()
+    {
+        const auto note = getScheduled(0);
+        firstScheduled = (firstScheduled + 1) % maxScheduledNotes;
+        --numScheduled;
+
+        if (note.type == ScheduledNote::Release)
+        {
+            releaseNote(true);
+            return;
+        }
+
+        beginNote(note.midiNoteNumber, note.velocity);
+
+        if (note.hasExpression)
+            useExpression(note.expression, true);
+    }
+
+    // The sound of startNote() and stopNote(), once they're due.
+    void beginNote (int midiNoteNumber, float velocity)
+    {
+        state.env1.trigger = 1;
+        baseFrequency = MidiMessage::getMidiNoteInHertz(midiNoteNumber);
+        state.unison.resetPhases();
+        level = velocity;
+
+        modulator.noteStarted();
+        modulationGain = modulator.getValues().gain;
+
+        expression = NoteExpression();
+        updateFrequency(true);
+        updateFilterSettings();
+        currentGain = targetGain = 1.0f;
+
+        if (voiceBank != nullptr)
+            voiceBank->startVoice(bankLane, state.frequency);
+    }
+
+    void useExpression (const NoteExpression& newExpression, bool startsNote)
+    {
+        expression = newExpression;
+        updateFrequency();
+        updateFilterSettings();
+        targetGain = 1.0f + jlimit(0.0f, 1.0f, expression.pressure);
+
+        if (startsNote)
+            currentGain = targetGain;
+
+        if (voiceBank != nullptr)
+            voiceBank->setVoiceExpression(bankLane, state.frequency, targetGain);
+    }
+
+    void releaseNote (bool allowTailOff)
+    {
+        state.env1.trigger = 0;
+        modulator.noteReleased();
+
+        if (voiceBank != nullptr)
+        {
+            if (allowTailOff)
+                voiceBank->stopVoice(bankLane);
+            else
+                voiceBank->clearVoice(bankLane);
+        }
+    }
+    
+    template <typename SampleType>
+    void renderInto (AudioBuffer<SampleType>& outputBuffer, int startSample, int numSamples)
+    {
+        // a silent voice, or one the bank is rendering, has nothing to add
+        if (voiceBank != nullptr || ! isVoiceActive())
+            return;
+
+        // prepareToPlay() must be called before rendering so the scratch buffers exist
+        jassert(voiceBuffer.getNumSamples() > 0);
+
+        auto& buffer = getVoiceBuffer<SampleType>();
+
+        const bool isModulated = modulator.hasActiveRoutes();
+        auto time = scheduler != nullptr ? scheduler->getRenderTime() : int64(0);
+
+        while (numSamples > 0)
         {
+            playScheduledNotes(time);
+
+            // a voice that's silent until its next note skips ahead to it
+            if (numScheduled > 0 && isSilent())
+            {
+                const auto numToSkip = int(jmin(int64(numSamples), getScheduled(0).time - time));
+
+                startSample += numToSkip;
+                numSamples -= numToSkip;
+                time += numToSkip;
+                continue;
+            }
+
+            // the render only splits where this voice's own notes start or
+            // stop, and while it's releasing, to see if it's finished
+            int blockSize = jmin(numSamples, voiceBuffer.getNumSamples(), isModulated ? modulationInterval : numSamples);
+
+            if (numScheduled > 0)
+                blockSize = int(jmin(int64(blockSize), getScheduled(0).time - time));
+            else if (state.env1.trigger != 1)
+                blockSize = jmin(blockSize, releaseCheckInterval);
+
+            if (blockSize <= 0)
+                return;
+
+            // the pressure gain ramps to its target across the whole render
+            auto endGain = currentGain + (targetGain - currentGain) * float(blockSize) / float(numSamples);
+            auto startGain = currentGain;
+            currentGain = endGain;
+
+            // and the modulation gain to its value at the end of this part;
+            // when the routes have just gone, this runs once more to bring
+            // the pitch, filter and level back to their unmodulated values
+            if (isModulated || wasModulated)
+            {
+                if (isModulated)
+                    modulator.advance(blockSize);
+
+                updateFrequency();
+                updateFilterSettings();
+
+                startGain *= modulationGain;
+                modulationGain = modulator.getValues().gain;
+                endGain *= modulationGain;
+
+                wasModulated = isModulated;
+            }
+
+            if (numUnisonVoices > 1)
+            {
+                // the stack itself is float, so it goes into voiceBuffer and
+                // is filtered into buffer, which is the same one for float
+                auto* left = buffer.getWritePointer(0);
+                auto* right = buffer.getWritePointer(1);
+
+                getUnisonKernelFor<SampleType>()(state, voiceBuffer.getWritePointer(0), voiceBuffer.getWritePointer(1), left, right, blockSize);
+
+                // a mono output gets both halves, at the level a centred
+                // oscillator would have
+                const auto numOutputs = outputBuffer.getNumChannels();
+                const auto scale = SampleType(numOutputs > 1 ? 0.3 : 0.3 * MathConstants<double>::sqrt2 * 0.5);
+                const auto rampStart = scale * SampleType(startGain);
+                const auto rampEnd = scale * SampleType(endGain);
+
+                for (int channel = 0; channel < numOutputs; ++channel)
+                {
+                    if (numOutputs == 1 || channel % 2 == 0)
+                        outputBuffer.addFromWithRamp(channel, startSample, left, blockSize, rampStart, rampEnd);
 
-            for (int channel = 0; channel < outputBuffer.getNumChannels(); ++channel)
+                    if (numOutputs == 1 || channel % 2 == 1)
+                        outputBuffer.addFromWithRamp(channel, startSample, right, blockSize, rampStart, rampEnd);
+                }
+            }
+            else
             {
-                outputBuffer.addSample(channel, startSample, setFilter() * 0.3f);
+                auto* voiceData = buffer.getWritePointer(0);
+
+                getKernelFor<SampleType>()(state, voiceData, blockSize);
+
+                for (int channel = 0; channel < outputBuffer.getNumChannels(); ++channel)
+                    outputBuffer.addFromWithRamp(channel, startSample, voiceData, blockSize,
+                                                 SampleType(0.3) * SampleType(startGain), SampleType(0.3) * SampleType(endGain));
             }
-            ++startSample;
+
+            startSample += blockSize;
+            numSamples -= blockSize;
+            time += blockSize;
+
+            if (numScheduled == 0 && isSilent())
+                break;
         }
+
+        // a note that's due to start hasn't finished, whatever the old one did
+        releaseHasFinished = numScheduled == 0 && isSilent();
     }
 
-private:
+    // Released, and quieter than silenceThreshold.
+    bool isSilent() const noexcept
+    {
+        return state.env1.trigger != 1 && state.env1.amplitude < silenceThreshold;
+    }
+
+    // The kernels for the current waveform / filter pair, in both precisions.
+    void updateKernels()
+    {
+        kernel = getVoiceKernel(theWave, filterSelection);
+        unisonKernel = getUnisonKernel(theWave, filterSelection);
+        doubleKernel = getVoiceKernel<double>(theWave, filterSelection);
+        doubleUnisonKernel = getUnisonKernel<double>(theWave, filterSelection);
+    }
+
+    template <typename SampleType>
+    VoiceKernelFor<SampleType> getKernelFor() const noexcept
+    {
+        if constexpr (std::is_same_v<SampleType, double>)
+            return doubleKernel;
+        else
+            return kernel;
+    }
+
+    template <typename SampleType>
+    UnisonKernelFor<SampleType> getUnisonKernelFor() const noexcept
+    {
+        if constexpr (std::is_same_v<SampleType, double>)
+            return doubleUnisonKernel;
+        else
+            return unisonKernel;
+    }
+
+    template <typename SampleType>
+    AudioBuffer<SampleType>& getVoiceBuffer() noexcept
+    {
+        if constexpr (std::is_same_v<SampleType, double>)
+            return doubleVoiceBuffer;
+        else
+            return voiceBuffer;
+    }
+
+    // The note's pitch with the bend and pitch modulation on top.
+    // Within a note, the oscillators are only retuned when the bend or the
+    // pitch modulation has moved; a new note always sets them.
+    void updateFrequency (bool isNewNote = false)
+    {
+        const auto semitones = expression.pitchBendSemitones + modulator.getValues().pitchSemitones;
+
+        if (! isNewNote && semitones == appliedPitchSemitones)
+            return;
+
+        appliedPitchSemitones = semitones;
+        pitchRatio = std::exp2(double(semitones) / 12.0);
+        state.frequency = baseFrequency * pitchRatio;
+        setOscillatorFrequency(getSampleRate());
+    }
+
+    void setOscillatorFrequency (double sampleRate)
+    {
+        state.osc1.setFrequency(wavetables, state.frequency, sampleRate);
+
+        // getUnison() catches the stack up if it's switched on later
+        if (numUnisonVoices > 1)
+            state.unison.setFrequency(wavetables, state.frequency, sampleRate);
+    }
+
+    // The timbre and cutoff modulation move the cutoff in octaves; the
+    // filter keeps the result within its usable range.
+    void updateFilterSettings()
+    {
+        const auto timbreOctaves = 4.0 * (double(jlimit(0.0f, 1.0f, expression.timbre)) - 0.5);
+        const auto& modulation = modulator.getValues();
+
+        state.cutoff = baseCutoff * std::exp2(timbreOctaves + double(modulation.cutoffOctaves));
+        state.resonance = baseResonance + double(modulation.resonance);
+    }
+
+    // Frees the voice, and forgets any note it was holding for later: a
+    // voice that isn't playing a note doesn't render.
+    void clearNote()
+    {
+        clearCurrentNote();
+        releaseHasFinished = false;
+        numScheduled = 0;
+
+        if (allocator != nullptr)
+            allocator->voiceStopped(allocatorIndex);
+    }
+
+    const Wavetables& wavetables;
+
     double level;
-    double frequency;
-    int theWave;
+    int theWave = VoiceWaveform::Sine;
+    int filterSelection = VoiceFilterType::LowPass;
 
-    int filterSelection;
-    double cutoff;
-    double resonance;
-    
-    maxiOsc osc1;
-    maxiEnv env1;
-    maxiFilter filter1;
+    // The kernels for the current waveform / filter pair, re-picked only when
+    // one of them changes.
+    VoiceKernel kernel = getVoiceKernel(theWave, filterSelection);
+    UnisonKernel unisonKernel = getUnisonKernel(theWave, filterSelection);
+    VoiceKernelFor<double> doubleKernel = getVoiceKernel<double>(theWave, filterSelection);
+    UnisonKernelFor<double> doubleUnisonKernel = getUnisonKernel<double>(theWave, filterSelection);
+    VoiceKernelState state;
+
+    int numUnisonVoices = 1;
+    float unisonDetune = 0.0f;
+    float unisonSpread = 0.0f;
+
+    int midiChannel = 1;
+    double baseFrequency = 440.0;
+    double baseCutoff = 400.0;
+    double baseResonance = 1.0;
+    float appliedPitchSemitones = 0.0f;
+    double pitchRatio = 1.0;
+    NoteExpression expression;
+    float currentGain = 1.0f;
+    float targetGain = 1.0f;
+
+    VoiceModulator modulator;
+    int modulationInterval = 32;
+    float modulationGain = 1.0f;
+    bool wasModulated = false;
+
+    AudioBuffer<float> voiceBuffer;
+    AudioBuffer<double> doubleVoiceBuffer;
+    bool releaseHasFinished = false;
+
+    SynthVoiceBank* voiceBank = nullptr;
+    int bankLane = 0;
+
+    VoiceAllocator* allocator = nullptr;
+    int allocatorIndex = 0;
+
+    const NoteScheduler* scheduler = nullptr;
+    std::array<ScheduledNote, maxScheduledNotes> scheduledNotes;
+    int firstScheduled = 0;
+    int numScheduled = 0;
 
 };
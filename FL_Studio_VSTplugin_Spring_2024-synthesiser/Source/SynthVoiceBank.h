@@ -0,0 +1,396 @@
+/**
+ * @file SynthVoiceBank.h
+ *
+ * @brief Structure-of-arrays voice state that renders every active voice of
+ *        the synth in one lockstep pass.
+ *
+ * @author
+ */
+
+
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "VoiceKernels.h"
+
+
+/**
+    Oscillator phase/increment, envelope level/stage and filter state for up
+    to maxVoices voices, each stored as a contiguous array with one lane per
+    voice.
+
+    Every sample the bank steps all lanes of the occupied lane groups with
+    the same straight-line arithmetic: no branches and no float compares, so
+    the compiler turns the lane loop into SSE/AVX code on x86 and NEON on ARM
+    without needing fast-math flags. Envelope stage changes are applied
+    between sub-blocks of envelopeUpdateInterval samples by a short scalar
+    pass, which rewrites each lane's multiply/add/clamp coefficients.
+
+    The waveform, envelope times and filter settings are shared by all lanes,
+    just as every SynthVoice gets the same parameter values. The oscillator
+    and envelope follow the maxiOsc / maxiEnv maths; the filter is the same
+    StateVariableFilter that SynthVoice uses, with one pair of integrator
+    states per lane and its coefficients worked out only when they change.
+    A note's pitch bend and pressure reach its lane's increment and gain,
+    but its timbre can't move a cutoff that every lane shares, so the bank
+    ignores it.
+*/
+class SynthVoiceBank
+{
+public:
+    static constexpr int maxVoices = 64;
+    static constexpr int laneGroupSize = 8;
+    static constexpr int envelopeUpdateInterval = 32;
+
+    // Released lanes whose level falls below this go idle.
+    static constexpr float silenceThreshold = 1.0e-4f;
+
+    SynthVoiceBank() = default;
+
+    void prepareToPlay (double sampleRate, int samplesPerBlock)
+    {
+        currentSampleRate = sampleRate;
+        filterCoefficients = StateVariableFilter::makeCoefficients(currentSampleRate, filterCutoff, filterResonance);
+        mixBuffer.setSize(1, samplesPerBlock, false, false, true);
+        reset();
+    }
+
+    void reset()
+    {
+        for (int lane = 0; lane < maxVoices; ++lane)
+            clearVoice(lane);
+    }
+
+    void setOscWaveform (float waveform)
+    {
+        theWave = int(waveform);
+    }
+
+    void setEnvelope (float attack, float decay, float sustain, float release)
+    {
+        // Same curves as maxiEnv: a linear attack, then exponential decay and
+        // release that fall to 1% over the given number of milliseconds.
+        attackStep = 1.0f - float(std::pow(0.01, 1.0 / (jmax(0.001, double(attack)) * currentSampleRate * 0.001)));
+        decayCoefficient = float(std::pow(0.01, 1.0 / (jmax(0.001, double(decay)) * currentSampleRate * 0.001)));
+        sustainLevel = sustain;
+        releaseCoefficient = float(std::pow(0.01, 1.0 / (jmax(0.001, double(release)) * currentSampleRate * 0.001)));
+    }
+
+    void setFilter (float filterType, float cutoff, float resonance)
+    {
+        filterSelection = int(filterType);
+
+        // every lane shares the same cutoff, so there's one set of coefficients
+        if (cutoff != filterCutoff || resonance != filterResonance)
+        {
+            filterCutoff = cutoff;
+            filterResonance = resonance;
+            filterCoefficients = StateVariableFilter::makeCoefficients(currentSampleRate, filterCutoff, filterResonance);
+        }
+    }
+
+    void startVoice (int lane, double frequency)
+    {
+        jassert(isPositiveAndBelow(lane, maxVoices));
+
+        phase[lane] = 0.0f;
+        increment[lane] = float(frequency / currentSampleRate);
+        gain[lane] = 1.0f;
+        stage[lane] = Attack;   // like maxiEnv, a retrigger attacks from the current level
+        updateEnvelopeCoefficients(lane);
+
+        numActiveGroups = jmax(numActiveGroups, lane / laneGroupSize + 1);
+    }
+
+    /** Retunes a playing lane and sets how loud it is relative to its
+        envelope; SynthVoice calls this with its note's expression. The gain
+        is applied as a step, once per engine sub-block.
+    */
+    void setVoiceExpression (int lane, double frequency, float newGain)
+    {
+        jassert(isPositiveAndBelow(lane, maxVoices));
+
+        increment[lane] = float(frequency / currentSampleRate);
+        gain[lane] = newGain;
+    }
+
+    void stopVoice (int lane)
+    {
+        jassert(isPositiveAndBelow(lane, maxVoices));
+
+        if (stage[lane] != Idle)
+        {
+            stage[lane] = Release;
+            updateEnvelopeCoefficients(lane);
+        }
+    }
+
+    void clearVoice (int lane)
+    {
+        jassert(isPositiveAndBelow(lane, maxVoices));
+
+        phase[lane] = 0.0f;
+        increment[lane] = 0.0f;
+        gain[lane] = 1.0f;
+        level[lane] = 0.0f;
+        stage[lane] = Idle;
+        filterState1[lane] = 0.0f;
+        filterState2[lane] = 0.0f;
+        updateEnvelopeCoefficients(lane);
+
+        while (numActiveGroups > 0 && isGroupIdle(numActiveGroups - 1))
+            --numActiveGroups;
+    }
+
+    // False once a lane has been cleared or its release has died away.
+    bool isVoicePlaying (int lane) const
+    {
+        jassert(isPositiveAndBelow(lane, maxVoices));
+        return stage[lane] != Idle;
+    }
+
+    // The lanes always run in float; a double output only gets the mix added
+    // to it in double.
+    template <typename SampleType>
+    void renderNextBlock (AudioBuffer<SampleType>& outputBuffer, int startSample, int numSamples)
+    {
+        jassert(mixBuffer.getNumSamples() > 0);
+
+        while (numSamples > 0 && numActiveGroups > 0)
+        {
+            const int blockSize = jmin(numSamples, mixBuffer.getNumSamples());
+
+            if (blockSize <= 0)
+                return;
+
+            auto* mix = mixBuffer.getWritePointer(0);
+
+            for (int offset = 0; offset < blockSize; offset += envelopeUpdateInterval)
+            {
+                advanceEnvelopeStages();
+                renderLanes(mix + offset, jmin(envelopeUpdateInterval, blockSize - offset));
+            }
+
+            for (int channel = 0; channel < outputBuffer.getNumChannels(); ++channel)
+            {
+                auto* output = outputBuffer.getWritePointer(channel, startSample);
+
+                if constexpr (std::is_same_v<SampleType, float>)
+                    FloatVectorOperations::addWithMultiply(output, mix, 0.3f, blockSize);
+                else
+                    for (int i = 0; i < blockSize; ++i)
+                        output[i] += 0.3 * double(mix[i]);
+            }
+
+            startSample += blockSize;
+            numSamples -= blockSize;
+        }
+    }
+
+private:
+    enum Stage
+    {
+        Idle,
+        Attack,
+        Decay,
+        Release
+    };
+
+    // Each sample a lane's envelope does level = clamp(level * mul + add, floor, ceiling),
+    // which covers every stage: attack adds a step up to 1, decay multiplies
+    // down to the sustain floor (and then holds there), release multiplies
+    // towards 0 and idle lanes are pinned at 0.
+    void updateEnvelopeCoefficients (int lane)
+    {
+        switch (stage[lane])
+        {
+            case Attack:
+                envelopeMul[lane] = 1.0f;
+                envelopeAdd[lane] = attackStep;
+                envelopeFloor[lane] = 0.0f;
+                envelopeCeiling[lane] = 1.0f;
+                break;
+            case Decay:
+                envelopeMul[lane] = decayCoefficient;
+                envelopeAdd[lane] = 0.0f;
+                envelopeFloor[lane] = sustainLevel;
+                envelopeCeiling[lane] = 1.0f;
+                break;
+            case Release:
+                envelopeMul[lane] = releaseCoefficient;
+                envelopeAdd[lane] = 0.0f;
+                envelopeFloor[lane] = 0.0f;
+                envelopeCeiling[lane] = 1.0f;
+                break;
+            default:
+                envelopeMul[lane] = 0.0f;
+                envelopeAdd[lane] = 0.0f;
+                envelopeFloor[lane] = 0.0f;
+                envelopeCeiling[lane] = 0.0f;
+                break;
+        }
+    }
+
+    // Moves finished attacks on to their decay, idles lanes whose release
+    // has gone silent, and picks up any envelope parameter changes made
+    // since the last sub-block.
+    void advanceEnvelopeStages()
+    {
+        const int numLanes = numActiveGroups * laneGroupSize;
+
+        for (int lane = 0; lane < numLanes; ++lane)
+        {
+            if (stage[lane] == Attack && level[lane] >= 1.0f)
+                stage[lane] = Decay;
+
+            if (stage[lane] == Release && level[lane] < silenceThreshold)
+                clearVoice(lane);
+            else
+                updateEnvelopeCoefficients(lane);
+        }
+    }
+
+    bool isGroupIdle (int group) const
+    {
+        for (int lane = group * laneGroupSize; lane < (group + 1) * laneGroupSize; ++lane)
+            if (stage[lane] != Idle)
+                return false;
+
+        return true;
+    }
+
+    // Branch-free min / max. std::min on floats is a compare-and-select, which
+    // GCC won't vectorise without -fno-trapping-math.
+    static float minOf (float a, float b)    { return 0.5f * (a + b - std::abs(a - b)); }
+    static float maxOf (float a, float b)    { return 0.5f * (a + b + std::abs(a - b)); }
+
+    // Parabolic sine approximation (error below 0.1%), written without
+    // branches or library calls so it stays inside the vectorised loop.
+    static float sineFromPhase (float p)
+    {
+        const auto t = 1.0f - 2.0f * p;     // sin(2 pi p) == sin(pi t) for p in [0, 1)
+        const auto y = 4.0f * t * (1.0f - std::abs(t));
+        return 0.225f * (y * std::abs(y) - y) + y;
+    }
+
+    template <int Waveform, int FilterType>
+    static void renderLaneGroups (SynthVoiceBank& bank, float* mix, int numSamples)
+    {
+        const int numLanes = bank.numActiveGroups * laneGroupSize;
+
+        const auto a1 = bank.filterCoefficients.a1;
+        const auto a2 = bank.filterCoefficients.a2;
+        const auto a3 = bank.filterCoefficients.a3;
+        const auto k = bank.filterCoefficients.k;
+
+        auto& phase = bank.phase;
+        auto& increment = bank.increment;
+        auto& level = bank.level;
+        auto& envelopeMul = bank.envelopeMul;
+        auto& envelopeAdd = bank.envelopeAdd;
+        auto& envelopeFloor = bank.envelopeFloor;
+        auto& envelopeCeiling = bank.envelopeCeiling;
+        auto& filterState1 = bank.filterState1;
+        auto& filterState2 = bank.filterState2;
+        auto& gain = bank.gain;
+        auto& laneOutput = bank.laneOutput;
+
+        for (int sample = 0; sample < numSamples; ++sample)
+        {
+            for (int lane = 0; lane < numLanes; ++lane)
+            {
+                const auto p = phase[lane];
+
+                float osc;
+
+                if constexpr (Waveform == VoiceWaveform::Saw)
+                    osc = 2.0f * p - 1.0f;
+                else if constexpr (Waveform == VoiceWaveform::Square)
+                    osc = float(int(p * 2.0f)) * 2.0f - 1.0f;
+                else
+                    osc = sineFromPhase(p);
+
+                // phase stays in [0, 1), so truncation is the same as floor
+                const auto nextPhase = p + increment[lane];
+                phase[lane] = nextPhase - float(int(nextPhase));
+
+                const auto newLevel = minOf(maxOf(level[lane] * envelopeMul[lane] + envelopeAdd[lane], envelopeFloor[lane]), envelopeCeiling[lane]);
+                level[lane] = newLevel;
+
+                const auto input = osc * newLevel * gain[lane];
+                // StateVariableFilter::processSample, one lane at a time
+                const auto ic1 = filterState1[lane];
+                const auto ic2 = filterState2[lane];
+                const auto v3 = input - ic2;
+                const auto v1 = a1 * ic1 + a2 * v3;
+                const auto v2 = ic2 + a2 * ic1 + a3 * v3;
+                filterState1[lane] = 2.0f * v1 - ic1;
+                filterState2[lane] = 2.0f * v2 - ic2;
+
+                if constexpr (FilterType == VoiceFilterType::HighPass)
+                    laneOutput[lane] = input - k * v1 - v2;
+                else if constexpr (FilterType == VoiceFilterType::BandPass)
+                    laneOutput[lane] = k * v1;
+                else
+                    laneOutput[lane] = v2;
+            }
+
+            float sum = 0.0f;
+
+            for (int lane = 0; lane < numLanes; ++lane)
+                sum += laneOutput[lane];
+
+            mix[sample] = sum;
+        }
+    }
+
+    using LaneRenderer = void (*)(SynthVoiceBank&, float*, int);
+
+    template <int... Indices>
+    static constexpr std::array<LaneRenderer, sizeof...(Indices)> makeLaneRenderers (std::integer_sequence<int, Indices...>)
+    {
+        return { &renderLaneGroups<Indices / VoiceFilterType::NumFilterTypes, Indices % VoiceFilterType::NumFilterTypes>... };
+    }
+
+    void renderLanes (float* mix, int numSamples)
+    {
+        const int wave = isPositiveAndBelow(theWave, int(VoiceWaveform::NumWaveforms)) ? theWave : int(VoiceWaveform::Sine);
+        const int filterType = isPositiveAndBelow(filterSelection, int(VoiceFilterType::NumFilterTypes)) ? filterSelection : int(VoiceFilterType::LowPass);
+
+        static constexpr auto laneRenderers = makeLaneRenderers(std::make_integer_sequence<int, VoiceWaveform::NumWaveforms * VoiceFilterType::NumFilterTypes>());
+
+        laneRenderers[size_t(wave * VoiceFilterType::NumFilterTypes + filterType)](*this, mix, numSamples);
+    }
+
+    double currentSampleRate = 44100.0;
+    int numActiveGroups = 0;
+
+    int theWave = VoiceWaveform::Sine;
+    int filterSelection = VoiceFilterType::LowPass;
+
+    float attackStep = 1.0f;
+    float decayCoefficient = 0.0f;
+    float sustainLevel = 0.8f;
+    float releaseCoefficient = 0.0f;
+    float filterCutoff = 400.0f;
+    float filterResonance = 1.0f;
+    StateVariableFilter::Coefficients filterCoefficients = StateVariableFilter::makeCoefficients(currentSampleRate, filterCutoff, filterResonance);
+
+    alignas(32) float phase[maxVoices] {};
+    alignas(32) float increment[maxVoices] {};
+    alignas(32) float level[maxVoices] {};
+    alignas(32) float gain[maxVoices] {};
+    alignas(32) float envelopeMul[maxVoices] {};
+    alignas(32) float envelopeAdd[maxVoices] {};
+    alignas(32) float envelopeFloor[maxVoices] {};
+    alignas(32) float envelopeCeiling[maxVoices] {};
+    alignas(32) float filterState1[maxVoices] {};
+    alignas(32) float filterState2[maxVoices] {};
+    alignas(32) float laneOutput[maxVoices] {};
+
+    int stage[maxVoices] {};
+
+    AudioBuffer<float> mixBuffer;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (SynthVoiceBank)
+};
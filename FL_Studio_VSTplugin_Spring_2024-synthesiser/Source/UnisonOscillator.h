@@ -0,0 +1,161 @@
+/**
+ * @file UnisonOscillator.h
+ *
+ * @brief Up to 16 detuned copies of a wavetable oscillator spread across the
+ *        stereo field, stepped together one lane per copy.
+ *
+ * @author
+ */
+
+
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "Wavetables.h"
+
+
+/**
+    The oscillators of a unison stack (a "supersaw" when the waveform is a
+    saw) stored as arrays with one lane each, like SynthVoiceBank's voices.
+    Every sample steps all the lanes with the same branch-free arithmetic, so
+    the compiler vectorises the lane loop, and a stack of seven costs a few
+    table reads more than one oscillator rather than seven times the
+    per-voice overhead.
+
+    The copies are detuned evenly across +/- the detune amount and panned
+    evenly across +/- the spread, with equal-power gains scaled so the stack
+    is about as loud as a single oscillator. They all read the same octave's
+    table, the one band-limited for the sharpest copy.
+*/
+class UnisonOscillator
+{
+public:
+    static constexpr int maxVoices = 16;
+    static constexpr int laneGroupSize = 8;
+
+    /** Sets how many copies play, their total detune either side of the note
+        in cents and their stereo width from 0 (all centred) to 1 (outermost
+        ones hard left and right). Takes effect on the next setFrequency().
+    */
+    void setVoices (int newNumVoices, float newDetuneCents, float newSpread)
+    {
+        numVoices = jlimit(1, maxVoices, newNumVoices);
+        numLanes = (numVoices + laneGroupSize - 1) / laneGroupSize * laneGroupSize;
+        detuneCents = newDetuneCents;
+
+        const auto width = jlimit(0.0f, 1.0f, newSpread);
+        const auto loudness = 1.0f / std::sqrt(float(numVoices));
+
+        for (int lane = 0; lane < maxVoices; ++lane)
+        {
+            // idle lanes keep running but add nothing
+            if (lane >= numVoices)
+            {
+                gainLeft[lane] = gainRight[lane] = 0.0f;
+                continue;
+            }
+
+            const auto pan = width * getLaneOffset(lane);     // -1 (left) to 1 (right)
+            const auto angle = MathConstants<float>::pi * 0.25f * (pan + 1.0f);
+            gainLeft[lane] = loudness * std::cos(angle);
+            gainRight[lane] = loudness * std::sin(angle);
+        }
+    }
+
+    int getNumVoices() const noexcept    { return numVoices; }
+
+    void setFrequency (const Wavetables& wavetables, double frequency, double sampleRate)
+    {
+        const auto sharpest = frequency * std::exp2(double(detuneCents) / 1200.0);
+        const int octave = Wavetables::getOctaveForFrequency(sharpest);
+
+        for (int waveform = 0; waveform < Wavetables::NumWaveforms; ++waveform)
+            tables[waveform] = wavetables.getTable(waveform, octave);
+
+        for (int lane = 0; lane < maxVoices; ++lane)
+        {
+            const auto laneFrequency = frequency * std::exp2(double(detuneCents * getLaneOffset(lane)) / 1200.0);
+            increment[lane] = sampleRate > 0.0 && lane < numVoices ? float(laneFrequency * Wavetables::tableSize / sampleRate) : 0.0f;
+        }
+    }
+
+    // Starts the copies at fixed, unrelated phases, so a new note doesn't
+    // begin with them all in line and the same note sounds the same each time.
+    void resetPhases()
+    {
+        for (int lane = 0; lane < maxVoices; ++lane)
+        {
+            const auto fraction = lane * 0.6180339887;
+            position[lane] = float((fraction - std::floor(fraction)) * Wavetables::tableSize);
+        }
+    }
+
+    // Writes (not adds) numSamples of the stack to left and right.
+    void render (int waveform, float* left, float* right, int numSamples)
+    {
+        const auto* table = tables[waveform];
+        const auto lanes = numLanes;
+
+        // Worked on as locals, so the compiler can see that the table reads
+        // don't alias them and vectorise across the lanes.
+        alignas(32) float lanePosition[maxVoices], laneIncrement[maxVoices], laneGainLeft[maxVoices], laneGainRight[maxVoices];
+        alignas(32) float laneLeft[maxVoices], laneRight[maxVoices];
+
+        std::copy(std::begin(position), std::end(position), lanePosition);
+        std::copy(std::begin(increment), std::end(increment), laneIncrement);
+        std::copy(std::begin(gainLeft), std::end(gainLeft), laneGainLeft);
+        std::copy(std::begin(gainRight), std::end(gainRight), laneGainRight);
+
+        for (int sample = 0; sample < numSamples; ++sample)
+        {
+            for (int lane = 0; lane < lanes; ++lane)
+            {
+                const auto p = lanePosition[lane];
+                const auto index = int(p);
+                const auto fraction = p - float(index);
+                const auto value = table[index] + fraction * (table[index + 1] - table[index]);
+
+                // increments are below a table's length, so one subtraction
+                // wraps, and it's done by multiplying to keep the loop branch-free
+                const auto next = p + laneIncrement[lane];
+                lanePosition[lane] = next - float(int(next * inverseTableSize)) * float(Wavetables::tableSize);
+
+                laneLeft[lane] = value * laneGainLeft[lane];
+                laneRight[lane] = value * laneGainRight[lane];
+            }
+
+            float sumLeft = 0.0f, sumRight = 0.0f;
+
+            for (int lane = 0; lane < lanes; ++lane)
+            {
+                sumLeft += laneLeft[lane];
+                sumRight += laneRight[lane];
+            }
+
+            left[sample] = sumLeft;
+            right[sample] = sumRight;
+        }
+
+        std::copy(std::begin(lanePosition), std::end(lanePosition), position);
+    }
+
+private:
+    static constexpr float inverseTableSize = 1.0f / float(Wavetables::tableSize);
+
+    // Where a lane sits in the stack, from -1 to 1.
+    float getLaneOffset (int lane) const noexcept
+    {
+        return numVoices > 1 ? 2.0f * float(lane) / float(numVoices - 1) - 1.0f : 0.0f;
+    }
+
+    const float* tables[Wavetables::NumWaveforms] {};
+
+    int numVoices = 1;
+    int numLanes = laneGroupSize;
+    float detuneCents = 0.0f;
+
+    alignas(32) float position[maxVoices] {};
+    alignas(32) float increment[maxVoices] {};
+    alignas(32) float gainLeft[maxVoices] {};
+    alignas(32) float gainRight[maxVoices] {};
+};
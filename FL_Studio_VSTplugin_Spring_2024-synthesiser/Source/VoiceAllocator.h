@@ -0,0 +1,175 @@
+/**
+ * @file VoiceAllocator.h
+ *
+ * @brief Constant-time bookkeeping of which of the synth's voices are free,
+ *        which are playing, and in what order they were started.
+ *
+ * @author
+ */
+
+
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+
+
+/**
+    Keeps every voice, by index, on one of two intrusive doubly-linked lists:
+    a free queue (voices go on at the back when they finish, so the one that
+    has been silent longest is reused first) and a busy list in the order the
+    notes started (so the oldest note is always at the front). A table from
+    MIDI channel and note to the voice last started on it finds a note that is
+    already sounding without a scan.
+
+    All of this is pre-sized by setNumVoices(), so nothing allocates on the
+    audio thread and every operation except quietest-voice stealing is O(1).
+*/
+class VoiceAllocator
+{
+public:
+    enum StealingPolicy
+    {
+        StealOldest,
+        StealQuietest
+    };
+
+    static constexpr int noVoice = -1;
+
+    VoiceAllocator()
+    {
+        setNumVoices(0);
+    }
+
+    void setNumVoices (int numVoices)
+    {
+        numVoicesAllocated = numVoices;
+
+        voiceNodes.assign((size_t) numVoices, {});
+        std::fill(std::begin(voiceForNote), std::end(voiceForNote), noVoice);
+
+        freeVoices = {};
+        busyVoices = {};
+
+        for (int i = 0; i < numVoices; ++i)
+            pushBack(freeVoices, i);
+    }
+
+    int getNumVoices() const noexcept    { return numVoicesAllocated; }
+
+    // The voice that has been free the longest, or noVoice if they're all busy.
+    int getFreeVoice() const noexcept            { return freeVoices.first; }
+
+    // The voice whose note started earliest, or noVoice if none are busy.
+    int getOldestBusyVoice() const noexcept      { return busyVoices.first; }
+    int getNextBusyVoice (int voice) const noexcept    { return voiceNodes[(size_t) voice].next; }
+
+    // The most recently started voice still sounding this note, or noVoice.
+    int getVoicePlayingNote (int midiChannel, int midiNoteNumber) const noexcept
+    {
+        return voiceForNote[getNoteSlot(midiChannel, midiNoteNumber)];
+    }
+
+    // Moves a voice to the back of the busy list as the newest note.
+    void voiceStarted (int voice, int midiChannel, int midiNoteNumber) noexcept
+    {
+        jassert(isPositiveAndBelow(voice, numVoicesAllocated));
+
+        auto& node = voiceNodes[(size_t) voice];
+
+        unlink(node.isBusy ? busyVoices : freeVoices, voice);
+        forgetNote(voice);
+
+        node.isBusy = true;
+        node.noteSlot = getNoteSlot(midiChannel, midiNoteNumber);
+        voiceForNote[node.noteSlot] = voice;
+
+        pushBack(busyVoices, voice);
+    }
+
+    // Returns a voice to the back of the free queue.
+    void voiceStopped (int voice) noexcept
+    {
+        jassert(isPositiveAndBelow(voice, numVoicesAllocated));
+
+        auto& node = voiceNodes[(size_t) voice];
+
+        if (! node.isBusy)
+            return;
+
+        unlink(busyVoices, voice);
+        forgetNote(voice);
+
+        node.isBusy = false;
+        pushBack(freeVoices, voice);
+    }
+
+private:
+    struct VoiceNode
+    {
+        int previous = noVoice;
+        int next = noVoice;
+        int noteSlot = -1;
+        bool isBusy = false;
+    };
+
+    struct VoiceList
+    {
+        int first = noVoice;
+        int last = noVoice;
+    };
+
+    static constexpr int numNoteSlots = 16 * 128;
+
+    static size_t getNoteSlot (int midiChannel, int midiNoteNumber) noexcept
+    {
+        return (size_t) (jlimit(0, 15, midiChannel - 1) * 128 + jlimit(0, 127, midiNoteNumber));
+    }
+
+    void forgetNote (int voice) noexcept
+    {
+        auto& node = voiceNodes[(size_t) voice];
+
+        if (node.noteSlot >= 0 && voiceForNote[node.noteSlot] == voice)
+            voiceForNote[node.noteSlot] = noVoice;
+
+        node.noteSlot = -1;
+    }
+
+    void pushBack (VoiceList& list, int voice) noexcept
+    {
+        auto& node = voiceNodes[(size_t) voice];
+        node.previous = list.last;
+        node.next = noVoice;
+
+        if (list.last != noVoice)
+            voiceNodes[(size_t) list.last].next = voice;
+        else
+            list.first = voice;
+
+        list.last = voice;
+    }
+
+    void unlink (VoiceList& list, int voice) noexcept
+    {
+        auto& node = voiceNodes[(size_t) voice];
+
+        if (node.previous != noVoice)
+            voiceNodes[(size_t) node.previous].next = node.next;
+        else
+            list.first = node.next;
+
+        if (node.next != noVoice)
+            voiceNodes[(size_t) node.next].previous = node.previous;
+        else
+            list.last = node.previous;
+
+        node.previous = node.next = noVoice;
+    }
+
+    int numVoicesAllocated = 0;
+    std::vector<VoiceNode> voiceNodes;
+    VoiceList freeVoices, busyVoices;
+    int voiceForNote[numNoteSlots] {};
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (VoiceAllocator)
+};
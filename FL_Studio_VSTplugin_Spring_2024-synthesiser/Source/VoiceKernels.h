@@ -0,0 +1,196 @@
+/**
+ * @file VoiceKernels.h
+ *
+ * @brief Render kernels for SynthVoice, specialised at compile time for every
+ *        waveform / filter type combination.
+ *
+ * @author
+ */
+
+
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "maximilian.h"
+#include "Wavetables.h"
+#include "StateVariableFilter.h"
+#include "UnisonOscillator.h"
+#include <array>
+
+
+// Values of the WAVEFORM and FILTER_TYPE parameters.
+enum VoiceWaveform
+{
+    Sine,
+    Saw,
+    Square,
+    NumWaveforms
+};
+
+enum VoiceFilterType
+{
+    LowPass,
+    HighPass,
+    BandPass,
+    NumFilterTypes
+};
+
+static_assert(int(VoiceWaveform::NumWaveforms) == int(Wavetables::NumWaveforms), "VoiceWaveform and Wavetables::Waveform must match");
+static_assert(int(VoiceFilterType::NumFilterTypes) == int(StateVariableFilter::NumModes), "VoiceFilterType and StateVariableFilter::Mode must match");
+
+// Everything a kernel reads or advances while rendering one voice.
+struct VoiceKernelState
+{
+    double frequency = 440.0;
+    double cutoff = 400.0;
+    double resonance = 1.0;
+
+    WavetableOscillator osc1;
+    maxiEnv env1;
+    StateVariableFilter filter1;
+
+    // unison renders in stereo, with filter2 on the right channel
+    UnisonOscillator unison;
+    StateVariableFilter filter2;
+};
+
+template <int Waveform>
+inline double renderOscillatorSample(WavetableOscillator& osc)
+{
+    return osc.getNextSample(Waveform);
+}
+
+// Fills data with numSamples of the voice's output. The oscillator, envelope
+// and filter run back to back on each sample, and the loop has no branch on
+// the voice's settings: those are baked into the instantiation. The DSP
+// objects are worked on as locals and stored back once, so their state can
+// stay in registers instead of being reloaded through the voice every sample.
+// With double output the envelope's result goes through the filter without
+// being rounded to float.
+template <int Waveform, int FilterType, typename SampleType>
+void renderVoiceKernel(VoiceKernelState& state, SampleType* data, int numSamples)
+{
+    // only recomputes the coefficients if the cutoff or resonance moved
+    state.filter1.setCutoffAndResonance(float(state.cutoff), float(state.resonance));
+
+    auto osc = state.osc1;
+    auto env = state.env1;
+    auto filter = state.filter1;
+
+    const auto trigger = env.trigger;
+
+    for (int i = 0; i < numSamples; ++i)
+    {
+        const auto oscSample = renderOscillatorSample<Waveform>(osc);
+        const auto envSample = env.adsr(oscSample, trigger);
+
+        data[i] = filter.processSample<FilterType>(SampleType(envSample));
+    }
+
+    state.osc1 = osc;
+    state.env1 = env;
+    state.filter1 = filter;
+}
+
+// The unison form of renderVoiceKernel: the whole stack is rendered into
+// stackLeft and stackRight first (always float, see UnisonOscillator), then
+// the envelope and a filter per channel run over both into left and right.
+// For float output the two pairs can be the same buffers.
+template <int Waveform, int FilterType, typename SampleType>
+void renderUnisonKernel(VoiceKernelState& state, float* stackLeft, float* stackRight,
+                        SampleType* left, SampleType* right, int numSamples)
+{
+    state.filter1.setCutoffAndResonance(float(state.cutoff), float(state.resonance));
+    state.filter2.setCutoffAndResonance(float(state.cutoff), float(state.resonance));
+
+    state.unison.render(Waveform, stackLeft, stackRight, numSamples);
+
+    auto env = state.env1;
+    auto filterLeft = state.filter1;
+    auto filterRight = state.filter2;
+
+    const auto trigger = env.trigger;
+
+    for (int i = 0; i < numSamples; ++i)
+    {
+        const auto gain = SampleType(env.adsr(1.0, trigger));
+
+        left[i] = filterLeft.processSample<FilterType>(SampleType(stackLeft[i]) * gain);
+        right[i] = filterRight.processSample<FilterType>(SampleType(stackRight[i]) * gain);
+    }
+
+    state.env1 = env;
+    state.filter1 = filterLeft;
+    state.filter2 = filterRight;
+}
+
+template <typename SampleType>
+using VoiceKernelFor = void (*)(VoiceKernelState&, SampleType*, int);
+
+template <typename SampleType>
+using UnisonKernelFor = void (*)(VoiceKernelState&, float*, float*, SampleType*, SampleType*, int);
+
+using VoiceKernel = VoiceKernelFor<float>;
+using UnisonKernel = UnisonKernelFor<float>;
+
+namespace VoiceKernelTable
+{
+    constexpr int numKernels = VoiceWaveform::NumWaveforms * VoiceFilterType::NumFilterTypes;
+
+    template <typename SampleType, int Index>
+    constexpr VoiceKernelFor<SampleType> makeEntry()
+    {
+        return &renderVoiceKernel<Index / VoiceFilterType::NumFilterTypes, Index % VoiceFilterType::NumFilterTypes, SampleType>;
+    }
+
+    template <typename SampleType, int Index>
+    constexpr UnisonKernelFor<SampleType> makeUnisonEntry()
+    {
+        return &renderUnisonKernel<Index / VoiceFilterType::NumFilterTypes, Index % VoiceFilterType::NumFilterTypes, SampleType>;
+    }
+
+    template <typename SampleType, int... Indices>
+    constexpr std::array<VoiceKernelFor<SampleType>, sizeof...(Indices)> makeTable(std::integer_sequence<int, Indices...>)
+    {
+        return { makeEntry<SampleType, Indices>()... };
+    }
+
+    template <typename SampleType, int... Indices>
+    constexpr std::array<UnisonKernelFor<SampleType>, sizeof...(Indices)> makeUnisonTable(std::integer_sequence<int, Indices...>)
+    {
+        return { makeUnisonEntry<SampleType, Indices>()... };
+    }
+
+    // One kernel per (waveform, filter type), indexed waveform-major, for
+    // each output precision.
+    template <typename SampleType>
+    inline constexpr auto kernels = makeTable<SampleType>(std::make_integer_sequence<int, numKernels>());
+
+    template <typename SampleType>
+    inline constexpr auto unisonKernels = makeUnisonTable<SampleType>(std::make_integer_sequence<int, numKernels>());
+
+    inline size_t getIndex(int waveform, int filterType)
+    {
+        if (! isPositiveAndBelow(waveform, int(VoiceWaveform::NumWaveforms)))
+            waveform = VoiceWaveform::Sine;
+
+        if (! isPositiveAndBelow(filterType, int(VoiceFilterType::NumFilterTypes)))
+            filterType = VoiceFilterType::LowPass;
+
+        return size_t(waveform * VoiceFilterType::NumFilterTypes + filterType);
+    }
+}
+
+// Out of range parameter values fall back to Sine / LowPass, like the old
+// switch statements' default cases did.
+template <typename SampleType = float>
+inline VoiceKernelFor<SampleType> getVoiceKernel(int waveform, int filterType)
+{
+    return VoiceKernelTable::kernels<SampleType>[VoiceKernelTable::getIndex(waveform, filterType)];
+}
+
+template <typename SampleType = float>
+inline UnisonKernelFor<SampleType> getUnisonKernel(int waveform, int filterType)
+{
+    return VoiceKernelTable::unisonKernels<SampleType>[VoiceKernelTable::getIndex(waveform, filterType)];
+}
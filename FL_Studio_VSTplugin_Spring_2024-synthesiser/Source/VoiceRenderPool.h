@@ -0,0 +1,236 @@
+/**
+ * @file VoiceRenderPool.h
+ *
+ * @brief Pre-spawned realtime worker threads that render a block's voices in
+ *        parallel.
+ *
+ * @author
+ */
+
+
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+
+
+/**
+    Splits a block's voices between the calling (audio) thread and a fixed set
+    of worker threads started when the pool is created.
+
+    Each worker renders into its own buffer, so no two threads ever write to
+    the same samples; the calling thread sums the workers' buffers into the
+    output once they're done. Handing out a block and waiting for it are
+    both done with atomics: the audio thread never takes a lock, and only
+    signals a worker's event when that worker has gone to sleep after a long
+    idle spell.
+
+    A worker has to join a block before it takes any voices, and the calling
+    thread closes the block to newcomers once it has run out of voices to
+    take itself. It then waits only for the workers that joined, so one
+    that's asleep or descheduled never holds up the block: every voice it
+    would have rendered has already been rendered by someone else.
+
+    Waking the workers has a fixed cost per block, so SynthEngine only uses
+    the pool once at least getActiveVoiceThreshold() voices are playing.
+*/
+class VoiceRenderPool
+{
+public:
+    static constexpr int defaultActiveVoiceThreshold = 16;
+
+    explicit VoiceRenderPool (int numWorkerThreads = jmax(0, SystemStats::getNumCpus() - 1),
+                              int activeVoiceThreshold = defaultActiveVoiceThreshold)
+        : threshold(activeVoiceThreshold)
+    {
+        for (int i = 0; i < numWorkerThreads; ++i)
+        {
+            auto* worker = workers.add(new Worker(*this, i));
+            worker->startRealtimeThread(Thread::RealtimeOptions().withPriority(8));
+        }
+    }
+
+    ~VoiceRenderPool()
+    {
+        for (auto* worker : workers)
+        {
+            worker->signalThreadShouldExit();
+            worker->wakeUp.signal();
+        }
+
+        for (auto* worker : workers)
+            worker->stopThread(1000);
+    }
+
+    int getNumWorkerThreads() const noexcept                { return workers.size(); }
+
+    int getActiveVoiceThreshold() const noexcept            { return threshold.load(); }
+    void setActiveVoiceThreshold (int newThreshold) noexcept { threshold = jmax(1, newThreshold); }
+
+    bool shouldRender (int numActiveVoices) const noexcept
+    {
+        return ! workers.isEmpty() && numActiveVoices >= threshold.load();
+    }
+
+    // Must be called before rendering, off the audio thread.
+    void prepareToPlay (int numChannels, int samplesPerBlock)
+    {
+        for (auto* worker : workers)
+            worker->buffer.setSize(numChannels, samplesPerBlock, false, false, true);
+    }
+
+    /** Adds numVoices voices into outputAudio, rendering them on the calling
+        thread and the workers. numSamples may not be more than the block size
+        given to prepareToPlay().
+    */
+    void renderVoices (SynthesiserVoice* const* voices, int numVoices,
+                       AudioBuffer<float>& outputAudio, int startSample, int numSamples)
+    {
+        jassert(workers.isEmpty() || (workers.getFirst()->buffer.getNumSamples() >= numSamples
+                                      && workers.getFirst()->buffer.getNumChannels() >= outputAudio.getNumChannels()));
+
+        jobVoices = voices;
+        jobNumVoices = numVoices;
+        jobNumChannels = outputAudio.getNumChannels();
+        jobNumSamples = numSamples;
+        nextVoice.store(0);
+        numWorkersFinished.store(0);
+
+        // only the workers that join this job will write these again
+        for (auto* worker : workers)
+            worker->renderedAnything = false;
+
+        // publishes the job to the workers, open for them to join
+        const auto generation = getGeneration(jobState.load()) + 1;
+        jobState.store(uint64(generation) << 32, std::memory_order_release);
+
+        for (auto* worker : workers)
+            if (worker->isSleeping.load())
+                worker->wakeUp.signal();
+
+        for (int i = nextVoice.fetch_add(1); i < numVoices; i = nextVoice.fetch_add(1))
+            voices[i]->renderNextBlock(outputAudio, startSample, numSamples);
+
+        // every voice has been taken, so a worker that hasn't joined by now
+        // would find nothing left to do
+        const auto numJoined = int(jobState.fetch_or(closedFlag, std::memory_order_acq_rel) & joinCountMask);
+
+        for (int spins = 0; numWorkersFinished.load(std::memory_order_acquire) < numJoined; ++spins)
+            if (spins > spinsBeforeYield)
+                Thread::yield();
+
+        for (auto* worker : workers)
+            if (worker->renderedAnything)
+                for (int channel = 0; channel < jobNumChannels; ++channel)
+                    outputAudio.addFrom(channel, startSample, worker->buffer, channel, 0, numSamples);
+    }
+
+private:
+    static constexpr int spinsBeforeYield = 2000;
+    static constexpr int spinsBeforeSleep = 20000;
+
+    // jobState holds the job's generation in its top 32 bits, and below that
+    // whether it's closed and how many workers have joined it.
+    static constexpr uint64 closedFlag = uint64(1) << 31;
+    static constexpr uint64 joinCountMask = closedFlag - 1;
+
+    static uint32 getGeneration (uint64 state) noexcept    { return uint32(state >> 32); }
+
+    class Worker : public Thread
+    {
+    public:
+        Worker (VoiceRenderPool& p, int index)
+            : Thread("Voice render worker " + String(index + 1)), pool(p), startGeneration(getGeneration(p.jobState.load()))
+        {
+        }
+
+        void run() override
+        {
+            // Starts from the generation the pool had when this worker was
+            // made, so a job published before the thread got going isn't missed.
+            auto lastGeneration = startGeneration;
+            int spins = 0;
+
+            while (! threadShouldExit())
+            {
+                auto state = pool.jobState.load(std::memory_order_acquire);
+                const auto currentGeneration = getGeneration(state);
+
+                if (currentGeneration == lastGeneration)
+                {
+                    if (++spins < spinsBeforeYield)
+                        continue;
+
+                    if (spins < spinsBeforeSleep)
+                    {
+                        Thread::yield();
+                        continue;
+                    }
+
+                    // Re-check after flagging that we're asleep, so a job
+                    // published in between still gets its wake-up signal.
+                    isSleeping.store(true);
+
+                    if (getGeneration(pool.jobState.load()) == lastGeneration)
+                        wakeUp.wait(100.0);
+
+                    isSleeping.store(false);
+                    spins = 0;
+                    continue;
+                }
+
+                lastGeneration = currentGeneration;
+                spins = 0;
+
+                if (! join(state, currentGeneration))
+                    continue;
+
+                for (int i = pool.nextVoice.fetch_add(1); i < pool.jobNumVoices; i = pool.nextVoice.fetch_add(1))
+                {
+                    if (! renderedAnything)
+                    {
+                        buffer.clear(0, pool.jobNumSamples);
+                        renderedAnything = true;
+                    }
+
+                    pool.jobVoices[i]->renderNextBlock(buffer, 0, pool.jobNumSamples);
+                }
+
+                pool.numWorkersFinished.fetch_add(1, std::memory_order_release);
+            }
+        }
+
+        // Counts this worker into the job, unless the audio thread has
+        // already closed it or moved on to the next one.
+        bool join (uint64 state, uint32 jobGeneration)
+        {
+            while (getGeneration(state) == jobGeneration && (state & closedFlag) == 0)
+                if (pool.jobState.compare_exchange_weak(state, state + 1, std::memory_order_acq_rel))
+                    return true;
+
+            return false;
+        }
+
+        VoiceRenderPool& pool;
+        const uint32 startGeneration;
+        AudioBuffer<float> buffer;
+        bool renderedAnything = false;
+        std::atomic<bool> isSleeping { false };
+        WaitableEvent wakeUp;
+    };
+
+    OwnedArray<Worker> workers;
+    std::atomic<int> threshold;
+
+    // The current job. These are written before jobState is published and
+    // only read by workers after they've joined it.
+    SynthesiserVoice* const* jobVoices = nullptr;
+    int jobNumVoices = 0;
+    int jobNumChannels = 0;
+    int jobNumSamples = 0;
+
+    std::atomic<uint64> jobState { 0 };
+    std::atomic<int> nextVoice { 0 };
+    std::atomic<int> numWorkersFinished { 0 };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (VoiceRenderPool)
+};
@@ -0,0 +1,172 @@
+/**
+ * @file Wavetables.h
+ *
+ * @brief Band-limited, mip-mapped wavetables for the synth's waveforms and
+ *        the oscillator that plays them.
+ *
+ * @author
+ */
+
+
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+
+
+/**
+    One table per octave for every waveform, built by adding up only the
+    harmonics that stay below Nyquist for the highest note the octave covers.
+
+    The tables are generated in prepareToPlay() and only read afterwards, so
+    all voices share a single Wavetables object.
+*/
+class Wavetables
+{
+public:
+    // Same values as VoiceWaveform.
+    enum Waveform
+    {
+        Sine,
+        Saw,
+        Square,
+        NumWaveforms
+    };
+
+    static constexpr int tableSize = 2048;
+    static constexpr int numOctaves = 10;
+
+    // The first octave's table is used up to this fundamental; each following
+    // one covers an octave more, so the last reaches past 20 kHz.
+    static constexpr double lowestTopFrequency = 40.0;
+
+    Wavetables()
+    {
+        for (auto& tables : octaveTables)
+            tables.setSize(numOctaves, tableSize + 1);
+
+        silence.setSize(1, tableSize + 1);
+        silence.clear();
+    }
+
+    void prepareToPlay (double sampleRate)
+    {
+        if (sampleRate == preparedSampleRate)
+            return;
+
+        preparedSampleRate = sampleRate;
+
+        AudioBuffer<float> sine(1, tableSize);
+        auto* sineData = sine.getWritePointer(0);
+
+        for (int i = 0; i < tableSize; ++i)
+            sineData[i] = float(std::sin(MathConstants<double>::twoPi * i / tableSize));
+
+        for (int octave = 0; octave < numOctaves; ++octave)
+        {
+            // at high sample rates the low octaves want more harmonics than the
+            // table can hold; past its Nyquist they'd fold back as inverted partials
+            const int numHarmonics = jlimit(1, tableSize / 2 - 1, int(0.5 * sampleRate / getTopFrequency(octave)));
+
+            fillTable(octaveTables[Sine].getWritePointer(octave), sineData, 1, 1, 1.0);
+
+            // A rising ramp from -1 to 1, and a square that starts low, like
+            // maxiOsc::saw() and maxiOsc::square().
+            fillTable(octaveTables[Saw].getWritePointer(octave), sineData, numHarmonics, 1, -2.0 / MathConstants<double>::pi);
+            fillTable(octaveTables[Square].getWritePointer(octave), sineData, numHarmonics, 2, -4.0 / MathConstants<double>::pi);
+        }
+    }
+
+    bool isPrepared() const noexcept    { return preparedSampleRate > 0.0; }
+
+    // The octave whose table is alias-free at this frequency.
+    static int getOctaveForFrequency (double frequency)
+    {
+        return jlimit(0, numOctaves - 1, int(std::ceil(std::log2(jmax(1.0, frequency) / lowestTopFrequency))));
+    }
+
+    static double getTopFrequency (int octave)
+    {
+        return lowestTopFrequency * double(1 << octave);
+    }
+
+    /** Returns tableSize + 1 samples; the last one repeats the first so that
+        interpolation never has to wrap. Until prepareToPlay() has run this is
+        a table of silence.
+    */
+    const float* getTable (int waveform, int octave) const
+    {
+        jassert(isPositiveAndBelow(waveform, int(NumWaveforms)) && isPositiveAndBelow(octave, numOctaves));
+
+        if (! isPrepared())
+            return silence.getReadPointer(0);
+
+        return octaveTables[waveform].getReadPointer(octave);
+    }
+
+private:
+    // Sums harmonics 1, 1 + step, 1 + 2 * step ... up to numHarmonics, each
+    // at 1/n of the gain, reading sin(2 pi n i / N) from the sine table.
+    static void fillTable (float* table, const float* sine, int numHarmonics, int step, double gain)
+    {
+        for (int i = 0; i < tableSize; ++i)
+        {
+            double sum = 0.0;
+
+            for (int n = 1; n <= numHarmonics; n += step)
+                sum += sine[(n * i) % tableSize] / n;
+
+            table[i] = float(gain * sum);
+        }
+
+        table[tableSize] = table[0];
+    }
+
+    AudioBuffer<float> octaveTables[NumWaveforms];
+    AudioBuffer<float> silence;
+    double preparedSampleRate = 0.0;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (Wavetables)
+};
+
+
+/**
+    Plays the shared Wavetables with linear interpolation. setFrequency()
+    picks the octave tables for the note once, so the per-sample cost is a
+    table read whichever waveform is playing.
+*/
+class WavetableOscillator
+{
+public:
+    void setFrequency (const Wavetables& wavetables, double frequency, double sampleRate)
+    {
+        const int octave = Wavetables::getOctaveForFrequency(frequency);
+
+        for (int waveform = 0; waveform < Wavetables::NumWaveforms; ++waveform)
+            tables[waveform] = wavetables.getTable(waveform, octave);
+
+        increment = sampleRate > 0.0 ? float(frequency * Wavetables::tableSize / sampleRate) : 0.0f;
+    }
+
+    float getNextSample (int waveform)
+    {
+        const auto* table = tables[waveform];
+
+        const int index = int(position);
+        const auto fraction = position - float(index);
+        const auto sample = table[index] + fraction * (table[index + 1] - table[index]);
+
+        position += increment;
+
+        if (position >= float(Wavetables::tableSize))
+            position -= float(Wavetables::tableSize);
+
+        return sample;
+    }
+
+    void resetPhase()    { position = 0.0f; }
+
+private:
+    const float* tables[Wavetables::NumWaveforms] {};
+    float position = 0.0f;
+    float increment = 0.0f;
+};